@@ -0,0 +1,289 @@
+// Allocation.cpp replaces the global operator new and delete and Allegro's allocator to count heap memory per subsystem
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <atomic>
+#include <allegro5/allegro.h>
+#include "allocation.h"
+
+/*
+* Thread local storage that VS2013, which lacks thread_local, understands too.
+*/
+#ifdef _MSC_VER
+#define TETRIS_THREAD_LOCAL __declspec(thread)
+#else
+#define TETRIS_THREAD_LOCAL __thread
+#endif
+
+/*
+* Every tracked block starts with a header recording its size and tag. It is a multiple of 16 bytes so the memory
+* after it keeps malloc's alignment.
+*/
+struct BlockHeader {
+	size_t size;
+	int tag;
+};
+static const size_t HEADER_SIZE = (sizeof(BlockHeader) + 15) / 16 * 16;
+
+/*
+* The counters of one tag.
+*/
+struct TagCounters {
+	std::atomic<long long> bytes;
+	std::atomic<long long> peakBytes;
+	std::atomic<long long> allocations;
+};
+
+/*
+* The number of allocations the thread has made through operator new. Kept per thread so a check on one thread
+* isn't thrown off by the render thread, the watcher or audio allocating at the same time.
+*/
+static TETRIS_THREAD_LOCAL long long allocationCount = 0;
+
+/*
+* The counters of each tag, followed by the ones for every tag together. Zeroed before any constructor runs.
+*/
+static TagCounters counters[Tetris::Utils::MEMORY_TAG_COUNT + 1];
+
+/*
+* The tag of the allocations the thread makes.
+*/
+static TETRIS_THREAD_LOCAL int currentTag = Tetris::Utils::MEMORY_GENERAL;
+
+/*
+* The names of the tags, in the order of MemoryTag.
+*/
+static const char* TAG_NAMES[Tetris::Utils::MEMORY_TAG_COUNT + 1] = { "general", "audio", "images", "fonts", "ui", "simulation", "total" };
+
+/*
+* Adds to the bytes of a counter and raises its peak if the bytes went past it.
+*/
+static void addBytes(TagCounters& counter, long long bytes) {
+	long long now = counter.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	long long peak = counter.peakBytes.load(std::memory_order_relaxed);
+	while (now > peak && !counter.peakBytes.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+	}
+}
+
+/*
+* Allocates a block with a header and counts it against the tag.
+*/
+static void* trackedAllocate(size_t size, int tag) {
+	char* block = (char*)malloc(HEADER_SIZE + size);
+	if (block == nullptr) {
+		return nullptr;
+	}
+	BlockHeader* header = (BlockHeader*)block;
+	header->size = size;
+	header->tag = tag;
+	addBytes(counters[tag], (long long)size);
+	addBytes(counters[Tetris::Utils::MEMORY_TAG_COUNT], (long long)size);
+	counters[tag].allocations.fetch_add(1, std::memory_order_relaxed);
+	counters[Tetris::Utils::MEMORY_TAG_COUNT].allocations.fetch_add(1, std::memory_order_relaxed);
+	return block + HEADER_SIZE;
+}
+
+/*
+* Frees a block from trackedAllocate, taking it off the tag it was counted against.
+*/
+static void trackedFree(void* memory) {
+	if (memory == nullptr) {
+		return;
+	}
+	BlockHeader* header = (BlockHeader*)((char*)memory - HEADER_SIZE);
+	counters[header->tag].bytes.fetch_sub((long long)header->size, std::memory_order_relaxed);
+	counters[Tetris::Utils::MEMORY_TAG_COUNT].bytes.fetch_sub((long long)header->size, std::memory_order_relaxed);
+	free(header);
+}
+
+/*
+* Resizes a block from trackedAllocate. It stays under the tag it was allocated with.
+*/
+static void* trackedResize(void* memory, size_t size) {
+	if (memory == nullptr) {
+		return trackedAllocate(size, currentTag);
+	}
+	if (size == 0) {
+		trackedFree(memory);
+		return nullptr;
+	}
+	BlockHeader* header = (BlockHeader*)((char*)memory - HEADER_SIZE);
+	int tag = header->tag;
+	long long change = (long long)size - (long long)header->size;
+	char* block = (char*)realloc(header, HEADER_SIZE + size);
+	if (block == nullptr) {
+		return nullptr;
+	}
+	((BlockHeader*)block)->size = size;
+	addBytes(counters[tag], change);
+	addBytes(counters[Tetris::Utils::MEMORY_TAG_COUNT], change);
+	return block + HEADER_SIZE;
+}
+
+/*
+* Allegro's allocator, which ignores where the allocation was made from.
+*/
+static void* allegroMalloc(size_t n, int line, const char* file, const char* func) {
+	return trackedAllocate(n, currentTag);
+}
+static void allegroFree(void* ptr, int line, const char* file, const char* func) {
+	trackedFree(ptr);
+}
+static void* allegroRealloc(void* ptr, size_t n, int line, const char* file, const char* func) {
+	return trackedResize(ptr, n);
+}
+static void* allegroCalloc(size_t count, size_t n, int line, const char* file, const char* func) {
+	void* memory = trackedAllocate(count * n, currentTag);
+	if (memory != nullptr) {
+		memset(memory, 0, count * n);
+	}
+	return memory;
+}
+
+// =========================MemoryScope==================================
+/*
+* Tags the allocations the current thread makes while the scope lasts.
+*/
+Tetris::Utils::MemoryScope::MemoryScope(Tetris::Utils::MemoryTag tag) : previous(setMemoryTag(tag)) {}
+
+/*
+* Puts back the tag from before the scope.
+*/
+Tetris::Utils::MemoryScope::~MemoryScope() {
+	setMemoryTag(previous);
+}
+
+// =========================Counters==================================
+/*
+* Gets the number of allocations the calling thread has made through operator new.
+*/
+long long Tetris::Utils::getAllocationCount() {
+	return allocationCount;
+}
+
+/*
+* Sets the tag of the current thread's allocations and returns the one it replaces.
+*/
+Tetris::Utils::MemoryTag Tetris::Utils::setMemoryTag(Tetris::Utils::MemoryTag tag) {
+	MemoryTag previous = (MemoryTag)currentTag;
+	currentTag = tag;
+	return previous;
+}
+
+/*
+* Allocates memory counted against a tag.
+*/
+void* Tetris::Utils::allocate(size_t size, Tetris::Utils::MemoryTag tag) {
+	return trackedAllocate(size, tag);
+}
+
+/*
+* Frees memory from allocate().
+*/
+void Tetris::Utils::release(void* memory) {
+	trackedFree(memory);
+}
+
+/*
+* Gets what a tag has allocated, or every tag together for MEMORY_TAG_COUNT.
+*/
+Tetris::Utils::MemoryStats Tetris::Utils::getMemoryStats(Tetris::Utils::MemoryTag tag) {
+	MemoryStats stats;
+	stats.bytes = counters[tag].bytes.load(std::memory_order_relaxed);
+	stats.peakBytes = counters[tag].peakBytes.load(std::memory_order_relaxed);
+	stats.allocations = counters[tag].allocations.load(std::memory_order_relaxed);
+	return stats;
+}
+
+/*
+* Gets the name of a tag, or "total" for MEMORY_TAG_COUNT.
+*/
+const char* Tetris::Utils::getMemoryTagName(Tetris::Utils::MemoryTag tag) {
+	return TAG_NAMES[tag];
+}
+
+/*
+* Routes Allegro's allocations through the counters.
+*/
+void Tetris::Utils::trackAllegroMemory() {
+	static ALLEGRO_MEMORY_INTERFACE memoryInterface = { allegroMalloc, allegroFree, allegroRealloc, allegroCalloc };
+	al_set_memory_interface(&memoryInterface);
+}
+
+/*
+* Prints a row for each tag and the total, in kilobytes. The peak of the total is the most allocated at once, which
+* can be less than the peaks of the tags added up.
+*/
+void Tetris::Utils::printMemoryReport(FILE* out, long long budget) {
+	fprintf(out, "Heap memory        current KB      peak KB  allocations\n");
+	for (int tag = 0; tag <= MEMORY_TAG_COUNT; tag++) {
+		MemoryStats stats = getMemoryStats((MemoryTag)tag);
+		fprintf(out, "  %-12s %12.1f %12.1f %12lld\n", TAG_NAMES[tag], stats.bytes / 1024.0, stats.peakBytes / 1024.0, stats.allocations);
+	}
+	if (budget > 0) {
+		MemoryStats total = getMemoryStats(MEMORY_TAG_COUNT);
+		if (total.peakBytes > budget) {
+			fprintf(out, "Warning: the peak of %.1f MB is over the budget of %.1f MB\n", total.peakBytes / 1048576.0, budget / 1048576.0);
+		}
+		else {
+			fprintf(out, "Peak %.1f MB of the %.1f MB budget\n", total.peakBytes / 1048576.0, budget / 1048576.0);
+		}
+	}
+}
+
+// =========================Operators==================================
+/*
+* Counts the allocation and gets the memory, tagged with the thread's current tag.
+*/
+void* operator new(size_t size) {
+	allocationCount++;
+	void* memory = trackedAllocate(size == 0 ? 1 : size, currentTag);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+/*
+* Array version of operator new.
+*/
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+/*
+* The versions of operator new that return null instead of throwing. They have to be replaced too, since their
+* memory is freed by the operator delete below.
+*/
+void* operator new(size_t size, const std::nothrow_t&) throw() {
+	allocationCount++;
+	return trackedAllocate(size == 0 ? 1 : size, currentTag);
+}
+void* operator new[](size_t size, const std::nothrow_t& nothrow) throw() {
+	return operator new(size, nothrow);
+}
+
+/*
+* Frees memory allocated by operator new.
+*/
+void operator delete(void* memory) throw() {
+	trackedFree(memory);
+}
+
+/*
+* Frees memory allocated by operator new[].
+*/
+void operator delete[](void* memory) throw() {
+	trackedFree(memory);
+}
+
+/*
+* Frees memory allocated by the versions of operator new that don't throw.
+*/
+void operator delete(void* memory, const std::nothrow_t&) throw() {
+	trackedFree(memory);
+}
+void operator delete[](void* memory, const std::nothrow_t&) throw() {
+	trackedFree(memory);
+}
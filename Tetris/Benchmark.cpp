@@ -0,0 +1,279 @@
+// Benchmark.cpp implements the render, collision and environment benchmarks
+
+#include <stdio.h>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_image.h>
+#include "benchmark.h"
+#include "utils.h"
+
+/*
+* Adds a burst of particles at the centre of the player to a snapshot.
+*/
+static void addBurst(Tetris::FrameSnapshot& snapshot, const Tetris::Simulation::World& world, Tetris::Graphics::ParticleBurst::Kind kind) {
+	if (snapshot.burstCount == Tetris::Graphics::MAX_BURSTS) {
+		return;
+	}
+	int player = world.player;
+	Tetris::Graphics::ParticleBurst& burst = snapshot.bursts[snapshot.burstCount++];
+	burst.kind = kind;
+	burst.x = Tetris::Simulation::toFloat(world.x[player]) + Tetris::Simulation::toFloat(world.width[player]) / 2;
+	burst.y = Tetris::Simulation::toFloat(world.y[player]) + Tetris::Simulation::toFloat(world.height[player]) / 2;
+}
+
+/*
+* Prepares to draw the given number of frames.
+*/
+Tetris::RenderBenchmark::RenderBenchmark(int frames) : frames(frames), menuFrames(0) {}
+
+/*
+* Draws every snapshot once to measure the frame rate, then again timing each part of the frame. Timing the parts
+* adds overhead, so it is kept out of the frame rate.
+*/
+int Tetris::RenderBenchmark::run(const char* goldenImage) {
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+	ALLEGRO_BITMAP* target = al_create_bitmap(Tetris::Layout::SCREEN_WIDTH, Tetris::Layout::SCREEN_HEIGHT);
+	if (target == nullptr) {
+		fprintf(stderr, "Could not create the offscreen bitmap\n");
+		return 1;
+	}
+	int result = 0;
+	{
+		// Loaded after the flags are set so the images and glyphs are memory bitmaps too.
+		Tetris::Utils::ImageManager images;
+		Tetris::Utils::FontManager fonts;
+		ALLEGRO_BITMAP* background = images.getImage(Tetris::Utils::ImageManager::GAMEMUSIC);
+		ALLEGRO_BITMAP* tetrisImage = images.getImage(Tetris::Utils::ImageManager::TETRIS);
+		ALLEGRO_BITMAP* wallImage = images.getImage(Tetris::Utils::ImageManager::WALL);
+		ALLEGRO_FONT* bigFont = fonts.getFont(Tetris::Utils::FontManager::TITLE);
+		ALLEGRO_FONT* normalFont = fonts.getFont(Tetris::Utils::FontManager::NORMAL);
+		if (background == nullptr || tetrisImage == nullptr || wallImage == nullptr || bigFont == nullptr || normalFont == nullptr) {
+			fprintf(stderr, "Could not load the images and fonts\n");
+			al_destroy_bitmap(target);
+			return 1;
+		}
+		fonts.prebake();
+		record(al_get_bitmap_width(tetrisImage), al_get_bitmap_height(tetrisImage), al_get_bitmap_width(wallImage), al_get_bitmap_height(wallImage));
+
+		al_set_target_bitmap(target);
+		Tetris::Graphics::SceneRenderer renderer(background, tetrisImage, wallImage, bigFont, normalFont);
+		double start = al_get_time();
+		for (FrameSnapshot& snapshot : snapshots) {
+			renderer.draw(snapshot);
+		}
+		double elapsed = al_get_time() - start;
+
+		Tetris::Graphics::SceneRenderer::Costs costs = { 0, 0, 0, 0 };
+		for (FrameSnapshot& snapshot : snapshots) {
+			renderer.draw(snapshot, &costs);
+		}
+
+		int gameFrames = frames - menuFrames;
+		printf("Rendered %d frames (%d menu, %d game) at %dx%d in %.3f s\n", frames, menuFrames, gameFrames,
+			(int)Tetris::Layout::SCREEN_WIDTH, (int)Tetris::Layout::SCREEN_HEIGHT, elapsed);
+		printf("  %.1f frames/s, %.1f us/frame\n", elapsed > 0 ? frames / elapsed : 0, elapsed * 1e6 / frames);
+		printf("  background  %8.1f us/frame\n", costs.background * 1e6 / frames);
+		printf("  menu        %8.1f us/frame\n", menuFrames > 0 ? costs.menu * 1e6 / menuFrames : 0);
+		printf("  information %8.1f us/frame\n", gameFrames > 0 ? costs.information * 1e6 / gameFrames : 0);
+		printf("  world       %8.1f us/frame\n", gameFrames > 0 ? costs.world * 1e6 / gameFrames : 0);
+
+		if (goldenImage != nullptr) {
+			if (al_save_bitmap(goldenImage, target)) {
+				printf("Saved the last frame to %s\n", goldenImage);
+			}
+			else {
+				fprintf(stderr, "Could not save %s\n", goldenImage);
+				result = 1;
+			}
+		}
+		al_set_target_bitmap(NULL);
+	}
+	al_destroy_bitmap(target);
+	return result;
+}
+
+/*
+* Plays the demo with a fixed seed to get the game states to draw. A tenth of the frames show the menu with the
+* hovered button changing every half second, the rest are the demo game restarting whenever it crashes, with the
+* particle effects the game would show.
+*/
+void Tetris::RenderBenchmark::record(float playerWidth, float playerHeight, float wallWidth, float wallHeight) {
+	const float delta = 1.0f / 60;
+	Tetris::Utils::Tuning tuning;
+	Tetris::Simulation::World world;
+	world.create(nullptr, playerWidth, playerHeight, wallWidth, wallHeight, SEED);
+	world.applyTuning(tuning);
+
+	snapshots.resize(frames);
+	menuFrames = frames / 10;
+	for (int i = 0; i < frames; i++) {
+		FrameSnapshot& snapshot = snapshots[i];
+		snapshot.burstCount = 0;
+		snapshot.particleSeconds = 0;
+		if (i < menuFrames) {
+			snapshot.screen = FrameSnapshot::MENU;
+			snapshot.hoveredButton = (i / 30) % 4 - 1;
+			snapshot.state = Tetris::Graphics::InformationBox::OVER;
+		}
+		else {
+			float dy = Tetris::Simulation::toFloat(world.dy[world.player]);
+			world.demoMove(tuning);
+			if (Tetris::Simulation::toFloat(world.dy[world.player]) != dy) {
+				addBurst(snapshot, world, Tetris::Graphics::ParticleBurst::SMALL_BOOST);
+			}
+			Tetris::Simulation::StepResult result = world.step(delta);
+			if (result == Tetris::Simulation::CRASHED_FLOOR || result == Tetris::Simulation::CRASHED_WALL) {
+				addBurst(snapshot, world, Tetris::Graphics::ParticleBurst::CRASH);
+				world.reset();
+			}
+			else if (result == Tetris::Simulation::SCORED) {
+				addBurst(snapshot, world, Tetris::Graphics::ParticleBurst::SCORE);
+			}
+			snapshot.particleSeconds = delta;
+			snapshot.screen = FrameSnapshot::GAME;
+			snapshot.hoveredButton = -1;
+			snapshot.state = Tetris::Graphics::InformationBox::DEMO;
+		}
+		snapshot.world = world;
+		snapshot.bestScore = 0;
+	}
+}
+
+// =========================CollisionBenchmark==================================
+/*
+* Prepares to test the given number of ticks.
+*/
+Tetris::CollisionBenchmark::CollisionBenchmark(int ticks) : ticks(ticks) {}
+
+/*
+* Records the demo with box collisions, then tests every tick's collisions with boxes only and with the masks
+* set on the recorded worlds. Both runs test the same states, so the difference is the cost of the precise test. The precise test
+* is also timed on its own, with Tetris swept across a wall segment so every call gets past the broad phase.
+*/
+int Tetris::CollisionBenchmark::run() {
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+	Tetris::Utils::ImageManager images;
+	ALLEGRO_BITMAP* tetrisImage = images.getImage(Tetris::Utils::ImageManager::TETRIS);
+	ALLEGRO_BITMAP* wallImage = images.getImage(Tetris::Utils::ImageManager::WALL);
+	if (tetrisImage == nullptr || wallImage == nullptr) {
+		fprintf(stderr, "Could not load the images\n");
+		return 1;
+	}
+	const Tetris::Simulation::CollisionMask& tetrisMask = images.getMask(Tetris::Utils::ImageManager::TETRIS);
+	const Tetris::Simulation::CollisionMask& wallMask = images.getMask(Tetris::Utils::ImageManager::WALL);
+
+	const float delta = 1.0f / 60;
+	Tetris::Utils::Tuning tuning;
+	Tetris::Simulation::CollisionMaskSet masks;
+	masks.set(Tetris::Utils::ImageManager::TETRIS, &tetrisMask);
+	masks.set(Tetris::Utils::ImageManager::WALL, &wallMask);
+	Tetris::Simulation::World world;
+	world.create(nullptr, al_get_bitmap_width(tetrisImage), al_get_bitmap_height(tetrisImage), al_get_bitmap_width(wallImage), al_get_bitmap_height(wallImage), SEED);
+	world.applyTuning(tuning);
+	worlds.resize(ticks);
+	for (int i = 0; i < ticks; i++) {
+		world.demoMove(tuning);
+		Tetris::Simulation::StepResult result = world.step(delta);
+		// Kept before any reset so the ticks that crashed are tested too.
+		worlds[i] = world;
+		if (result == Tetris::Simulation::CRASHED_FLOOR || result == Tetris::Simulation::CRASHED_WALL) {
+			world.reset();
+		}
+	}
+
+	double start = al_get_time();
+	int boxHits = testTicks();
+	double boxSeconds = al_get_time() - start;
+
+	for (Tetris::Simulation::World& tick : worlds) {
+		tick.setMasks(&masks);
+	}
+	start = al_get_time();
+	int maskHits = testTicks();
+	double maskSeconds = al_get_time() - start;
+
+	int tetrisWidth = tetrisMask.getWidth();
+	int tetrisHeight = tetrisMask.getHeight();
+	int overlaps = 0;
+	int tests = 0;
+	start = al_get_time();
+	for (int repeat = 0; repeat < REPEATS; repeat++) {
+		for (int y = -tetrisHeight; y <= wallMask.getHeight(); y += 3) {
+			for (int x = -tetrisWidth; x <= wallMask.getWidth(); x += 3) {
+				overlaps += Tetris::Simulation::CollisionMask::overlap(tetrisMask, x, y, wallMask, 0, 0) ? 1 : 0;
+				tests++;
+			}
+		}
+	}
+	double sweepSeconds = al_get_time() - start;
+
+	double testedTicks = (double)ticks * REPEATS;
+	printf("Tested the collisions of %d ticks %d times, Tetris %dx%d (%.0f%% solid), wall %dx%d (%.0f%% solid)\n", ticks, REPEATS,
+		tetrisWidth, tetrisHeight, tetrisWidth * tetrisHeight > 0 ? tetrisMask.count() * 100.0 / (tetrisWidth * tetrisHeight) : 0,
+		wallMask.getWidth(), wallMask.getHeight(), wallMask.getWidth() * wallMask.getHeight() > 0 ? wallMask.count() * 100.0 / (wallMask.getWidth() * wallMask.getHeight()) : 0);
+	printf("  boxes  %8.1f ns/tick, %d hits\n", boxSeconds * 1e9 / testedTicks, boxHits / REPEATS);
+	printf("  masks  %8.1f ns/tick, %d hits\n", maskSeconds * 1e9 / testedTicks, maskHits / REPEATS);
+	printf("  extra  %8.1f ns/tick\n", (maskSeconds - boxSeconds) * 1e9 / testedTicks);
+	printf("  mask test %5.1f ns each with the boxes touching, %d%% overlapping\n", tests > 0 ? sweepSeconds * 1e9 / tests : 0, tests > 0 ? overlaps * 100 / tests : 0);
+	return 0;
+}
+
+/*
+* Runs the collision tests of every recorded tick, the way World::step does, and returns how many hit.
+*/
+int Tetris::CollisionBenchmark::testTicks() {
+	int hits = 0;
+	for (int repeat = 0; repeat < REPEATS; repeat++) {
+		for (Tetris::Simulation::World& tick : worlds) {
+			int player = tick.player;
+			for (int i = 0; i < Tetris::Simulation::WALL_COUNT; i++) {
+				if (tick.collidesWithWall(tick.walls[i], tick.x[player], tick.y[player], tick.width[player], tick.height[player], tick.image[player])) {
+					hits++;
+					break;
+				}
+			}
+		}
+	}
+	return hits;
+}
+
+// =========================EnvironmentBenchmark==================================
+/*
+* Prepares to step the given number of games the given number of times.
+*/
+Tetris::EnvironmentBenchmark::EnvironmentBenchmark(int steps, int games) : steps(steps), games(games) {}
+
+/*
+* Fills the actions with a cheap pseudo random pattern before each step, as a policy would, and times the steps.
+*/
+int Tetris::EnvironmentBenchmark::run() {
+	Tetris::Simulation::VectorEnvironment environment(nullptr, games, SEED);
+	int count = environment.getCount();
+	std::vector<int> actions(count, 0);
+	std::vector<float> observations((size_t)count * Tetris::Simulation::ENV_OBSERVATIONS);
+	std::vector<float> rewards(count);
+	std::vector<unsigned char> dones(count);
+	environment.reset(observations.data());
+
+	long long episodes = 0;
+	double reward = 0;
+	unsigned int pattern = SEED;
+	double start = al_get_time();
+	for (int step = 0; step < steps; step++) {
+		for (int i = 0; i < count; i++) {
+			pattern = pattern * 1664525 + 1013904223;
+			actions[i] = (pattern >> 24) < 16 ? (int)((pattern >> 22) & 1) + 1 : Tetris::Simulation::GLIDE;
+		}
+		environment.step(actions.data(), observations.data(), rewards.data(), dones.data());
+		for (int i = 0; i < count; i++) {
+			episodes += dones[i] != Tetris::Simulation::ENV_RUNNING ? 1 : 0;
+			reward += rewards[i];
+		}
+	}
+	double elapsed = al_get_time() - start;
+
+	double total = (double)steps * count;
+	printf("Stepped %d games %d times on %d threads in %.2f s\n", count, steps, environment.getThreadCount(), elapsed);
+	printf("  %.2f million environment steps/s, %.1f us per step() call\n", total / elapsed / 1e6, elapsed * 1e6 / steps);
+	printf("  %lld episodes finished, mean reward %.3f per step\n", episodes, reward / total);
+	return 0;
+}
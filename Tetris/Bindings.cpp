@@ -0,0 +1,280 @@
+// Bindings.cpp implements the tetris_env Python module, which exposes the VectorEnvironment to training code
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+#include "vecenv.h"
+
+/*
+* A VecEnv object: the Python handle on a VectorEnvironment.
+*/
+struct VecEnvObject {
+	PyObject_HEAD
+	Tetris::Simulation::VectorEnvironment* environment;
+	bool busy;					// Set while a call runs with the GIL released. Only read or written with the GIL held.
+};
+
+/*
+* Gets the type character of a buffer's format, skipping the byte order prefix. A missing format means bytes.
+*/
+static char getFormat(const Py_buffer& buffer) {
+	const char* format = buffer.format != nullptr ? buffer.format : "B";
+	if (*format == '@' || *format == '=' || *format == '<' || *format == '>' || *format == '!') {
+		format++;
+	}
+	return format[1] == '\0' ? format[0] : '\0';
+}
+
+/*
+* Gets a C contiguous buffer with the given number of items of one of the accepted formats, raising an exception
+* and returning false if the object doesn't provide one. The caller releases the buffer.
+*/
+static bool getBuffer(PyObject* object, Py_buffer& buffer, const char* name, bool writable, const char* formats, Py_ssize_t itemSize, Py_ssize_t items) {
+	int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0);
+	if (PyObject_GetBuffer(object, &buffer, flags) != 0) {
+		return false;
+	}
+	char format = getFormat(buffer);
+	if (buffer.itemsize != itemSize || format == '\0' || strchr(formats, format) == nullptr) {
+		PyErr_Format(PyExc_TypeError, "%s must hold %zd byte items of format '%s', not '%s'", name, itemSize, formats, buffer.format != nullptr ? buffer.format : "B");
+		PyBuffer_Release(&buffer);
+		return false;
+	}
+	if (buffer.len != items * itemSize) {
+		PyErr_Format(PyExc_ValueError, "%s must hold %zd items, not %zd", name, items, buffer.len / itemSize);
+		PyBuffer_Release(&buffer);
+		return false;
+	}
+	return true;
+}
+
+/*
+* Raises an exception and returns false if another thread is stepping or resetting the object, since the games and
+* the threads' buffers are shared.
+*/
+static bool checkIdle(VecEnvObject* self) {
+	if (self->busy) {
+		PyErr_SetString(PyExc_RuntimeError, "VecEnv is already in use by another thread");
+		return false;
+	}
+	return true;
+}
+
+/*
+* VecEnv(num_envs, seed=1, threads=0, player_width=40, player_height=40, wall_width=50, wall_height=100)
+*/
+static int VecEnv_init(VecEnvObject* self, PyObject* args, PyObject* kwargs) {
+	static const char* keywords[] = { "num_envs", "seed", "threads", "player_width", "player_height", "wall_width", "wall_height", nullptr };
+	int count;
+	unsigned int seed = 1;
+	int threads = 0;
+	float playerWidth = Tetris::Simulation::ENV_PLAYER_WIDTH;
+	float playerHeight = Tetris::Simulation::ENV_PLAYER_HEIGHT;
+	float wallWidth = Tetris::Simulation::ENV_WALL_WIDTH;
+	float wallHeight = Tetris::Simulation::ENV_WALL_HEIGHT;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "i|Iiffff", const_cast<char**>(keywords), &count, &seed, &threads, &playerWidth, &playerHeight, &wallWidth, &wallHeight)) {
+		return -1;
+	}
+	if (count < 1) {
+		PyErr_SetString(PyExc_ValueError, "num_envs must be at least 1");
+		return -1;
+	}
+	if (!checkIdle(self)) {
+		return -1;
+	}
+	delete self->environment;
+	self->environment = nullptr;
+	try {
+		// The module has no images to build masks from, so it tests boxes only, like the session server.
+		self->environment = new Tetris::Simulation::VectorEnvironment(nullptr, count, seed, threads, playerWidth, playerHeight, wallWidth, wallHeight);
+	}
+	catch (...) {
+		PyErr_NoMemory();
+		return -1;
+	}
+	return 0;
+}
+
+/*
+* Stops the environment's threads and frees it.
+*/
+static void VecEnv_dealloc(VecEnvObject* self) {
+	PyTypeObject* type = Py_TYPE(self);
+	if (self->environment != nullptr) {
+		Py_BEGIN_ALLOW_THREADS
+		delete self->environment;
+		Py_END_ALLOW_THREADS
+	}
+	type->tp_free((PyObject*)self);
+	Py_DECREF(type);
+}
+
+/*
+* Raises an exception and returns false if the object was never initialised.
+*/
+static bool checkInitialised(VecEnvObject* self) {
+	if (self->environment == nullptr) {
+		PyErr_SetString(PyExc_RuntimeError, "VecEnv.__init__ was not called");
+		return false;
+	}
+	return true;
+}
+
+/*
+* Checks that the object is initialised and not in use, and marks it busy. Claimed before any buffer is taken,
+* since getting a buffer can run Python code that could call back into the object or replace its environment.
+*/
+static bool claim(VecEnvObject* self) {
+	if (!checkInitialised(self) || !checkIdle(self)) {
+		return false;
+	}
+	self->busy = true;
+	return true;
+}
+
+/*
+* reset(observations): resets every game and fills the float32 buffer of num_envs * observation_size values.
+*/
+static PyObject* VecEnv_reset(VecEnvObject* self, PyObject* observationsObject) {
+	if (!claim(self)) {
+		return nullptr;
+	}
+	Tetris::Simulation::VectorEnvironment* environment = self->environment;
+	Py_buffer observations;
+	if (!getBuffer(observationsObject, observations, "observations", true, "f", 4, (Py_ssize_t)environment->getCount() * Tetris::Simulation::ENV_OBSERVATIONS)) {
+		self->busy = false;
+		return nullptr;
+	}
+	Py_BEGIN_ALLOW_THREADS
+	environment->reset((float*)observations.buf);
+	Py_END_ALLOW_THREADS
+	PyBuffer_Release(&observations);
+	self->busy = false;
+	Py_RETURN_NONE;
+}
+
+/*
+* step(actions, observations, rewards, dones): steps every game with its int32 action and fills the float32
+* observations and rewards and the uint8 dones. The GIL is released while the games are stepped; the buffers stay
+* exported, so they can't be resized underneath the threads, and the object stays busy, so no other thread can use
+* it at the same time.
+*/
+static PyObject* VecEnv_step(VecEnvObject* self, PyObject* const* args, Py_ssize_t argCount) {
+	if (argCount != 4) {
+		PyErr_Format(PyExc_TypeError, "step() takes 4 arguments (%zd given)", argCount);
+		return nullptr;
+	}
+	if (!claim(self)) {
+		return nullptr;
+	}
+	Tetris::Simulation::VectorEnvironment* environment = self->environment;
+	Py_ssize_t count = environment->getCount();
+	Py_buffer buffers[4];
+	int taken = 0;
+	bool valid = getBuffer(args[0], buffers[taken], "actions", false, "il", 4, count) && ++taken &&
+		getBuffer(args[1], buffers[taken], "observations", true, "f", 4, count * Tetris::Simulation::ENV_OBSERVATIONS) && ++taken &&
+		getBuffer(args[2], buffers[taken], "rewards", true, "f", 4, count) && ++taken &&
+		getBuffer(args[3], buffers[taken], "dones", true, "Bb?c", 1, count) && ++taken;
+	if (valid) {
+		Py_BEGIN_ALLOW_THREADS
+		environment->step((const int*)buffers[0].buf, (float*)buffers[1].buf, (float*)buffers[2].buf, (unsigned char*)buffers[3].buf);
+		Py_END_ALLOW_THREADS
+	}
+	while (taken > 0) {
+		PyBuffer_Release(&buffers[--taken]);
+	}
+	self->busy = false;
+	if (!valid) {
+		return nullptr;
+	}
+	Py_RETURN_NONE;
+}
+
+/*
+* num_envs: the number of games.
+*/
+static PyObject* VecEnv_getCount(VecEnvObject* self, void*) {
+	if (!checkInitialised(self)) {
+		return nullptr;
+	}
+	return PyLong_FromLong(self->environment->getCount());
+}
+
+/*
+* threads: the threads stepping the games, the calling thread included.
+*/
+static PyObject* VecEnv_getThreads(VecEnvObject* self, void*) {
+	if (!checkInitialised(self)) {
+		return nullptr;
+	}
+	return PyLong_FromLong(self->environment->getThreadCount());
+}
+
+static PyMethodDef VecEnv_methods[] = {
+	{ "reset", (PyCFunction)VecEnv_reset, METH_O, "reset(observations)\n--\n\nResets every game and writes num_envs * observation_size float32 observations." },
+	{ "step", (PyCFunction)(void(*)(void))VecEnv_step, METH_FASTCALL, "step(actions, observations, rewards, dones)\n--\n\n"
+		"Steps every game with its int32 action (0 glide, 1 small boost, 2 big boost) and writes float32 observations and\n"
+		"rewards and uint8 dones (0 running, 1 crashed, 2 time limit). Finished games are reset, so their observation is\n"
+		"the first of the next episode." },
+	{ nullptr, nullptr, 0, nullptr }
+};
+
+static PyGetSetDef VecEnv_getset[] = {
+	{ "num_envs", (getter)VecEnv_getCount, nullptr, "The number of games.", nullptr },
+	{ "threads", (getter)VecEnv_getThreads, nullptr, "The threads stepping the games, the calling thread included.", nullptr },
+	{ nullptr, nullptr, nullptr, nullptr, nullptr }
+};
+
+static PyType_Slot VecEnv_slots[] = {
+	{ Py_tp_doc, (void*)"VecEnv(num_envs, seed=1, threads=0, player_width=40, player_height=40, wall_width=50, wall_height=100)\n--\n\n"
+		"Headless games stepped together in native threads, reading and writing caller-owned buffers." },
+	{ Py_tp_new, (void*)PyType_GenericNew },
+	{ Py_tp_init, (void*)VecEnv_init },
+	{ Py_tp_dealloc, (void*)VecEnv_dealloc },
+	{ Py_tp_methods, VecEnv_methods },
+	{ Py_tp_getset, VecEnv_getset },
+	{ 0, nullptr }
+};
+
+static PyType_Spec VecEnv_spec = {
+	"tetris_env.VecEnv",
+	sizeof(VecEnvObject),
+	0,
+	Py_TPFLAGS_DEFAULT,
+	VecEnv_slots
+};
+
+static PyModuleDef module = {
+	PyModuleDef_HEAD_INIT,
+	"tetris_env",
+	"Vectorised headless Tetris games for reinforcement learning.",
+	-1,
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr
+};
+
+/*
+* Creates the module with the VecEnv type and the sizes and codes training code needs.
+*/
+PyMODINIT_FUNC PyInit_tetris_env() {
+	PyObject* created = PyModule_Create(&module);
+	if (created == nullptr) {
+		return nullptr;
+	}
+	PyObject* type = PyType_FromSpec(&VecEnv_spec);
+	if (type == nullptr || PyModule_AddObject(created, "VecEnv", type) != 0) {
+		Py_XDECREF(type);
+		Py_DECREF(created);
+		return nullptr;
+	}
+	PyModule_AddIntConstant(created, "OBSERVATION_SIZE", Tetris::Simulation::ENV_OBSERVATIONS);
+	PyModule_AddIntConstant(created, "ACTION_COUNT", Tetris::Simulation::ENV_ACTIONS);
+	PyModule_AddIntConstant(created, "MAX_TICKS", Tetris::Simulation::ENV_MAX_TICKS);
+	PyModule_AddIntConstant(created, "RUNNING", Tetris::Simulation::ENV_RUNNING);
+	PyModule_AddIntConstant(created, "CRASHED", Tetris::Simulation::ENV_CRASHED);
+	PyModule_AddIntConstant(created, "TIME_LIMIT", Tetris::Simulation::ENV_TIME_LIMIT);
+	return created;
+}
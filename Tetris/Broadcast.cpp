@@ -0,0 +1,604 @@
+// Broadcast.cpp implements streaming the game to spectators
+
+#include <string.h>
+#include <chrono>
+#include "broadcast.h"
+
+/*
+* The bit of each field in the mask of an encoded frame.
+*/
+enum Field {
+	PLAYER_Y = 1,													// One bit per player from here.
+	PLAYER_DY = PLAYER_Y << Tetris::Simulation::MAX_PLAYERS,		// One bit per player from here.
+	FINAL_SCORE = PLAYER_DY << Tetris::Simulation::MAX_PLAYERS,	// One bit per player from here.
+	WALL_X = FINAL_SCORE << Tetris::Simulation::MAX_PLAYERS,		// One bit per wall from here.
+	GAP = WALL_X << Tetris::Simulation::WALL_COUNT,					// One bit per wall from here.
+	SCORE = GAP << Tetris::Simulation::WALL_COUNT,
+	STATE = SCORE << 1,
+	CRASHED = STATE << 1
+};
+
+static const int HEADER_SIZE = 13;		// The tick, the base tick, the player count and the mask.
+
+/*
+* Writes and reads little endian values.
+*/
+static void putInt(unsigned char* out, unsigned int value) {
+	out[0] = (unsigned char)value;
+	out[1] = (unsigned char)(value >> 8);
+	out[2] = (unsigned char)(value >> 16);
+	out[3] = (unsigned char)(value >> 24);
+}
+
+static unsigned int getInt(const unsigned char* in) {
+	return in[0] | (in[1] << 8) | (in[2] << 16) | ((unsigned int)in[3] << 24);
+}
+
+static void putFloat(unsigned char* out, float value) {
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	putInt(out, bits);
+}
+
+static float getFloat(const unsigned char* in) {
+	unsigned int bits = getInt(in);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/*
+* Compares floats bit for bit, so a value that is sent always arrives unchanged.
+*/
+static bool sameFloat(float a, float b) {
+	return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+/*
+* Gets the mask of every field of a frame with the given number of players.
+*/
+static unsigned int everyField(int playerCount) {
+	unsigned int mask = WALL_X * ((1u << Tetris::Simulation::WALL_COUNT) - 1) | GAP * ((1u << Tetris::Simulation::WALL_COUNT) - 1) | SCORE | STATE | CRASHED;
+	for (int i = 0; i < playerCount; i++) {
+		mask |= (PLAYER_Y | PLAYER_DY | FINAL_SCORE) << i;
+	}
+	return mask;
+}
+
+/*
+* Copies what a spectator needs out of the world.
+*/
+void Tetris::Net::makeFrame(SpectatorFrame& frame, unsigned int tick, const Tetris::Simulation::World& world, int state) {
+	frame.tick = tick;
+	frame.playerCount = (unsigned char)world.playerCount;
+	frame.crashed = (unsigned char)world.crashed;
+	for (int i = 0; i < Tetris::Simulation::MAX_PLAYERS; i++) {
+		// Slots past the player count are zeroed so frames compare the same whatever was there before.
+		bool used = i < world.playerCount;
+		frame.playerY[i] = used ? Tetris::Simulation::toFloat(world.y[world.players[i]]) : 0;
+		frame.playerDy[i] = used ? Tetris::Simulation::toFloat(world.dy[world.players[i]]) : 0;
+		frame.finalScores[i] = used ? world.finalScores[i] : 0;
+	}
+	for (int i = 0; i < Tetris::Simulation::WALL_COUNT; i++) {
+		frame.wallX[i] = Tetris::Simulation::toFloat(world.x[world.walls[i]]);
+		frame.gaps[i] = (unsigned char)world.gapPosition[world.walls[i]];
+	}
+	frame.score = world.score;
+	frame.state = (unsigned char)state;
+}
+
+/*
+* Puts a received frame into a world created the same way as the game's.
+*/
+void Tetris::Net::applyFrame(const SpectatorFrame& frame, Tetris::Simulation::World& world) {
+	if (world.playerCount != frame.playerCount) {
+		// The world is only filled in from frames, never left to pick its own gaps, so the seed doesn't matter.
+		world.create(world.masks, Tetris::Simulation::toFloat(world.width[world.player]), Tetris::Simulation::toFloat(world.height[world.player]),
+			Tetris::Simulation::toFloat(world.width[world.walls[0]]), Tetris::Simulation::toFloat(world.height[world.walls[0]]), 1, frame.playerCount);
+	}
+	for (int i = 0; i < world.playerCount; i++) {
+		world.y[world.players[i]] = frame.playerY[i];
+		world.dy[world.players[i]] = frame.playerDy[i];
+		world.finalScores[i] = frame.finalScores[i];
+	}
+	world.crashed = frame.crashed;
+	for (int i = 0; i < Tetris::Simulation::WALL_COUNT; i++) {
+		world.x[world.walls[i]] = frame.wallX[i];
+		world.gapPosition[world.walls[i]] = frame.gaps[i];
+	}
+	world.score = frame.score;
+}
+
+/*
+* Writes the tick, the base tick, the player count and a mask of the fields that differ from the base, then those
+* fields.
+*/
+int Tetris::Net::encodeFrame(const SpectatorFrame& frame, const SpectatorFrame* base, unsigned char* out) {
+	unsigned int mask = everyField(frame.playerCount);
+	if (base != nullptr && base->playerCount == frame.playerCount) {
+		mask = 0;
+		for (int i = 0; i < frame.playerCount; i++) {
+			mask |= sameFloat(frame.playerY[i], base->playerY[i]) ? 0 : PLAYER_Y << i;
+			mask |= sameFloat(frame.playerDy[i], base->playerDy[i]) ? 0 : PLAYER_DY << i;
+			mask |= frame.finalScores[i] == base->finalScores[i] ? 0 : FINAL_SCORE << i;
+		}
+		for (int i = 0; i < Tetris::Simulation::WALL_COUNT; i++) {
+			mask |= sameFloat(frame.wallX[i], base->wallX[i]) ? 0 : WALL_X << i;
+			mask |= frame.gaps[i] == base->gaps[i] ? 0 : GAP << i;
+		}
+		mask |= frame.score == base->score ? 0 : SCORE;
+		mask |= frame.state == base->state ? 0 : STATE;
+		mask |= frame.crashed == base->crashed ? 0 : CRASHED;
+	}
+	putInt(out, frame.tick);
+	putInt(out + 4, base != nullptr ? base->tick : NO_BASE);
+	out[8] = frame.playerCount;
+	putInt(out + 9, mask);
+	int used = HEADER_SIZE;
+	for (int i = 0; i < frame.playerCount; i++) {
+		if (mask & (PLAYER_Y << i)) {
+			putFloat(out + used, frame.playerY[i]);
+			used += 4;
+		}
+		if (mask & (PLAYER_DY << i)) {
+			putFloat(out + used, frame.playerDy[i]);
+			used += 4;
+		}
+		if (mask & (FINAL_SCORE << i)) {
+			putInt(out + used, (unsigned int)frame.finalScores[i]);
+			used += 4;
+		}
+	}
+	for (int i = 0; i < Tetris::Simulation::WALL_COUNT; i++) {
+		if (mask & (WALL_X << i)) {
+			putFloat(out + used, frame.wallX[i]);
+			used += 4;
+		}
+	}
+	for (int i = 0; i < Tetris::Simulation::WALL_COUNT; i++) {
+		if (mask & (GAP << i)) {
+			out[used++] = frame.gaps[i];
+		}
+	}
+	if (mask & SCORE) {
+		putInt(out + used, (unsigned int)frame.score);
+		used += 4;
+	}
+	if (mask & STATE) {
+		out[used++] = frame.state;
+	}
+	if (mask & CRASHED) {
+		out[used++] = frame.crashed;
+	}
+	return used;
+}
+
+/*
+* Reads the tick of the base frame an encoded frame was written against.
+*/
+unsigned int Tetris::Net::peekBase(const unsigned char* in, int size) {
+	return size >= 8 ? getInt(in + 4) : NO_BASE;
+}
+
+/*
+* Reads a frame written by encodeFrame, starting from the base and replacing the fields in the mask. A frame with
+* no base, or with a different number of players from its base, must have every field.
+*/
+int Tetris::Net::decodeFrame(const unsigned char* in, int size, const SpectatorFrame* base, SpectatorFrame& frame) {
+	if (size < HEADER_SIZE) {
+		return -1;
+	}
+	unsigned int baseTick = getInt(in + 4);
+	if (baseTick != NO_BASE && (base == nullptr || base->tick != baseTick)) {
+		return -1;
+	}
+	int playerCount = in[8];
+	if (playerCount < 1 || playerCount > Tetris::Simulation::MAX_PLAYERS) {
+		return -1;
+	}
+	unsigned int mask = getInt(in + 9);
+	unsigned int every = everyField(playerCount);
+	if ((mask & ~every) != 0) {
+		return -1;
+	}
+	if (baseTick == NO_BASE || base->playerCount != playerCount) {
+		if (mask != every) {
+			return -1;
+		}
+		memset(&frame, 0, sizeof(frame));
+	}
+	else {
+		frame = *base;
+	}
+	frame.tick = getInt(in);
+	frame.playerCount = (unsigned char)playerCount;
+
+	// Work out the size before reading so a cut off frame is never half applied.
+	int needed = HEADER_SIZE;
+	for (int i = 0; i < playerCount; i++) {
+		needed += (mask & (PLAYER_Y << i)) ? 4 : 0;
+		needed += (mask & (PLAYER_DY << i)) ? 4 : 0;
+		needed += (mask & (FINAL_SCORE << i)) ? 4 : 0;
+	}
+	for (int i = 0; i < Tetris::Simulation::WALL_COUNT; i++) {
+		needed += (mask & (WALL_X << i)) ? 4 : 0;
+		needed += (mask & (GAP << i)) ? 1 : 0;
+	}
+	needed += (mask & SCORE) ? 4 : 0;
+	needed += (mask & STATE) ? 1 : 0;
+	needed += (mask & CRASHED) ? 1 : 0;
+	if (size < needed) {
+		return -1;
+	}
+
+	int used = HEADER_SIZE;
+	for (int i = 0; i < playerCount; i++) {
+		if (mask & (PLAYER_Y << i)) {
+			frame.playerY[i] = getFloat(in + used);
+			used += 4;
+		}
+		if (mask & (PLAYER_DY << i)) {
+			frame.playerDy[i] = getFloat(in + used);
+			used += 4;
+		}
+		if (mask & (FINAL_SCORE << i)) {
+			frame.finalScores[i] = (int)getInt(in + used);
+			used += 4;
+		}
+	}
+	for (int i = 0; i < Tetris::Simulation::WALL_COUNT; i++) {
+		if (mask & (WALL_X << i)) {
+			frame.wallX[i] = getFloat(in + used);
+			used += 4;
+		}
+	}
+	for (int i = 0; i < Tetris::Simulation::WALL_COUNT; i++) {
+		if (mask & (GAP << i)) {
+			frame.gaps[i] = in[used++];
+		}
+	}
+	if (mask & SCORE) {
+		frame.score = (int)getInt(in + used);
+		used += 4;
+	}
+	if (mask & STATE) {
+		frame.state = in[used++];
+	}
+	if (mask & CRASHED) {
+		frame.crashed = in[used++];
+	}
+	return used;
+}
+
+// =========================FrameHistory==================================
+/*
+* Creates an empty history. Tick 0 is never used, so it marks an empty slot.
+*/
+Tetris::Net::FrameHistory::FrameHistory() {
+	memset(frames, 0, sizeof(frames));
+}
+
+/*
+* Adds a frame, replacing the one SIZE ticks before it.
+*/
+void Tetris::Net::FrameHistory::add(const SpectatorFrame& frame) {
+	frames[frame.tick % SIZE] = frame;
+}
+
+/*
+* Finds the frame for the tick, or null if it isn't kept.
+*/
+const Tetris::Net::SpectatorFrame* Tetris::Net::FrameHistory::find(unsigned int tick) const {
+	const SpectatorFrame& frame = frames[tick % SIZE];
+	return tick != 0 && frame.tick == tick ? &frame : nullptr;
+}
+
+// =========================SpectatorServer==================================
+/*
+* Creates a server that isn't listening yet.
+*/
+Tetris::Net::SpectatorServer::SpectatorServer() : listener(INVALID), latest(0), running(false), spectatorCount(0) {}
+
+/*
+* Stops the server.
+*/
+Tetris::Net::SpectatorServer::~SpectatorServer() {
+	stop();
+}
+
+/*
+* Starts listening on the port of 127.0.0.1.
+*/
+bool Tetris::Net::SpectatorServer::start(int port) {
+	if (running) {
+		return true;
+	}
+	if (!startup()) {
+		return false;
+	}
+	listener = listenTcp("127.0.0.1", port);
+	if (listener == INVALID) {
+		return false;
+	}
+	setNonBlocking(listener);
+	running = true;
+	thread = std::thread(&Tetris::Net::SpectatorServer::run, this);
+	return true;
+}
+
+/*
+* Disconnects every spectator and stops the server thread.
+*/
+void Tetris::Net::SpectatorServer::stop() {
+	if (!running) {
+		return;
+	}
+	running = false;
+	if (thread.joinable()) {
+		thread.join();
+	}
+	for (Spectator& spectator : spectators) {
+		closeSocket(spectator.socket);
+	}
+	spectators.clear();
+	spectatorCount = 0;
+	closeSocket(listener);
+	listener = INVALID;
+}
+
+/*
+* Hands a frame to the server thread without waiting.
+*/
+void Tetris::Net::SpectatorServer::publish(const SpectatorFrame& frame) {
+	queue.push(frame);
+}
+
+/*
+* Gets the number of spectators connected.
+*/
+int Tetris::Net::SpectatorServer::getSpectatorCount() {
+	return spectatorCount;
+}
+
+/*
+* The body of the server thread. Every BATCH_INTERVAL it takes the frames published since last time, accepts new
+* spectators and sends each one a packet. Spectators that disconnect or fall behind are dropped.
+*/
+void Tetris::Net::SpectatorServer::run() {
+	while (running) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		SpectatorFrame frame;
+		while (queue.pop(frame)) {
+			history.add(frame);
+			latest = frame.tick;
+		}
+		acceptSpectators();
+		for (size_t i = 0; i < spectators.size();) {
+			if (readAcks(spectators[i]) && sendFrames(spectators[i])) {
+				i++;
+			}
+			else {
+				closeSocket(spectators[i].socket);
+				spectators[i] = spectators.back();
+				spectators.pop_back();
+			}
+		}
+		spectatorCount = (int)spectators.size();
+		std::this_thread::sleep_until(start + std::chrono::milliseconds((int)BATCH_INTERVAL));
+	}
+}
+
+/*
+* Accepts every spectator waiting to connect.
+*/
+void Tetris::Net::SpectatorServer::acceptSpectators() {
+	while (true) {
+		Socket client = acceptClient(listener, 0);
+		if (client == INVALID) {
+			return;
+		}
+		setNonBlocking(client);
+		Spectator spectator;
+		spectator.socket = client;
+		spectator.acknowledged = NO_BASE;
+		// Start from the newest frame rather than replaying the whole history.
+		spectator.sent = latest > 0 ? latest - 1 : 0;
+		spectator.ackBytes = 0;
+		spectators.push_back(spectator);
+	}
+}
+
+/*
+* Reads acknowledgements from the spectator, keeping the last complete one.
+*/
+bool Tetris::Net::SpectatorServer::readAcks(Spectator& spectator) {
+	char buffer[64];
+	while (true) {
+		int received = receive(spectator.socket, buffer, sizeof(buffer));
+		if (received == 0) {
+			return false;
+		}
+		if (received < 0) {
+			return wouldBlock();
+		}
+		for (int i = 0; i < received; i++) {
+			spectator.acks[spectator.ackBytes++] = buffer[i];
+			if (spectator.ackBytes == 4) {
+				spectator.acknowledged = getInt((const unsigned char*)spectator.acks);
+				spectator.ackBytes = 0;
+			}
+		}
+	}
+}
+
+/*
+* Queues a packet of the frames the spectator hasn't been sent yet and sends what the socket will take. A spectator
+* that has missed more than the history holds starts again from the oldest frame kept.
+*/
+bool Tetris::Net::SpectatorServer::sendFrames(Spectator& spectator) {
+	if (latest != 0 && spectator.sent < latest) {
+		unsigned int from = spectator.sent + 1;
+		unsigned int oldest = latest >= (unsigned int)FrameHistory::SIZE ? latest - FrameHistory::SIZE + 1 : 1;
+		if (from < oldest) {
+			from = oldest;
+		}
+		packet.resize(5 + (latest - from + 1) * MAX_ENCODED_FRAME);
+		const SpectatorFrame* base = spectator.acknowledged != NO_BASE ? history.find(spectator.acknowledged) : nullptr;
+		int count = 0;
+		int used = 5;
+		for (unsigned int tick = from; tick <= latest; tick++) {
+			const SpectatorFrame* frame = history.find(tick);
+			if (frame == nullptr) {
+				continue;
+			}
+			used += encodeFrame(*frame, base, &packet[used]);
+			base = frame;
+			count++;
+		}
+		putInt(&packet[0], used - 4);
+		packet[4] = (unsigned char)count;
+		spectator.pending.append((const char*)&packet[0], used);
+		spectator.sent = latest;
+	}
+	if (!spectator.pending.empty()) {
+		int sent = sendSome(spectator.socket, spectator.pending.data(), (int)spectator.pending.size());
+		if (sent < 0) {
+			return false;
+		}
+		spectator.pending.erase(0, sent);
+	}
+	return spectator.pending.size() <= MAX_PENDING;
+}
+
+// =========================SpectatorConnection==================================
+/*
+* Creates a connection that isn't connected yet.
+*/
+Tetris::Net::SpectatorConnection::SpectatorConnection() : socket(INVALID), latest(0), framesDecoded(0), bytesReceived(0) {}
+
+/*
+* Disconnects.
+*/
+Tetris::Net::SpectatorConnection::~SpectatorConnection() {
+	disconnect();
+}
+
+/*
+* Connects to the port of 127.0.0.1.
+*/
+bool Tetris::Net::SpectatorConnection::connect(int port) {
+	if (!startup()) {
+		return false;
+	}
+	socket = connectTcp("127.0.0.1", port);
+	if (socket == INVALID) {
+		return false;
+	}
+	setNonBlocking(socket);
+	return true;
+}
+
+/*
+* Disconnects.
+*/
+void Tetris::Net::SpectatorConnection::disconnect() {
+	if (socket != INVALID) {
+		closeSocket(socket);
+		socket = INVALID;
+	}
+}
+
+/*
+* Reads whatever has arrived and decodes every complete packet, then acknowledges the newest frame.
+*/
+bool Tetris::Net::SpectatorConnection::poll() {
+	if (socket == INVALID) {
+		return false;
+	}
+	char buffer[4096];
+	while (true) {
+		int size = receive(socket, buffer, sizeof(buffer));
+		if (size == 0 || (size < 0 && !wouldBlock())) {
+			disconnect();
+			return false;
+		}
+		if (size < 0) {
+			break;
+		}
+		received.insert(received.end(), buffer, buffer + size);
+		bytesReceived += size;
+	}
+
+	unsigned int before = latest;
+	size_t offset = 0;
+	while (received.size() - offset >= 4) {
+		unsigned int length = getInt(&received[offset]);
+		if (received.size() - offset - 4 < length) {
+			break;
+		}
+		if (!decodePacket(&received[offset + 4], (int)length)) {
+			disconnect();
+			return false;
+		}
+		offset += 4 + length;
+	}
+	received.erase(received.begin(), received.begin() + offset);
+
+	if (latest != before) {
+		unsigned char ack[4];
+		putInt(ack, latest);
+		int sent = sendSome(socket, (const char*)ack, 4);
+		if (sent != 4 && sent != 0) {
+			// Skipping an acknowledgement only means a larger delta next time, but half of one garbles the stream.
+			disconnect();
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+* Decodes one complete packet, each frame against the frame it names as its base.
+*/
+bool Tetris::Net::SpectatorConnection::decodePacket(const unsigned char* data, int size) {
+	if (size < 1) {
+		return false;
+	}
+	int count = data[0];
+	int used = 1;
+	for (int i = 0; i < count; i++) {
+		unsigned int baseTick = peekBase(data + used, size - used);
+		const SpectatorFrame* base = baseTick != NO_BASE ? history.find(baseTick) : nullptr;
+		SpectatorFrame frame;
+		int read = decodeFrame(data + used, size - used, base, frame);
+		if (read < 0) {
+			return false;
+		}
+		used += read;
+		history.add(frame);
+		latest = frame.tick;
+		framesDecoded++;
+	}
+	return used == size;
+}
+
+/*
+* Gets the newest frame decoded, or null if there hasn't been one.
+*/
+const Tetris::Net::SpectatorFrame* Tetris::Net::SpectatorConnection::getLatest() {
+	return history.find(latest);
+}
+
+/*
+* Gets the number of frames decoded so far.
+*/
+long long Tetris::Net::SpectatorConnection::getFramesDecoded() {
+	return framesDecoded;
+}
+
+/*
+* Gets the number of bytes received so far.
+*/
+long long Tetris::Net::SpectatorConnection::getBytesReceived() {
+	return bytesReceived;
+}
@@ -0,0 +1,216 @@
+// Capture.cpp implements the background video capture
+
+#include <string.h>
+#include <chrono>
+#include "capture.h"
+
+/*
+* Creates a capture of frames with the given size. Every buffer is allocated here so capturing never allocates.
+*/
+Tetris::Utils::VideoCapture::VideoCapture(int width, int height) : width(width), height(height), mappedWidth(0), spare(-1), file(nullptr), running(false), framesCaptured(0), framesDropped(0), framesWritten(0) {
+	for (int i = 0; i < POOL_SIZE; i++) {
+		buffers[i].resize(width * height);
+		available.push(i);
+	}
+	previous.resize(width * height);
+	columns.resize(width);
+}
+
+/*
+* Stops capturing.
+*/
+Tetris::Utils::VideoCapture::~VideoCapture() {
+	stop();
+}
+
+/*
+* Opens the file, writes the header and starts the encoder thread.
+*/
+bool Tetris::Utils::VideoCapture::start(const char* path) {
+	if (running) {
+		return true;
+	}
+	file = fopen(path, "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	fwrite("TCAP", 1, 4, file);
+	writeInt(1);
+	writeInt(width);
+	writeInt(height);
+	memset(previous.data(), 0, previous.size() * sizeof(unsigned int));
+	running = true;
+	thread = std::thread(&Tetris::Utils::VideoCapture::run, this);
+	return true;
+}
+
+/*
+* Stops the encoder thread once it has written the frames still queued, then closes the file.
+*/
+void Tetris::Utils::VideoCapture::stop() {
+	if (!running) {
+		return;
+	}
+	running = false;
+	if (thread.joinable()) {
+		thread.join();
+	}
+	fclose(file);
+	file = nullptr;
+}
+
+/*
+* Copies the bitmap into a free buffer and queues it for the encoder. Reading the bitmap is the only work done on
+* the drawing thread. Drops the frame if the encoder still has every buffer.
+*/
+void Tetris::Utils::VideoCapture::captureFrame(ALLEGRO_BITMAP* bitmap, double time) {
+	if (!running || bitmap == nullptr) {
+		return;
+	}
+	if (spare < 0 && !available.pop(spare)) {
+		framesDropped++;
+		return;
+	}
+	ALLEGRO_LOCKED_REGION* region = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY);
+	if (region == nullptr) {
+		// Keep the buffer for the next frame.
+		framesDropped++;
+		return;
+	}
+	int sourceWidth = al_get_bitmap_width(bitmap);
+	int sourceHeight = al_get_bitmap_height(bitmap);
+	unsigned int* pixels = buffers[spare].data();
+	if (sourceWidth == width && sourceHeight == height) {
+		for (int y = 0; y < height; y++) {
+			memcpy(pixels + y * width, (const char*)region->data + y * region->pitch, width * sizeof(unsigned int));
+		}
+	}
+	else {
+		// Nearest neighbour, so every frame of the file has the same size whatever size it was drawn at.
+		if (mappedWidth != sourceWidth) {
+			for (int x = 0; x < width; x++) {
+				columns[x] = (int)((long long)x * sourceWidth / width);
+			}
+			mappedWidth = sourceWidth;
+		}
+		for (int y = 0; y < height; y++) {
+			const unsigned int* source = (const unsigned int*)((const char*)region->data + (long long)y * sourceHeight / height * region->pitch);
+			unsigned int* row = pixels + y * width;
+			for (int x = 0; x < width; x++) {
+				row[x] = source[columns[x]];
+			}
+		}
+	}
+	al_unlock_bitmap(bitmap);
+
+	Frame frame;
+	frame.buffer = spare;
+	frame.number = framesCaptured;
+	frame.time = time;
+	// There are only POOL_SIZE buffers, so the queue always has room for this one.
+	filled.push(frame);
+	spare = -1;
+	framesCaptured++;
+}
+
+/*
+* Gets the number of frames queued for the encoder.
+*/
+long long Tetris::Utils::VideoCapture::getFramesCaptured() {
+	return framesCaptured;
+}
+
+/*
+* Gets the number of frames dropped because no buffer was free.
+*/
+long long Tetris::Utils::VideoCapture::getFramesDropped() {
+	return framesDropped;
+}
+
+/*
+* Gets the number of frames written to the file.
+*/
+long long Tetris::Utils::VideoCapture::getFramesWritten() {
+	return framesWritten;
+}
+
+/*
+* The body of the encoder thread. Encodes queued frames and hands their buffers back, sleeping briefly when there
+* is nothing to do. Once stopped it finishes the frames already queued.
+*/
+void Tetris::Utils::VideoCapture::run() {
+	while (true) {
+		Frame frame;
+		if (filled.pop(frame)) {
+			encode(frame);
+			available.push(frame.buffer);
+			framesWritten++;
+		}
+		else if (!running) {
+			break;
+		}
+		else {
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+	}
+	fflush(file);
+}
+
+/*
+* Writes the frame as runs of unchanged and changed pixels. Most of the screen stays the same from one frame to
+* the next, so the runs are mostly long stretches of unchanged pixels.
+*/
+void Tetris::Utils::VideoCapture::encode(const Frame& frame) {
+	const unsigned int* pixels = buffers[frame.buffer].data();
+	unsigned int* last = previous.data();
+	int count = width * height;
+
+	writeInt((unsigned int)frame.number);
+	fwrite(&frame.time, sizeof(double), 1, file);
+	int i = 0;
+	while (i < count) {
+		int start = i;
+		while (i < count && pixels[i] == last[i]) {
+			i++;
+		}
+		int unchanged = i - start;
+		start = i;
+		while (i < count && pixels[i] != last[i]) {
+			i++;
+		}
+		int changed = i - start;
+		writeInt(unchanged);
+		writeInt(changed);
+		writeChanges(pixels + start, last + start, changed);
+	}
+	memcpy(last, pixels, count * sizeof(unsigned int));
+}
+
+/*
+* Writes a 32 bit little endian integer.
+*/
+void Tetris::Utils::VideoCapture::writeInt(unsigned int value) {
+	unsigned char bytes[4] = { (unsigned char)value, (unsigned char)(value >> 8), (unsigned char)(value >> 16), (unsigned char)(value >> 24) };
+	fwrite(bytes, 1, 4, file);
+}
+
+/*
+* Writes changed pixels XORed with the previous frame, a chunk at a time.
+*/
+void Tetris::Utils::VideoCapture::writeChanges(const unsigned int* pixels, const unsigned int* last, int count) {
+	int used = 0;
+	for (int i = 0; i < count; i++) {
+		unsigned int value = pixels[i] ^ last[i];
+		chunk[used++] = (unsigned char)value;
+		chunk[used++] = (unsigned char)(value >> 8);
+		chunk[used++] = (unsigned char)(value >> 16);
+		chunk[used++] = (unsigned char)(value >> 24);
+		if (used == sizeof(chunk)) {
+			fwrite(chunk, 1, used, file);
+			used = 0;
+		}
+	}
+	if (used > 0) {
+		fwrite(chunk, 1, used, file);
+	}
+}
@@ -2,12 +2,31 @@
 #include <allegro5/allegro_image.h>
 #include <allegro5/allegro_font.h>
 #include <allegro5/allegro_ttf.h>
+#include <stdio.h>
+#include <time.h>
 #include "game.h"
+#include "allocation.h"
+
+/*
+* The config file the tuning values are read from.
+*/
+static const char* TUNING_FILE = "assets/tuning.cfg";
+
+/*
+* The file the high scores are kept in.
+*/
+static const char* HIGH_SCORE_FILE = "highscores.dat";
+
+/*
+* The key each player boosts with.
+*/
+static const int BOOST_KEYS[Tetris::Simulation::MAX_PLAYERS] = { ALLEGRO_KEY_SPACE, ALLEGRO_KEY_UP, ALLEGRO_KEY_W, ALLEGRO_KEY_I };
 
 /*
 * Makes the calls to initialise allegro and sets up the game components.
 */
-Tetris::Game::Game() {
+Tetris::Game::Game(const Tetris::Options& options) : options(options), menuArena(MENU_ARENA_SIZE), gameArena(GAME_ARENA_SIZE), history(REWIND_TICKS), renderThread(nullptr),
+	resolution(Tetris::Layout::SCREEN_WIDTH, Tetris::Layout::SCREEN_HEIGHT, FPSIncrement * 0.75), capture(nullptr), metricsServer(nullptr), spectatorServer(nullptr), broadcastTick(0), scoresPending(false) {
 	initGame();
 }
 
@@ -15,279 +34,756 @@ Tetris::Game::Game() {
 * Frees up memory allocated.
 */
 Tetris::Game::~Game() {
+	reportMemory();
+	assetWatcher.stop();
+	levels.stop();
+	submitScores();
+	highScores.close();
+	delete metricsServer;
+	delete spectatorServer;
+	if (renderThread != nullptr) {
+		// Take the display back from the render thread before destroying it.
+		delete renderThread;
+		al_set_target_backbuffer(gameWindow);
+	}
+	if (capture != nullptr) {
+		capture->stop();
+		printf("Captured %lld frames, dropped %lld\n", capture->getFramesWritten(), capture->getFramesDropped());
+		delete capture;
+	}
 	al_destroy_display(gameWindow);
 	al_destroy_event_queue(eventQueue);
 	al_destroy_event_queue(timerQueue);
 	al_destroy_timer(timer);
-	al_destroy_font(bigFont);
-	al_destroy_font(normalFont);
-	delete title;
-	delete play;
-	delete demo;
-	delete quit;
-	delete info;
-	delete tetris;
-	delete wall1;
-	delete wall2;
+	menuArena.clear();
+	gameArena.clear();
 }
 
 /*
 * Initialises the game components.
 */
 void Tetris::Game::initGame() {
-	gameWindow = al_create_display(800, 600);
+	al_set_new_display_flags(ALLEGRO_RESIZABLE);
+	gameWindow = al_create_display(Tetris::Layout::SCREEN_WIDTH, Tetris::Layout::SCREEN_HEIGHT);
 	eventQueue = al_create_event_queue();
 	timerQueue = al_create_event_queue();
 	al_register_event_source(eventQueue, al_get_display_event_source(gameWindow));
 	al_set_window_title(gameWindow, "Tetris");
 	timer = al_create_timer(1.0 / FPS);
-	al_register_event_source(eventQueue, al_get_timer_event_source(timer));
+	al_register_event_source(timerQueue, al_get_timer_event_source(timer));
 	al_register_event_source(eventQueue, al_get_mouse_event_source());
 	al_register_event_source(eventQueue, al_get_keyboard_event_source());
 
 
-	bigFont = al_load_ttf_font("assets/fonts/arial.ttf", 72, NULL);
-	normalFont = al_load_ttf_font("assets/fonts/arial.ttf", 20, NULL);
+	fontManager.prebake();
+	bigFont = fontManager.getFont(Tetris::Utils::FontManager::TITLE);
+	normalFont = fontManager.getFont(Tetris::Utils::FontManager::NORMAL);
 
-	mainMenu.setBounds(Tetris::Graphics::Rectangle(0, 0, 800, 600));
-	title = new Tetris::Graphics::Label("Tetris", bigFont);
-	title->setPosition(260, 100);
+	// The widgets are counted as UI memory; the arenas they're built in already are.
+	Tetris::Utils::MemoryTag previousTag = Tetris::Utils::setMemoryTag(Tetris::Utils::MEMORY_UI);
+	mainMenu.setBounds(Tetris::Graphics::Rectangle(0, 0, Tetris::Layout::SCREEN_WIDTH, Tetris::Layout::SCREEN_HEIGHT));
+	title = menuArena.create<Tetris::Graphics::Label>("Tetris", bigFont);
+	title->setPosition(Tetris::Layout::TITLE_X, Tetris::Layout::TITLE_Y);
 	title->setColour(al_map_rgb(7, 70, 70));
 	mainMenu.addWidget(title);
 
-	play = new Tetris::Game::PlayButton(this);
-	play->setPosition(360, 250);
+	play = menuArena.create<Tetris::Game::PlayButton>(this);
+	play->setPosition(Tetris::Layout::BUTTON_X, Tetris::Layout::PLAY_Y);
 	mainMenu.addWidget(play);
-	demo = new Tetris::Game::DemoButton(this);
-	demo->setPosition(360, 300);
+	demo = menuArena.create<Tetris::Game::DemoButton>(this);
+	demo->setPosition(Tetris::Layout::BUTTON_X, Tetris::Layout::DEMO_Y);
 	mainMenu.addWidget(demo);
-	quit = new Tetris::Game::QuitButton(this);
-	quit->setPosition(360, 350);
+	quit = menuArena.create<Tetris::Game::QuitButton>(this);
+	quit->setPosition(Tetris::Layout::BUTTON_X, Tetris::Layout::QUIT_Y);
 	mainMenu.addWidget(quit);
 
-	gameScreen.setBounds(Tetris::Graphics::Rectangle(0, 0, 800, 600));
-	info = new Tetris::Graphics::InformationBox(800, 100, normalFont);
+	gameScreen.setBounds(Tetris::Graphics::Rectangle(0, 0, Tetris::Layout::SCREEN_WIDTH, Tetris::Layout::SCREEN_HEIGHT));
+	info = gameArena.create<Tetris::Graphics::InformationBox>(Tetris::Layout::SCREEN_WIDTH, Tetris::Layout::INFO_HEIGHT, normalFont);
 	gameScreen.addWidget(info);
-	gameCanvas.setBounds(Tetris::Graphics::Rectangle(0, 100, 800, 500));
-
-	tetris = new Tetris::Graphics::TetrisSprite(imageManager.getImage(Tetris::Utils::ImageManager::TETRIS));
-	tetris->setPosition(50, 250);
-	gameCanvas.addWidget(tetris);
-	wall1 = new Tetris::Graphics::Wall(imageManager.getImage(Tetris::Utils::ImageManager::WALL), 1);
-	wall1->setPosition(480, 100);
-	wall1->setVelocityX(-70);
-	gameScreen.addWidget(wall1);
-	wall2 = new Tetris::Graphics::Wall(imageManager.getImage(Tetris::Utils::ImageManager::WALL), 2);
-	wall2->setPosition(980, 100);
-	wall2->setVelocityX(-70);
-	gameScreen.addWidget(wall2);
-	wall3 = new Tetris::Graphics::Wall(imageManager.getImage(Tetris::Utils::ImageManager::WALL), 3);
-	wall3->setPosition(1460, 100);
-	wall3->setVelocityX(-70);
-	gameScreen.addWidget(wall3);
+	gameCanvas.setBounds(Tetris::Graphics::Rectangle(0, Tetris::Layout::INFO_HEIGHT, Tetris::Layout::SCREEN_WIDTH, Tetris::Layout::SCREEN_HEIGHT - Tetris::Layout::INFO_HEIGHT));
+
+	ALLEGRO_BITMAP* tetrisImage = imageManager.getImage(Tetris::Utils::ImageManager::TETRIS);
+	ALLEGRO_BITMAP* wallImage = imageManager.getImage(Tetris::Utils::ImageManager::WALL);
+	// Crashes are judged on the pixels of the images rather than their boxes. The masks are rebuilt in place when
+	// an image is reloaded, so the set never needs updating.
+	collisionMasks.set(Tetris::Utils::ImageManager::TETRIS, &imageManager.getMask(Tetris::Utils::ImageManager::TETRIS));
+	collisionMasks.set(Tetris::Utils::ImageManager::WALL, &imageManager.getMask(Tetris::Utils::ImageManager::WALL));
+	world.create(&collisionMasks, al_get_bitmap_width(tetrisImage), al_get_bitmap_height(tetrisImage), al_get_bitmap_width(wallImage), al_get_bitmap_height(wallImage), (unsigned int)time(NULL), options.players);
+	worldView = gameArena.create<Tetris::Graphics::WorldView>();
+	worldView->setBounds(gameCanvas.getBounds());
+	worldView->setImage(Tetris::Utils::ImageManager::TETRIS, tetrisImage);
+	worldView->setImage(Tetris::Utils::ImageManager::WALL, wallImage);
+	worldView->setWorld(&world);
+	worldView->setParticles(&particles);
+	gameCanvas.addWidget(worldView);
 	gameScreen.addWidget(&gameCanvas);
+	Tetris::Utils::setMemoryTag(previousTag);
 
-	front = wall1;
-	back = wall3;
+	highScores.open(HIGH_SCORE_FILE);
+	info->updateBest(highScores.getTable().best());
+
+	hasDemoNetwork = demoNetwork.load(options.networkPath);
+	tuning.load(TUNING_FILE);
+	applyTuning();
+	levels.start((unsigned int)time(NULL));
+	assetWatcher.watch(Tetris::Utils::AssetWatcher::TUNING, 0, TUNING_FILE);
+	assetWatcher.watch(Tetris::Utils::AssetWatcher::IMAGE, Tetris::Utils::ImageManager::GAMEMUSIC, Tetris::Utils::ImageManager::getPath(Tetris::Utils::ImageManager::GAMEMUSIC));
+	assetWatcher.watch(Tetris::Utils::AssetWatcher::IMAGE, Tetris::Utils::ImageManager::TETRIS, Tetris::Utils::ImageManager::getPath(Tetris::Utils::ImageManager::TETRIS));
+	assetWatcher.watch(Tetris::Utils::AssetWatcher::IMAGE, Tetris::Utils::ImageManager::WALL, Tetris::Utils::ImageManager::getPath(Tetris::Utils::ImageManager::WALL));
+	assetWatcher.watch(Tetris::Utils::AssetWatcher::SOUND, Tetris::Utils::SoundManager::GAME_MUSIC, Tetris::Utils::SoundManager::getPath(Tetris::Utils::SoundManager::GAME_MUSIC));
+	assetWatcher.watch(Tetris::Utils::AssetWatcher::SOUND, Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE, Tetris::Utils::SoundManager::getPath(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE));
+	assetWatcher.watch(Tetris::Utils::AssetWatcher::SOUND, Tetris::Utils::SoundManager::CRASH, Tetris::Utils::SoundManager::getPath(Tetris::Utils::SoundManager::CRASH));
+	assetWatcher.start();
 
 	soundManager.playSound(Tetris::Utils::SoundManager::GAME_MUSIC, ALLEGRO_PLAYMODE_BIDIR, 0.6);
 	state = Tetris::Graphics::InformationBox::OVER;
 
-	score = 0;
 	lastHover = nullptr;
 	shouldRun = true;
+	redraw = true;
+	idle = false;
+	nextTickTime = 0;
+	schedulerStats.ticks = 0;
+	schedulerStats.lateTicks = 0;
+	schedulerStats.droppedTicks = 0;
+	steadyStateAllocations = 0;
+	steadyStatePasses = 0;
+	worstPassAllocations = 0;
+	mouseX = 0;
+	mouseY = 0;
+	mouseMoved = false;
+	pendingBurstCount = 0;
+	pendingParticleSeconds = 0;
+	effectTicks = 0;
+	for (int i = 0; i < Tetris::Simulation::MAX_PLAYERS; i++) {
+		boostStartHold[i] = 0;
+	}
+	initHandlers();
 	currDisplay = &mainMenu;
+	if (options.capturePath != nullptr) {
+		capture = new Tetris::Utils::VideoCapture((int)Tetris::Layout::SCREEN_WIDTH, (int)Tetris::Layout::SCREEN_HEIGHT);
+		if (!capture->start(options.capturePath)) {
+			fprintf(stderr, "Could not open %s for capture\n", options.capturePath);
+			delete capture;
+			capture = nullptr;
+		}
+	}
+	if (options.metricsPort > 0) {
+		metricsServer = new Tetris::Utils::MetricsServer(metrics);
+		if (!metricsServer->start(options.metricsPort)) {
+			fprintf(stderr, "Could not serve metrics on port %d\n", options.metricsPort);
+			delete metricsServer;
+			metricsServer = nullptr;
+		}
+	}
+	if (options.broadcastPort > 0) {
+		spectatorServer = new Tetris::Net::SpectatorServer();
+		if (!spectatorServer->start(options.broadcastPort)) {
+			fprintf(stderr, "Could not broadcast on port %d\n", options.broadcastPort);
+			delete spectatorServer;
+			spectatorServer = nullptr;
+		}
+	}
+	if (options.threadedRendering) {
+		// The render thread takes the images while the display is still current here, then owns the display.
+		renderThread = new Tetris::Graphics::RenderThread(gameWindow, imageManager, fontManager);
+		worldView->setImage(Tetris::Utils::ImageManager::TETRIS, imageManager.getImage(Tetris::Utils::ImageManager::TETRIS));
+		worldView->setImage(Tetris::Utils::ImageManager::WALL, imageManager.getImage(Tetris::Utils::ImageManager::WALL));
+		al_set_target_bitmap(NULL);
+		renderThread->setCapture(capture);
+		renderThread->start();
+	}
 	al_start_timer(timer);
 }
 
 /*
-* The main game loop.
+* The main game loop. Timer ticks are serviced from their own queue before anything else so that bursts of input
+* can't make the simulation fall behind. Input and display events are then drained with a bounded budget, and
+* the loop sleeps on the event queue until the next tick is due, which is a long sleep on static screens.
 */
 int Tetris::Game::loop() {
+	nextTickTime = al_get_time() + FPSIncrement;
+	while (shouldRun) {
+		long long allocations = Tetris::Utils::getAllocationCount();
+		long long ticks = schedulerStats.ticks;
+		serviceTimer();
+		drainEvents();
+		pace();
+
+		if (redraw && al_is_event_queue_empty(timerQueue)) {
+			// Update the display
+			redraw = false;
+			display();
+		}
+		if (ticks > WARM_UP_TICKS) {
+			checkAllocations(allocations);
+		}
+		if (shouldRun) {
+			waitForEvents();
+		}
+	}
+	return 0;
+}
+
+/*
+* Runs the ticks that are owed. A tick is late if it is serviced more than a timer period after the timer fired. If
+* the game has fallen more than MAX_CATCH_UP ticks behind the extra ticks are dropped rather than run back to back.
+*/
+void Tetris::Game::serviceTimer() {
+	ALLEGRO_EVENT tickEvent;
+	int owed = 0;
+	double now = al_get_time();
+	double period = al_get_timer_speed(timer);
+	while (al_get_next_event(timerQueue, &tickEvent)) {
+		owed++;
+		if (now - tickEvent.any.timestamp > period) {
+			schedulerStats.lateTicks++;
+			metrics.lateTicks.fetch_add(1, std::memory_order_relaxed);
+		}
+		nextTickTime = tickEvent.any.timestamp + period;
+	}
+	if (owed > MAX_CATCH_UP) {
+		schedulerStats.droppedTicks += owed - MAX_CATCH_UP;
+		metrics.droppedTicks.fetch_add(owed - MAX_CATCH_UP, std::memory_order_relaxed);
+		owed = MAX_CATCH_UP;
+	}
+	for (int i = 0; i < owed; i++) {
+		double start = al_get_time();
+		tick();
+		metrics.tickSeconds.observe(al_get_time() - start);
+		metrics.ticks.fetch_add(1, std::memory_order_relaxed);
+		schedulerStats.ticks++;
+	}
+}
+
+/*
+* Handles up to EVENT_BATCH input and display events, stopping early if a tick becomes due.
+*/
+void Tetris::Game::drainEvents() {
 	ALLEGRO_EVENT nextEvent;
-	bool redraw = false;
+	int handled = 0;
+	while (shouldRun && handled < EVENT_BATCH && al_is_event_queue_empty(timerQueue) && al_get_next_event(eventQueue, &nextEvent)) {
+		dispatch(nextEvent);
+		handled++;
+	}
+	flushMouseMove();
+	metrics.eventsHandled.fetch_add(handled, std::memory_order_relaxed);
+	metrics.eventBatch.store(handled, std::memory_order_relaxed);
+	if (handled == EVENT_BATCH) {
+		metrics.fullBatches.fetch_add(1, std::memory_order_relaxed);
+	}
+}
 
-	float spaceStartHold = 0;
-	float spaceLengthHeld = 0;
+/*
+* Checks whether the screen is one where nothing moves. The main menu always shows the game as over. Pausing
+* freezes the particles, but a crash's particles keep flying after the game is over.
+*/
+bool Tetris::Game::isStatic() {
+	if (state == Tetris::Graphics::InformationBox::PAUSED) {
+		return true;
+	}
+	return (currentScreen() == MENU_SCREEN || state == Tetris::Graphics::InformationBox::OVER) && effectTicks == 0;
+}
 
-	while (shouldRun) {
-		al_wait_for_event(eventQueue, &nextEvent);
+/*
+* Slows the timer down to IDLE_FPS on static screens, where only input changes what is drawn, so the loop spends
+* nearly all its time asleep in waitForEvents. Ticks still run slowly so reloads and spectators keep working. The
+* next tick is expected a period of the new speed from now either way, so waitForEvents sleeps for that long. When
+* the game starts moving again the slow ticks still queued are thrown away and full rate ticks start a frame later.
+*/
+void Tetris::Game::pace() {
+	bool still = isStatic();
+	if (still == idle) {
+		return;
+	}
+	idle = still;
+	double period = idle ? 1.0 / IDLE_FPS : FPSIncrement;
+	al_set_timer_speed(timer, period);
+	if (!idle) {
+		al_flush_event_queue(timerQueue);
+	}
+	nextTickTime = al_get_time() + period;
+}
 
-		if (nextEvent.type == ALLEGRO_EVENT_DISPLAY_CLOSE) {
-			shouldRun = false;
+/*
+* Sleeps on the event queue until an event arrives or the next tick is due. If the tick is already due but hasn't
+* arrived, sleeps on the timer queue until it does rather than spinning back round the loop; input waits for at
+* most one timer period.
+*/
+void Tetris::Game::waitForEvents() {
+	if (!al_is_event_queue_empty(timerQueue) || !al_is_event_queue_empty(eventQueue)) {
+		return;
+	}
+	double wait = nextTickTime - al_get_time();
+	if (wait <= 0) {
+		al_wait_for_event_timed(timerQueue, NULL, (float)al_get_timer_speed(timer));
+		return;
+	}
+	ALLEGRO_TIMEOUT timeout;
+	ALLEGRO_EVENT nextEvent;
+	al_init_timeout(&timeout, wait);
+	if (al_wait_for_event_until(eventQueue, &nextEvent, &timeout)) {
+		dispatch(nextEvent);
+		flushMouseMove();
+	}
+}
+
+/*
+* Counts allocations this thread made since the given allocation count. Only the game loop's thread calls this, so
+* other threads' allocations never count against it. Once warmed up the tick and draw path shouldn't allocate at
+* all, so debug builds report the first pass through the loop that does.
+*/
+void Tetris::Game::checkAllocations(long long since) {
+	long long allocations = Tetris::Utils::getAllocationCount() - since;
+	steadyStatePasses++;
+	if (allocations > worstPassAllocations) {
+		worstPassAllocations = allocations;
+	}
+	if (allocations > 0) {
+#ifdef _DEBUG
+		if (steadyStateAllocations == 0) {
+			fprintf(stderr, "Warning: %lld heap allocations in the steady state tick and draw path\n", allocations);
 		}
-		else if (nextEvent.type == ALLEGRO_EVENT_MOUSE_AXES) {
-			Tetris::Graphics::Rectangle mouse(nextEvent.mouse.x, nextEvent.mouse.y, 2, 2);
-			if (lastHover != nullptr) {
-				if (!lastHover->getBounds().intersects(mouse)) {
-					lastHover->onMouseOut();
-					lastHover = currDisplay->onMouseOver(mouse);
-				}
-				else {
-					lastHover = lastHover->onMouseOver(mouse);
-				}
-			}
-			else {
-				lastHover = currDisplay->onMouseOver(mouse);
+#endif
+		steadyStateAllocations += allocations;
+	}
+}
+
+/*
+* Prints the heap memory used by each subsystem against the budget, followed by what the loop allocated after
+* warming up.
+*/
+void Tetris::Game::reportMemory() {
+	Tetris::Utils::printMemoryReport(stdout, (long long)options.memoryBudget * 1024 * 1024);
+	printf("Loop allocations after warm-up: %lld in %lld passes, at most %lld in one pass\n", steadyStateAllocations, steadyStatePasses, worstPassAllocations);
+}
+
+/*
+* Gets the number of heap allocations made by the loop after it warmed up.
+*/
+long long Tetris::Game::getSteadyStateAllocations() {
+	return steadyStateAllocations;
+}
+
+/*
+* Gets the counters of ticks run, late and dropped.
+*/
+const Tetris::Game::SchedulerStats& Tetris::Game::getSchedulerStats() {
+	return schedulerStats;
+}
+
+/*
+* Fills in the handler table. Event types without a handler for the current screen are ignored.
+*/
+void Tetris::Game::initHandlers() {
+	for (int screen = 0; screen < SCREEN_COUNT; screen++) {
+		for (int type = 0; type < EVENT_TABLE_SIZE; type++) {
+			handlers[screen][type] = nullptr;
+		}
+		handlers[screen][ALLEGRO_EVENT_DISPLAY_CLOSE] = &Tetris::Game::onDisplayClose;
+		handlers[screen][ALLEGRO_EVENT_DISPLAY_RESIZE] = &Tetris::Game::onDisplayResize;
+		handlers[screen][ALLEGRO_EVENT_MOUSE_AXES] = &Tetris::Game::onMouseMove;
+		handlers[screen][ALLEGRO_EVENT_MOUSE_BUTTON_UP] = &Tetris::Game::onMouseClick;
+	}
+	handlers[GAME_SCREEN][ALLEGRO_EVENT_KEY_DOWN] = &Tetris::Game::onGameKeyDown;
+	handlers[GAME_SCREEN][ALLEGRO_EVENT_KEY_UP] = &Tetris::Game::onGameKeyUp;
+	handlers[MENU_SCREEN][ALLEGRO_EVENT_KEY_UP] = &Tetris::Game::onMenuKeyUp;
+}
+
+/*
+* Gets the screen that is currently displayed.
+*/
+Tetris::Game::Screen Tetris::Game::currentScreen() {
+	return currDisplay == &gameScreen ? GAME_SCREEN : MENU_SCREEN;
+}
+
+/*
+* Looks up the handler for the event on the current screen and calls it.
+*/
+void Tetris::Game::dispatch(ALLEGRO_EVENT& event) {
+	if (event.type >= EVENT_TABLE_SIZE) {
+		return;
+	}
+	if (event.type == ALLEGRO_EVENT_MOUSE_BUTTON_UP) {
+		// The click has to see the hover state of the moves that came before it.
+		flushMouseMove();
+	}
+	EventHandler handler = handlers[currentScreen()][event.type];
+	if (handler != nullptr) {
+		(this->*handler)(event);
+		if (event.type != ALLEGRO_EVENT_MOUSE_AXES) {
+			// Static screens are only redrawn when input changes them. Moves only matter if the hover changes.
+			redraw = true;
+		}
+	}
+}
+
+/*
+* Closing the window quits the game.
+*/
+void Tetris::Game::onDisplayClose(ALLEGRO_EVENT& event) {
+	shouldRun = false;
+}
+
+/*
+* Lets the window change size. The frame is scaled to fit it, so nothing has to be laid out again. The render
+* thread owns the display when there is one, so it acknowledges the resize instead.
+*/
+void Tetris::Game::onDisplayResize(ALLEGRO_EVENT& event) {
+	if (renderThread != nullptr) {
+		renderThread->resize();
+	}
+	else {
+		al_acknowledge_resize(gameWindow);
+	}
+}
+
+/*
+* Records the mouse position in logical coordinates. The hit test is done once per batch by flushMouseMove.
+*/
+void Tetris::Game::onMouseMove(ALLEGRO_EVENT& event) {
+	mouseX = (float)event.mouse.x;
+	mouseY = (float)event.mouse.y;
+	Tetris::Graphics::DynamicResolution::toLogical(gameWindow, Tetris::Layout::SCREEN_WIDTH, Tetris::Layout::SCREEN_HEIGHT, mouseX, mouseY);
+	mouseMoved = true;
+}
+
+/*
+* Hit tests the latest mouse position, updating which widget is hovered and asking for a redraw if it changed.
+*/
+void Tetris::Game::flushMouseMove() {
+	if (!mouseMoved) {
+		return;
+	}
+	mouseMoved = false;
+	Tetris::Graphics::Widget* hovered = lastHover;
+	Tetris::Graphics::Rectangle mouse(mouseX, mouseY, 2, 2);
+	if (lastHover != nullptr) {
+		if (!lastHover->getBounds().intersects(mouse)) {
+			lastHover->onMouseOut();
+			lastHover = currDisplay->onMouseOver(mouse);
+		}
+		else {
+			lastHover = lastHover->onMouseOver(mouse);
+		}
+	}
+	else {
+		lastHover = currDisplay->onMouseOver(mouse);
+	}
+	if (lastHover != hovered) {
+		redraw = true;
+	}
+}
+
+/*
+* Passes the click, in logical coordinates, on to the widgets of the current screen.
+*/
+void Tetris::Game::onMouseClick(ALLEGRO_EVENT& event) {
+	float x = (float)event.mouse.x;
+	float y = (float)event.mouse.y;
+	Tetris::Graphics::DynamicResolution::toLogical(gameWindow, Tetris::Layout::SCREEN_WIDTH, Tetris::Layout::SCREEN_HEIGHT, x, y);
+	Tetris::Graphics::Rectangle mouse(x, y, 2, 2);
+	currDisplay->onMouseClick(mouse);
+}
+
+/*
+* Starts timing how long a boost key is held for.
+*/
+void Tetris::Game::onGameKeyDown(ALLEGRO_EVENT& event) {
+	int player = getBoostPlayer(event.keyboard.keycode);
+	if (player != -1) {
+		if (state == Tetris::Graphics::InformationBox::ACTIVE) {
+			boostStartHold[player] = al_current_time();
+		}
+	}
+}
+
+/*
+* Prints the memory report on F9.
+*/
+void Tetris::Game::onMenuKeyUp(ALLEGRO_EVENT& event) {
+	if (event.keyboard.keycode == ALLEGRO_KEY_F9) {
+		reportMemory();
+	}
+}
+
+/*
+* Handles pausing, resuming, restarting, the jet boost and the memory report.
+*/
+void Tetris::Game::onGameKeyUp(ALLEGRO_EVENT& event) {
+	if (event.keyboard.keycode == ALLEGRO_KEY_F9) {
+		reportMemory();
+	}
+	else if (event.keyboard.keycode == ALLEGRO_KEY_ESCAPE) {
+		if (state == Tetris::Graphics::InformationBox::ACTIVE) {
+			// Pause the game
+			state = Tetris::Graphics::InformationBox::PAUSED;
+			info->setState(state);
+			soundManager.stopSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE);
+		}
+		else {
+			// return to main menu
+			submitScores();
+			if (state == Tetris::Graphics::InformationBox::DEMO) {
+				soundManager.stopSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE);
 			}
+			soundManager.playSound(Tetris::Utils::SoundManager::GAME_MUSIC, ALLEGRO_PLAYMODE_BIDIR, 0.6);
+			state = Tetris::Graphics::InformationBox::OVER;
+			info->setState(state);
+			currDisplay = &(mainMenu);
 		}
-		else if (nextEvent.type == ALLEGRO_EVENT_MOUSE_BUTTON_UP) {
-			Tetris::Graphics::Rectangle mouse(nextEvent.mouse.x, nextEvent.mouse.y, 2, 2);
-			currDisplay->onMouseClick(mouse);
+	}
+	else if (event.keyboard.keycode == ALLEGRO_KEY_ENTER) {
+		if (state == Tetris::Graphics::InformationBox::PAUSED) {
+			soundManager.playSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE, ALLEGRO_PLAYMODE_BIDIR, 0.6);
+			state = Tetris::Graphics::InformationBox::ACTIVE;
+			info->setState(state);
 		}
-		else if (nextEvent.type == ALLEGRO_EVENT_KEY_DOWN) {
-			if (nextEvent.keyboard.keycode == ALLEGRO_KEY_SPACE) {
-				if (currDisplay == &(gameScreen)) {
-					if (state == Tetris::Graphics::InformationBox::ACTIVE) {
-						spaceStartHold = al_current_time();
-					}
-				}
+		else if (state == Tetris::Graphics::InformationBox::OVER) {
+			soundManager.playSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE, ALLEGRO_PLAYMODE_BIDIR, 0.6);
+			state = Tetris::Graphics::InformationBox::ACTIVE;
+			info->setState(state);
+			metrics.gamesPlayed.fetch_add(1, std::memory_order_relaxed);
+			reset();
+		}
+	}
+	else if (event.keyboard.keycode == ALLEGRO_KEY_R) {
+		if (state == Tetris::Graphics::InformationBox::OVER) {
+			rewind();
+		}
+	}
+	else if (getBoostPlayer(event.keyboard.keycode) != -1) {
+		if (state == Tetris::Graphics::InformationBox::ACTIVE) {
+			int player = getBoostPlayer(event.keyboard.keycode);
+			float lengthHeld = al_current_time() - boostStartHold[player];
+			if (lengthHeld > tuning.bigBoostHoldTime) {
+				world.boost(tuning.bigBoost, player);
+				burst(Tetris::Graphics::ParticleBurst::BIG_BOOST, player);
+			}
+			else {
+				world.boost(tuning.smallBoost, player);
+				burst(Tetris::Graphics::ParticleBurst::SMALL_BOOST, player);
 			}
 		}
-		else if (nextEvent.type == ALLEGRO_EVENT_KEY_UP) {
-			if (currDisplay == &(gameScreen)) {
-				if (nextEvent.keyboard.keycode == ALLEGRO_KEY_ESCAPE) {
-					if (state == Tetris::Graphics::InformationBox::ACTIVE) {
-						// Pause the game
-						state = Tetris::Graphics::InformationBox::PAUSED;
-						info->setState(state);
-						soundManager.stopSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE);
-					}
-					else {
-						// return to main menu
-						if (state == Tetris::Graphics::InformationBox::DEMO) {
-							soundManager.stopSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE);
-						}
-						soundManager.playSound(Tetris::Utils::SoundManager::GAME_MUSIC, ALLEGRO_PLAYMODE_BIDIR, 0.6);
-						state = Tetris::Graphics::InformationBox::OVER;
-						info->setState(state);
-						currDisplay = &(mainMenu);
-					}
-				}
-				else if (nextEvent.keyboard.keycode == ALLEGRO_KEY_ENTER) {
-					if (state == Tetris::Graphics::InformationBox::PAUSED) {
-						soundManager.playSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE, ALLEGRO_PLAYMODE_BIDIR, 0.6);
-						state = Tetris::Graphics::InformationBox::ACTIVE;
-						info->setState(state);
-					}
-					else if (state == Tetris::Graphics::InformationBox::OVER) {
-						soundManager.playSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE, ALLEGRO_PLAYMODE_BIDIR, 0.6);
-						state = Tetris::Graphics::InformationBox::ACTIVE;
-						info->setState(state);
-						reset();
-					}
-				}
-				else if (nextEvent.keyboard.keycode == ALLEGRO_KEY_SPACE) {
-					if (currDisplay == &(gameScreen)) {
-						if (state == Tetris::Graphics::InformationBox::ACTIVE) {
-							spaceLengthHeld = al_current_time() - spaceStartHold;
-							if (spaceLengthHeld > 0.2f) {
-								tetris->setVelocityY(-120);
-							}
-							else {
-								tetris->setVelocityY(-50);
-							}
-						}
-					}
-				}
+	}
+}
+
+/*
+* Updates the game by one frame.
+*/
+void Tetris::Game::tick() {
+	// Swap in anything that changed on disk before the tick uses it.
+	applyReloads();
+	if (state == Tetris::Graphics::InformationBox::DEMO) {
+		// AI for the demo part of the game
+		for (int i = 0; i < world.playerCount; i++) {
+			float dy = Tetris::Simulation::toFloat(world.dy[world.players[i]]);
+			if (hasDemoNetwork) {
+				demoNetwork.play(world, i, tuning);
+			}
+			else {
+				world.demoMove(tuning, i);
+			}
+			float boosted = Tetris::Simulation::toFloat(world.dy[world.players[i]]);
+			if (boosted != dy) {
+				burst(boosted <= (tuning.smallBoost + tuning.bigBoost) / 2 ? Tetris::Graphics::ParticleBurst::BIG_BOOST : Tetris::Graphics::ParticleBurst::SMALL_BOOST, i);
 			}
 		}
-		else if (nextEvent.type == ALLEGRO_EVENT_TIMER) {
-			redraw = true;
-			// Timer event - Update game here
-			if (state == Tetris::Graphics::InformationBox::DEMO) {
-				// AI for the demo part of the game
-				demoMove();
+	}
+
+	if (state != Tetris::Graphics::InformationBox::PAUSED && state != Tetris::Graphics::InformationBox::OVER) {
+		redraw = true;
+		if (state == Tetris::Graphics::InformationBox::ACTIVE) {
+			history.record(world);
+		}
+		levels.refill(world);
+		unsigned int crashed = world.crashed;
+		Tetris::Simulation::StepResult result = world.step(FPSIncrement);
+		for (int i = 0; i < world.playerCount; i++) {
+			if (world.hasCrashed(i) ? (crashed & (1u << i)) == 0 : result == Tetris::Simulation::SCORED) {
+				burst(world.hasCrashed(i) ? Tetris::Graphics::ParticleBurst::CRASH : Tetris::Graphics::ParticleBurst::SCORE, i);
 			}
+		}
+		if (result == Tetris::Simulation::CRASHED_FLOOR || result == Tetris::Simulation::CRASHED_WALL) {
+			crash(result);
+		}
+		else if (world.crashed != crashed) {
+			// One of several players is out; the rest race on.
+			soundManager.playSound(Tetris::Utils::SoundManager::CRASH, ALLEGRO_PLAYMODE_ONCE, 0.6);
+		}
+		else if (result == Tetris::Simulation::SCORED) {
+			info->updateScores(world);
+		}
+	}
+	if (effectTicks > 0 && state != Tetris::Graphics::InformationBox::PAUSED) {
+		effectTicks--;
+		redraw = true;
+		if (renderThread != nullptr) {
+			pendingParticleSeconds += FPSIncrement;
+		}
+		else {
+			particles.update(FPSIncrement);
+		}
+	}
+	if (spectatorServer != nullptr) {
+		// Frames are numbered from 1 so 0 can mean none sent yet.
+		Tetris::Net::SpectatorFrame frame;
+		Tetris::Net::makeFrame(frame, ++broadcastTick, world, state);
+		spectatorServer->publish(frame);
+	}
+}
 
-			if (state != Tetris::Graphics::InformationBox::PAUSED && state != Tetris::Graphics::InformationBox::OVER) {
-				tetris->update(FPSIncrement);
-				wall1->update(FPSIncrement);
-				wall2->update(FPSIncrement);
-				wall3->update(FPSIncrement);
-
-				Tetris::Graphics::Rectangle TetrisBounds = tetris->getBounds();
-				if (TetrisBounds.getY() < 100) {
-					TetrisBounds.setY(100);
-					tetris->setBounds(TetrisBounds);
-					tetris->setVelocityY(0);
-				}
+/*
+* Ends the game after Tetris crashes into the floor or a wall. The demo just starts over.
+*/
+void Tetris::Game::crash(Tetris::Simulation::StepResult cause) {
+	if (state == Tetris::Graphics::InformationBox::DEMO) {
+		soundManager.stopSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE);
+		soundManager.playSound(Tetris::Utils::SoundManager::CRASH, ALLEGRO_PLAYMODE_ONCE, 0.6);
+		soundManager.playSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE, ALLEGRO_PLAYMODE_BIDIR, 0.6);
+		reset();
+	}
+	else {
+		state = Tetris::Graphics::InformationBox::OVER;
+		info->setState(state);
+		soundManager.stopSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE);
+		soundManager.playSound(Tetris::Utils::SoundManager::CRASH, ALLEGRO_PLAYMODE_ONCE, 0.6);
+		if (cause == Tetris::Simulation::CRASHED_FLOOR) {
+			metrics.floorCrashes.fetch_add(1, std::memory_order_relaxed);
+		}
+		else {
+			metrics.wallCrashes.fetch_add(1, std::memory_order_relaxed);
+		}
+		// Rewinding carries the run on, so its scores only go in the table once it is restarted or left.
+		scoresPending = true;
+		info->updateScores(world);
+	}
+}
 
-				if (TetrisBounds.getY() > 600 - TetrisBounds.getHeight()) {
-					// Crashed down.
-					if (state == Tetris::Graphics::InformationBox::DEMO) {
-						soundManager.stopSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE);
-						soundManager.playSound(Tetris::Utils::SoundManager::CRASH, ALLEGRO_PLAYMODE_ONCE, 0.6);
-						soundManager.playSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE, ALLEGRO_PLAYMODE_BIDIR, 0.6);
-						reset();
-					}
-					else {
-						state = Tetris::Graphics::InformationBox::OVER;
-						info->setState(state);
-						soundManager.stopSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE);
-						soundManager.playSound(Tetris::Utils::SoundManager::CRASH, ALLEGRO_PLAYMODE_ONCE, 0.6);
-					}
-				}
-				else if ((wall1->collides(TetrisBounds)) || (wall2->collides(TetrisBounds)) || (wall3->collides(TetrisBounds))) {
-					// Collided with a wall.
-					if (state == Tetris::Graphics::InformationBox::DEMO) {
-						soundManager.stopSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE);
-						soundManager.playSound(Tetris::Utils::SoundManager::CRASH, ALLEGRO_PLAYMODE_ONCE, 0.6);
-						soundManager.playSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE, ALLEGRO_PLAYMODE_BIDIR, 0.6);
-						reset();
-					}
-					else {
-						state = Tetris::Graphics::InformationBox::OVER;
-						info->setState(state);
-						soundManager.stopSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE);
-						soundManager.playSound(Tetris::Utils::SoundManager::CRASH, ALLEGRO_PLAYMODE_ONCE, 0.6);
-					}
-				}
-				else {
-					Tetris::Graphics::Rectangle* w1 = &front->getBounds();
-					if (w1->getX() < -w1->getWidth()) {
-						score++;
-						info->updateScore(score);
-						w1->setX(back->getBounds().getX() + 3 * w1->getWidth() + 20);
-						front->setBounds(*w1);
-						front->updateGap();
-						back = front;
-						if (front == wall1) {
-							front = wall2;
-						}
-						else if (front == wall2) {
-							front = wall3;
-						}
-						else {
-							front = wall1;
-						}
-					}
-				}
-			}
+/*
+* Gets the player whose boost key this is, or -1 if it isn't one.
+*/
+int Tetris::Game::getBoostPlayer(int keycode) {
+	for (int i = 0; i < world.playerCount; i++) {
+		if (BOOST_KEYS[i] == keycode) {
+			return i;
 		}
+	}
+	return -1;
+}
 
-		if (redraw && al_is_event_queue_empty(eventQueue)) {
-			// Update the display
-			redraw = false;
-			display();
+/*
+* Starts a particle effect at a player: from the jet for boosts, otherwise from its centre. With a render thread
+* the burst waits for the next snapshot, and any past MAX_BURSTS in one snapshot are dropped.
+*/
+void Tetris::Game::burst(Tetris::Graphics::ParticleBurst::Kind kind, int slot) {
+	int player = world.players[slot];
+	Tetris::Graphics::ParticleBurst effect;
+	effect.kind = kind;
+	effect.x = Tetris::Simulation::toFloat(world.x[player]) + Tetris::Simulation::toFloat(world.width[player]) / 2;
+	effect.y = Tetris::Simulation::toFloat(world.y[player]) + Tetris::Simulation::toFloat(world.height[player]) / 2;
+	if (kind == Tetris::Graphics::ParticleBurst::SMALL_BOOST || kind == Tetris::Graphics::ParticleBurst::BIG_BOOST) {
+		effect.x = Tetris::Simulation::toFloat(world.x[player]) + Tetris::Simulation::toFloat(world.width[player]) * 0.3f;
+		effect.y = Tetris::Simulation::toFloat(world.y[player]) + Tetris::Simulation::toFloat(world.height[player]);
+	}
+	if (renderThread != nullptr) {
+		if (pendingBurstCount < Tetris::Graphics::MAX_BURSTS) {
+			pendingBursts[pendingBurstCount++] = effect;
 		}
 	}
-	return 0;
+	else {
+		particles.emit(effect);
+	}
+	effectTicks = (int)(Tetris::Graphics::PARTICLE_MAX_LIFE * FPS) + 1;
+	redraw = true;
+}
+
+/*
+* Puts the world back to how it was REWIND_TICKS ago, or as far back as the history goes, and carries on playing.
+*/
+void Tetris::Game::rewind() {
+	if (!history.rewind(REWIND_TICKS, world)) {
+		return;
+	}
+	scoresPending = false;
+	soundManager.playSound(Tetris::Utils::SoundManager::MISSION_IMPOSSIBLE, ALLEGRO_PLAYMODE_BIDIR, 0.6);
+	state = Tetris::Graphics::InformationBox::ACTIVE;
+	info->setState(state);
+	info->updateScores(world);
+}
+
+/*
+* Submits every player's score from the crashed run, if there is one waiting, and shows the new best.
+*/
+void Tetris::Game::submitScores() {
+	if (!scoresPending) {
+		return;
+	}
+	scoresPending = false;
+	bool best = false;
+	for (int i = 0; i < world.playerCount; i++) {
+		best = highScores.submit(world.getScore(i)) || best;
+	}
+	if (best) {
+		info->updateBest(highScores.getTable().best());
+	}
 }
 
 /*
 * Display the graphics.
 */
 void Tetris::Game::display() {
+	double start = al_get_time();
+	if (renderThread != nullptr) {
+		takeSnapshot(renderThread->beginFrame());
+		renderThread->publish();
+		metrics.drawSeconds.observe(al_get_time() - start);
+		return;
+	}
+	resolution.beginFrame(gameWindow);
 	al_draw_bitmap(imageManager.getImage(Tetris::Utils::ImageManager::GAMEMUSIC), 0, 0, NULL);
 	currDisplay->draw();
+	resolution.endFrame(gameWindow);
+	metrics.drawSeconds.observe(al_get_time() - start);
+	if (capture != nullptr) {
+		// The offscreen frame has the logical size whatever the window's, so recordings aren't cropped by resizing.
+		capture->captureFrame(resolution.getTarget(), al_get_time());
+	}
 	al_flip_display();
 }
 
+/*
+* Copies the state needed to draw a frame into the snapshot, along with the particle bursts and time since the last one.
+*/
+void Tetris::Game::takeSnapshot(Tetris::FrameSnapshot& frame) {
+	frame.screen = currentScreen() == GAME_SCREEN ? Tetris::FrameSnapshot::GAME : Tetris::FrameSnapshot::MENU;
+	frame.hoveredButton = -1;
+	if (lastHover == play) {
+		frame.hoveredButton = 0;
+	}
+	else if (lastHover == demo) {
+		frame.hoveredButton = 1;
+	}
+	else if (lastHover == quit) {
+		frame.hoveredButton = 2;
+	}
+	frame.world = world;
+	frame.bestScore = highScores.getTable().best();
+	frame.state = state;
+	frame.burstCount = pendingBurstCount;
+	for (int i = 0; i < pendingBurstCount; i++) {
+		frame.bursts[i] = pendingBursts[i];
+	}
+	frame.particleSeconds = pendingParticleSeconds;
+	pendingBurstCount = 0;
+	pendingParticleSeconds = 0;
+}
+
 /*
 * Implements the play button being clicked.
 */
 void Tetris::Game::PlayButton::onClick() {
+	game->metrics.gamesPlayed.fetch_add(1, std::memory_order_relaxed);
 	game->state = Tetris::Graphics::InformationBox::ACTIVE;
 	game->info->setState(game->state);
 	game->currDisplay = &game->gameScreen;
@@ -319,36 +815,61 @@ void Tetris::Game::QuitButton::onClick() {
 * Resets the game.
 */
 void Tetris::Game::reset() {
-	tetris->setPosition(50, 250);
-	tetris->setVelocityY(0);
-	score = 0;
-	info->updateScore(score);
-	wall1->setPosition(480, 100);
-	wall2->setPosition(980, 100);
-	wall3->setPosition(1460, 100);
-	front = wall1;
-	back = wall3;
+	submitScores();
+	world.reset();
+	history.clear();
+	info->updateScores(world);
 }
 
 /*
-* Simulated AI to decide whether the robot should move or not.
+* Pushes the tuning values to the world.
 */
-void Tetris::Game::demoMove() {
-	Tetris::Graphics::Rectangle nextWallBounds = front->getBounds();
-	Tetris::Graphics::Rectangle TetrisBounds = tetris->getBounds();
+void Tetris::Game::applyTuning() {
+	world.applyTuning(tuning);
+	levels.configure(tuning, world);
+}
 
-	int gapY = 100 + 100 * front->getGapPosition();			// The y position of the gap.
-	if (TetrisBounds.getY() < gapY) {
-		// Tetris is above the gap position - Let gravity pull him down
-	}
-	else if (TetrisBounds.getY()> gapY + nextWallBounds.getHeight()) {
-		// Tetris is below the gap position
-		tetris->setVelocityY(-120);
+/*
+* Swaps in assets and tuning values the watcher has reloaded since the last tick. Images come in as memory
+* bitmaps and are cloned on the thread that owns the display so they end up as video bitmaps.
+*/
+void Tetris::Game::applyReloads() {
+	if (!assetWatcher.takeReloads(reloads)) {
+		return;
 	}
-	else {
-		// Tetris is line up in between the gap - Do little jump when he gets to a certain y coordinate just above the wall.
-		if (TetrisBounds.getY() + TetrisBounds.getHeight() > gapY + nextWallBounds.getHeight() - 10) {
-			tetris->setVelocityY(-50);
+	Tetris::Utils::MemoryScope scope(Tetris::Utils::MEMORY_IMAGES);
+	redraw = true;
+	for (Tetris::Utils::AssetWatcher::Reload& reload : reloads) {
+		if (reload.kind == Tetris::Utils::AssetWatcher::TUNING) {
+			tuning = reload.tuning;
+			applyTuning();
+		}
+		else if (reload.kind == Tetris::Utils::AssetWatcher::IMAGE) {
+			Tetris::Utils::ImageManager::Image id = (Tetris::Utils::ImageManager::Image)reload.id;
+			ALLEGRO_BITMAP* image = reload.image;
+			if (renderThread == nullptr) {
+				image = al_clone_bitmap(reload.image);
+				al_destroy_bitmap(reload.image);
+				if (image == nullptr) {
+					continue;
+				}
+			}
+			ALLEGRO_BITMAP* old = imageManager.replaceImage(id, image);
+			world.setImageSize(id, al_get_bitmap_width(image), al_get_bitmap_height(image));
+			levels.configure(tuning, world);
+			worldView->setImage(id, image);
+			if (renderThread != nullptr) {
+				// Only the render thread can use the display, so it uploads the new image and frees the old one.
+				// This thread keeps the memory bitmap for sizing and masks.
+				renderThread->replaceImage(id, al_clone_bitmap(image), old);
+			}
+			else {
+				al_destroy_bitmap(old);
+			}
+		}
+		else if (reload.kind == Tetris::Utils::AssetWatcher::SOUND) {
+			soundManager.replaceSound((Tetris::Utils::SoundManager::SoundTrack)reload.id, reload.sample);
 		}
 	}
+	reloads.clear();
 }
\ No newline at end of file
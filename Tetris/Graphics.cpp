@@ -2,11 +2,34 @@
 
 #include <string>
 #include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
 #include <allegro5/allegro_primitives.h>
 #include "graphics.h"
 #include "utils.h"
 
+/*
+* Sets the clipping rectangle from logical coordinates. Clipping works in pixels of the target bitmap, so the
+* rectangle is put through the current transform, which scales it when drawing at a different resolution.
+*/
+static void setLogicalClipping(float x, float y, float width, float height) {
+	const ALLEGRO_TRANSFORM* transform = al_get_current_transform();
+	float left = x, top = y, right = x + width, bottom = y + height;
+	if (transform != nullptr) {
+		al_transform_coordinates(transform, &left, &top);
+		al_transform_coordinates(transform, &right, &bottom);
+	}
+	int pixelLeft = (int)floorf(left);
+	int pixelTop = (int)floorf(top);
+	al_set_clipping_rectangle(pixelLeft, pixelTop, (int)ceilf(right) - pixelLeft, (int)ceilf(bottom) - pixelTop);
+}
+
 // ========================Rectangle===============================
+/*
+* Creates an empty rectangle at the origin.
+*/
+Tetris::Graphics::Rectangle::Rectangle() : x(0), y(0), width(0), height(0) {}
+
 /*
 * Creates a new rectangle with the given bounds.
 */
@@ -127,6 +150,16 @@ void Tetris::Graphics::Displayable::setPosition(float x, float y) {
 */
 void Tetris::Graphics::Displayable::setBounds(Tetris::Graphics::Rectangle bounds) {
 	this->bounds = bounds;
+	if (parent != nullptr) {
+		parent->invalidateGrid();
+	}
+}
+
+/*
+* Sets the panel this object was added to.
+*/
+void Tetris::Graphics::Displayable::setParent(Tetris::Graphics::Panel* parent) {
+	this->parent = parent;
 }
 
 // ===============================Panel================================================
@@ -138,6 +171,8 @@ void Tetris::Graphics::Panel::addWidget(Tetris::Graphics::Panel::Widget* widget)
 	Tetris::Graphics::Rectangle widgetBounds = widget->getBounds();
 	widgetBounds.setBounds(widgetBounds.getX() + panelBounds.getX(), widgetBounds.getY() + panelBounds.getY(), widgetBounds.getWidth(), widgetBounds.getHeight());
 	widgets.push_back(widget);
+	widget->setParent(this);
+	gridDirty = true;
 }
 
 /*
@@ -147,7 +182,7 @@ void Tetris::Graphics::Panel::draw() {
 	int x, y, width, height;
 	al_get_clipping_rectangle(&x, &y, &width, &height);
 	Tetris::Graphics::Rectangle bounds = getBounds();
-	al_set_clipping_rectangle(bounds.getX(), bounds.getY(), bounds.getWidth(), bounds.getHeight());
+	setLogicalClipping(bounds.getX(), bounds.getY(), bounds.getWidth(), bounds.getHeight());
 	for (Widget* w : widgets) {
 		w->draw();
 	}
@@ -158,10 +193,9 @@ void Tetris::Graphics::Panel::draw() {
 * Called when the mouse is hovering over the widget.
 */
 Tetris::Graphics::Widget* Tetris::Graphics::Panel::onMouseOver(Tetris::Graphics::Rectangle mouse) {
-	for (Widget* w : widgets) {
-		if (w->getBounds().intersects(mouse)) {
-			return w->onMouseOver(mouse);
-		}
+	Widget* w = widgetAt(mouse);
+	if (w != nullptr) {
+		return w->onMouseOver(mouse);
 	}
 	return nullptr;
 }
@@ -170,12 +204,103 @@ Tetris::Graphics::Widget* Tetris::Graphics::Panel::onMouseOver(Tetris::Graphics:
 * Called when the mouse is hovering over the widget.
 */
 void Tetris::Graphics::Panel::onMouseClick(Tetris::Graphics::Rectangle mouse) {
+	Widget* w = widgetAt(mouse);
+	if (w != nullptr) {
+		w->onMouseClick(mouse);
+	}
+}
+
+/*
+* Marks the hit testing grid as out of date.
+*/
+void Tetris::Graphics::Panel::invalidateGrid() {
+	gridDirty = true;
+}
+
+/*
+* Finds the first widget added to the panel that intersects the mouse. Only the widgets in the grid cells under
+* the mouse are tested, and the lowest index wins so the result matches testing every widget in order.
+*/
+Tetris::Graphics::Widget* Tetris::Graphics::Panel::widgetAt(Tetris::Graphics::Rectangle mouse) {
+	Tetris::Graphics::Rectangle bounds = getBounds();
+	if (gridDirty || bounds.getX() != gridBounds.getX() || bounds.getY() != gridBounds.getY() ||
+		bounds.getWidth() != gridBounds.getWidth() || bounds.getHeight() != gridBounds.getHeight()) {
+		rebuildGrid();
+	}
+	int firstColumn, lastColumn, firstRow, lastRow;
+	cellRange(mouse, firstColumn, lastColumn, firstRow, lastRow);
+	int found = -1;
+	for (int row = firstRow; row <= lastRow; row++) {
+		for (int column = firstColumn; column <= lastColumn; column++) {
+			int cell = row * columns + column;
+			for (int i = cellStart[cell]; i < cellStart[cell + 1]; i++) {
+				int index = cellWidgets[i];
+				if ((found == -1 || index < found) && widgetBounds[index].intersects(mouse)) {
+					found = index;
+				}
+			}
+		}
+	}
+	return found == -1 ? nullptr : widgets[found];
+}
+
+/*
+* Rebuilds the hit testing grid. The widgets are bucketed by a counting sort into one array so that rebuilding
+* reuses the same storage every time.
+*/
+void Tetris::Graphics::Panel::rebuildGrid() {
+	gridBounds = getBounds();
+	columns = (int)(gridBounds.getWidth() / CELL_SIZE) + 1;
+	rows = (int)(gridBounds.getHeight() / CELL_SIZE) + 1;
+	widgetBounds.clear();
 	for (Widget* w : widgets) {
-		if (w->getBounds().intersects(mouse)) {
-			w->onMouseClick(mouse);
-			break;
+		widgetBounds.push_back(w->getBounds());
+	}
+
+	// Count the widgets in each cell, turn the counts into start positions, then fill the cells.
+	cellStart.assign(columns * rows + 1, 0);
+	int firstColumn, lastColumn, firstRow, lastRow;
+	for (Rectangle& rect : widgetBounds) {
+		cellRange(rect, firstColumn, lastColumn, firstRow, lastRow);
+		for (int row = firstRow; row <= lastRow; row++) {
+			for (int column = firstColumn; column <= lastColumn; column++) {
+				cellStart[row * columns + column + 1]++;
+			}
+		}
+	}
+	for (int cell = 0; cell < columns * rows; cell++) {
+		cellStart[cell + 1] += cellStart[cell];
+	}
+	cellWidgets.resize(cellStart[columns * rows]);
+	for (int index = 0; index < (int)widgetBounds.size(); index++) {
+		cellRange(widgetBounds[index], firstColumn, lastColumn, firstRow, lastRow);
+		for (int row = firstRow; row <= lastRow; row++) {
+			for (int column = firstColumn; column <= lastColumn; column++) {
+				// cellStart is used as the insertion point and shifted back below.
+				cellWidgets[cellStart[row * columns + column]++] = index;
+			}
 		}
 	}
+	for (int cell = columns * rows; cell > 0; cell--) {
+		cellStart[cell] = cellStart[cell - 1];
+	}
+	cellStart[0] = 0;
+	gridDirty = false;
+}
+
+/*
+* Gets the column and row ranges of the grid cells the rectangle covers. Anything outside the panel is clamped to
+* the edge cells, which keeps overlapping rectangles in overlapping cells.
+*/
+void Tetris::Graphics::Panel::cellRange(Tetris::Graphics::Rectangle& rect, int& firstColumn, int& lastColumn, int& firstRow, int& lastRow) {
+	float left = (rect.getX() - gridBounds.getX()) / CELL_SIZE;
+	float right = (rect.getX() + rect.getWidth() - gridBounds.getX()) / CELL_SIZE;
+	float top = (rect.getY() - gridBounds.getY()) / CELL_SIZE;
+	float bottom = (rect.getY() + rect.getHeight() - gridBounds.getY()) / CELL_SIZE;
+	firstColumn = left < 0 ? 0 : (left >= columns ? columns - 1 : (int)left);
+	lastColumn = right < 0 ? 0 : (right >= columns ? columns - 1 : (int)right);
+	firstRow = top < 0 ? 0 : (top >= rows ? rows - 1 : (int)top);
+	lastRow = bottom < 0 ? 0 : (bottom >= rows ? rows - 1 : (int)bottom);
 }
 
 /*
@@ -222,7 +347,7 @@ void Tetris::Graphics::Label::draw() {
 	int x, y, width, height;
 	al_get_clipping_rectangle(&x, &y, &width, &height);
 	Tetris::Graphics::Rectangle bounds = getBounds();
-	al_set_clipping_rectangle(bounds.getX() - 10, bounds.getY() - 10, bounds.getX() + bounds.getWidth() + 10, bounds.getY() + bounds.getHeight() + 10);
+	setLogicalClipping(bounds.getX() - 10, bounds.getY() - 10, bounds.getX() + bounds.getWidth() + 10, bounds.getY() + bounds.getHeight() + 10);
 	al_draw_text(font, colour, bounds.getX(), bounds.getY(), ALLEGRO_ALIGN_LEFT, label.c_str());
 	al_set_clipping_rectangle(x, y, width, height);
 }
@@ -261,91 +386,13 @@ void Tetris::Graphics::Button::draw() {
 	int x, y, width, height;
 	al_get_clipping_rectangle(&x, &y, &width, &height);
 	Tetris::Graphics::Rectangle bounds = getBounds();
-	al_set_clipping_rectangle(bounds.getX() - 10, bounds.getY() - 10, bounds.getX() + bounds.getWidth() + 10, bounds.getY() + bounds.getHeight() + 10);
+	setLogicalClipping(bounds.getX() - 10, bounds.getY() - 10, bounds.getX() + bounds.getWidth() + 10, bounds.getY() + bounds.getHeight() + 10);
 	ALLEGRO_COLOR back = hover ? hoverBack : normalBack;
 	al_draw_filled_rounded_rectangle(bounds.getX() - 10, bounds.getY() - 10, bounds.getX() + bounds.getWidth() + 10, bounds.getY() + bounds.getHeight() + 10, 5, 5, back);
 	al_draw_text(font, colour, bounds.getX(), bounds.getY(), ALLEGRO_ALIGN_LEFT, label.c_str());
 	al_set_clipping_rectangle(x, y, width, height);
 }
 
-// ====================Sprite==================================
-/*
-* Sets the velocity of the sprite.
-*/
-void Tetris::Graphics::Sprite::setVelocity(float dx, float dy) {
-	this->dx = dx;
-	this->dy = dy;
-}
-
-/*
-* Gets the horizontal velocity.
-*/
-float Tetris::Graphics::Sprite::getVelocityX() {
-	return dx;
-}
-
-/*
-* Sets the horizontal velocity.
-*/
-void Tetris::Graphics::Sprite::setVelocityX(float dx) {
-	this->dx = dx;
-}
-
-/*
-* Gets the vertical velocity.
-*/
-float Tetris::Graphics::Sprite::getVelocityY() {
-	return dy;
-}
-
-/*
-* Sets the vertical velocity.
-*/
-void Tetris::Graphics::Sprite::setVelocityY(float dy) {
-	this->dy = dy;
-}
-
-/*
-* Updates the position of the sprite based on its velocity and time elapsed.
-*/
-void Tetris::Graphics::Sprite::update(float delta) {
-	Tetris::Graphics::Rectangle bounds = getBounds();
-	float x = bounds.getX() + dx*delta;
-	float y = bounds.getY() + dy*delta;
-	bounds.setX(x);
-	bounds.setY(y);
-	setBounds(bounds);
-}
-
-/*
-* Sets the image of the sprite.
-*/
-void Tetris::Graphics::Sprite::setImage(ALLEGRO_BITMAP* image) {
-	this->image = image;
-	Tetris::Graphics::Rectangle bounds = getBounds();
-	bounds.setWidth(al_get_bitmap_width(image));
-	bounds.setHeight(al_get_bitmap_height(image));
-	setBounds(bounds);
-}
-
-/*
-* Sets the image of the sprite.
-*/
-void Tetris::Graphics::Sprite::draw() {
-	Tetris::Graphics::Rectangle bounds = getBounds();
-	al_draw_bitmap(image, bounds.getX(), bounds.getY(), NULL);
-}
-
-/*
-* Creates a new sprite with the given image.
-*/
-Tetris::Graphics::Sprite::Sprite(ALLEGRO_BITMAP* i) : image(i) {
-	Tetris::Graphics::Rectangle bounds = getBounds();
-	bounds.setWidth(al_get_bitmap_width(i));
-	bounds.setHeight(al_get_bitmap_height(i));
-	setBounds(bounds);
-}
-
 // =======================InformationBox==========================
 /*
 * Creates a new Information Box.
@@ -356,6 +403,9 @@ Tetris::Graphics::InformationBox::InformationBox(float width, float height, ALLE
 	bounds.setHeight(height);
 	setBounds(bounds);
 	this->font = font;
+	state = OVER;
+	updateScore(0);
+	updateBest(0);
 }
 
 /*
@@ -363,6 +413,30 @@ Tetris::Graphics::InformationBox::InformationBox(float width, float height, ALLE
 */
 void Tetris::Graphics::InformationBox::updateScore(int score) {
 	this->score = score;
+	sprintf(scoreText, "Score: %d", score);
+}
+
+/*
+* Updates the score to be displayed from the world, showing every player's score when there are several.
+*/
+void Tetris::Graphics::InformationBox::updateScores(const Tetris::Simulation::World& world) {
+	if (world.playerCount <= 1) {
+		updateScore(world.score);
+		return;
+	}
+	score = world.score;
+	int used = 0;
+	for (int i = 0; i < world.playerCount; i++) {
+		used += sprintf(scoreText + used, i == 0 ? "P%d: %d" : "  P%d: %d", i + 1, world.getScore(i));
+	}
+}
+
+/*
+* Updates the best score to be displayed.
+*/
+void Tetris::Graphics::InformationBox::updateBest(int best) {
+	this->best = best;
+	sprintf(bestText, "Best: %d", best);
 }
 
 /*
@@ -377,12 +451,10 @@ void Tetris::Graphics::InformationBox::setState(State state) {
 * Draws the InformationBox.
 */
 void Tetris::Graphics::InformationBox::draw() {
-	std::string scoreT = "Score: ";
-	scoreT.append(std::to_string(score));
-	const char *scoreText = scoreT.c_str();
 	Tetris::Graphics::Rectangle bounds = getBounds();
 	al_draw_filled_rectangle(0, 0, bounds.getWidth(), bounds.getHeight(), black);
-	al_draw_text(font, white, 20, 35, ALLEGRO_ALIGN_LEFT, scoreText);
+	al_draw_text(font, white, 20, 25, ALLEGRO_ALIGN_LEFT, scoreText);
+	al_draw_text(font, white, 20, 55, ALLEGRO_ALIGN_LEFT, bestText);
 	if (state == PAUSED) {
 		al_draw_text(font, white, 250, 35, ALLEGRO_ALIGN_LEFT, "Game Paused [Press Esc to quit or Enter to resume]");
 	}
@@ -395,114 +467,99 @@ void Tetris::Graphics::InformationBox::draw() {
 		al_draw_text(font, white, 250, 70, ALLEGRO_ALIGN_LEFT, "For a big jet boost hold the spacebar key for a bit longer");
 	}
 	else {
-		al_draw_text(font, white, 250, 35, ALLEGRO_ALIGN_LEFT, "Game Over! [Press Esc to quit or Enter to restart]");
+		al_draw_text(font, white, 250, 35, ALLEGRO_ALIGN_LEFT, "Game Over! [Esc to quit, Enter to restart or R to rewind]");
 	}
 }
 
-// =======================TetrisSprite==================================
+// =======================WorldView==================================
 /*
-* Updates Tetris's velocity by applying gravity.
+* Creates a view with nothing to draw.
 */
-void Tetris::Graphics::TetrisSprite::update(float delta) {
-	dy += gravity*delta;
-	if (dy > 110) {
-		dy = 110;
+Tetris::Graphics::WorldView::WorldView() : world(nullptr), particles(nullptr) {
+	for (int i = 0; i < 3; i++) {
+		images[i] = nullptr;
 	}
-	Tetris::Graphics::Sprite::update(delta);
 }
 
-// ======================Wall======================================
 /*
-* Creates a new wall sprite.
+* Sets the world to draw.
 */
-Tetris::Graphics::Wall::Wall(ALLEGRO_BITMAP* w, int gapPosition) : Sprite(w) {
-	srand(time(NULL));
-	this->gapPosition = gapPosition;
-	Tetris::Graphics::Rectangle bounds = getBounds();
-	for (int i = 0; i < 4; i++) {
-		walls[i] = new Tetris::Graphics::Rectangle(0, 0, bounds.getWidth(), bounds.getHeight());
-	}
-	updateWalls();
+void Tetris::Graphics::WorldView::setWorld(const Tetris::Simulation::World* world) {
+	this->world = world;
 }
 
 /*
-* Frees allocated memory.
+* Sets the particles drawn over the world, or null for none.
 */
-Tetris::Graphics::Wall::~Wall() {
-	for (int i = 0; i < 4; i++) {
-		delete walls[i];
-	}
+void Tetris::Graphics::WorldView::setParticles(Tetris::Graphics::ParticleSystem* particles) {
+	this->particles = particles;
 }
 
 /*
-* Updates the position of the gap by generating a random number between 1 and 3.
+* Sets the bitmap drawn for entities with the given image.
 */
-void Tetris::Graphics::Wall::updateGap() {
-	gapPosition = (rand() % 4) + 0;
-	updateWalls();
+void Tetris::Graphics::WorldView::setImage(Tetris::Utils::ImageManager::Image image, ALLEGRO_BITMAP* bitmap) {
+	images[image] = bitmap;
 }
 
 /*
-* Updates the bounds of the wall rectangles.
+* The tint each player is drawn with so players sharing the canvas can be told apart. The first player is drawn
+* as it is.
 */
-void Tetris::Graphics::Wall::updateWalls() {
-	Tetris::Graphics::Rectangle mainWall = getBounds();
-	Tetris::Graphics::Rectangle* wallBounds;
-
-	int pos = 0;
-	for (int i = 0; i < 5; i++) {
-		if (gapPosition == i) {
-			continue;
-		}
-		else {
-			wallBounds = walls[pos];
-			wallBounds->setX(mainWall.getX());
-			wallBounds->setY(100 + 100 * i);
-			pos++;
-		}
+static ALLEGRO_COLOR playerTint(int slot) {
+	switch (slot) {
+	case 1:
+		return al_map_rgb(255, 140, 140);
+	case 2:
+		return al_map_rgb(140, 255, 140);
+	case 3:
+		return al_map_rgb(140, 170, 255);
+	default:
+		return al_map_rgb(255, 255, 255);
 	}
 }
 
 /*
-* Checks whether the rectangle collides with the wall.
+* Draws every renderable entity in the order they were created. Walls are drawn once for each row that isn't the
+* gap, and players with their tint, faded once they have crashed if others are still flying. The particles go on
+* top of everything.
 */
-bool Tetris::Graphics::Wall::collides(Tetris::Graphics::Rectangle rect) {
-	for (Tetris::Graphics::Rectangle*wall : walls) {
-		if (wall->intersects(rect)) {
-			return true;
+void Tetris::Graphics::WorldView::draw() {
+	if (world == nullptr) {
+		return;
+	}
+	for (int i = 0; i < world->entityCount; i++) {
+		unsigned int components = world->components[i];
+		if ((components & (Tetris::Simulation::RENDERABLE | Tetris::Simulation::POSITION)) != (Tetris::Simulation::RENDERABLE | Tetris::Simulation::POSITION)) {
+			continue;
+		}
+		ALLEGRO_BITMAP* image = images[world->image[i]];
+		if (image == nullptr) {
+			continue;
+		}
+		if (components & Tetris::Simulation::WALL) {
+			for (int row = 0; row < Tetris::Simulation::WALL_ROWS; row++) {
+				if (row != world->gapPosition[i]) {
+					al_draw_bitmap(image, Tetris::Simulation::toFloat(world->x[i]), Tetris::Simulation::TOP + Tetris::Simulation::ROW_HEIGHT * row, NULL);
+				}
+			}
+		}
+		else if ((components & Tetris::Simulation::PLAYER) && world->playerCount > 1) {
+			int slot = 0;
+			while (slot < world->playerCount - 1 && world->players[slot] != i) {
+				slot++;
+			}
+			ALLEGRO_COLOR tint = playerTint(slot);
+			if (world->hasCrashed(slot)) {
+				tint = al_map_rgba_f(tint.r * 0.4f, tint.g * 0.4f, tint.b * 0.4f, 0.4f);
+			}
+			al_draw_tinted_bitmap(image, tint, Tetris::Simulation::toFloat(world->x[i]), Tetris::Simulation::toFloat(world->y[i]), NULL);
+		}
+		else {
+			al_draw_bitmap(image, Tetris::Simulation::toFloat(world->x[i]), Tetris::Simulation::toFloat(world->y[i]), NULL);
 		}
 	}
-	return false;
-}
-
-/*
-* Updates the wall and each wall segments bounds.
-*/
-void Tetris::Graphics::Wall::update(float delta) {
-	Tetris::Graphics::Sprite::update(delta);
-	updateWalls();
-}
-
-/*
-* Draws the wall with the gap.
-*/
-void Tetris::Graphics::Wall::draw() {
-	for (Tetris::Graphics::Rectangle*wall : walls) {
-		al_draw_bitmap(image, wall->getX(), wall->getY(), NULL);
+	if (particles != nullptr) {
+		particles->draw();
 	}
 }
-
-/*
-* Need to update the wall bounds when the position is changed.
-*/
-void Tetris::Graphics::Wall::setPosition(float x, float y) {
-	Tetris::Graphics::Sprite::setPosition(x, y);
-	updateWalls();
-}
-
-/*
-* The position of the gap.
-*/
-int Tetris::Graphics::Wall::getGapPosition() {
-	return gapPosition;
-}
\ No newline at end of file
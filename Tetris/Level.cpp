@@ -0,0 +1,238 @@
+// Level.cpp implements the generator that plans fair sequences of wall gaps ahead of the game
+
+#include <math.h>
+#include <chrono>
+#include "level.h"
+#include "allocation.h"
+
+/*
+* The difficulty given to a move that can't be made at all, such as into a gap too small for the player.
+*/
+static const float IMPOSSIBLE = 1000;
+
+/*
+* The highest and lowest top edge the player can have while passing through a gap without touching the wall.
+*/
+static float gapLow(int gap, float wallHeight) {
+	return gap == 0 ? Tetris::Simulation::TOP : Tetris::Simulation::TOP + Tetris::Simulation::ROW_HEIGHT * (gap - 1) + wallHeight;
+}
+
+static float gapHigh(int gap, float playerHeight) {
+	return Tetris::Simulation::TOP + Tetris::Simulation::ROW_HEIGHT * (gap + 1) - playerHeight;
+}
+
+// =========================ReachabilityGraph==================================
+/*
+* Works out how far the player can climb and fall in the time between leaving one wall and reaching the next,
+* then how much of that each move between gaps needs. Climbing assumes the player keeps boosting at the big boost
+* speed; falling starts from rest and is limited by the terminal velocity. Walls are recycled 3 wall widths plus the
+* spacing apart.
+*/
+void Tetris::Simulation::ReachabilityGraph::build(const Tetris::Utils::Tuning& tuning, float playerWidth, float playerHeight, float wallWidth, float wallHeight) {
+	float speed = fabsf(tuning.wallSpeed);
+	float distance = 3 * wallWidth + tuning.wallSpacing;
+	wallInterval = speed > 0 ? distance / speed : 0;
+	float freeTime = speed > 0 ? (distance - wallWidth - playerWidth) / speed : 0;
+	if (freeTime < 0) {
+		freeTime = 0;
+	}
+	float climb = fabsf(tuning.bigBoost) * freeTime;
+	float fall;
+	float terminalTime = tuning.gravity > 0 ? tuning.terminalVelocity / tuning.gravity : freeTime;
+	if (freeTime < terminalTime) {
+		fall = tuning.gravity * freeTime * freeTime / 2;
+	}
+	else {
+		fall = tuning.gravity * terminalTime * terminalTime / 2 + tuning.terminalVelocity * (freeTime - terminalTime);
+	}
+
+	hardest = 0;
+	for (int from = 0; from < GAP_ROWS; from++) {
+		for (int to = 0; to < GAP_ROWS; to++) {
+			float fromLow = gapLow(from, wallHeight);
+			float fromHigh = gapHigh(from, playerHeight);
+			float toLow = gapLow(to, wallHeight);
+			float toHigh = gapHigh(to, playerHeight);
+			float cost = 0;
+			if (fromHigh < fromLow || toHigh < toLow) {
+				cost = IMPOSSIBLE;
+			}
+			else if (toHigh < fromLow) {
+				cost = climb > 0 ? (fromLow - toHigh) / climb : IMPOSSIBLE;
+			}
+			else if (toLow > fromHigh) {
+				cost = fall > 0 ? (toLow - fromHigh) / fall : IMPOSSIBLE;
+			}
+			difficulty[from][to] = cost;
+			if (cost <= 1 && cost > hardest) {
+				hardest = cost;
+			}
+		}
+	}
+}
+
+// =========================LevelGenerator==================================
+/*
+* Creates a generator that isn't running yet.
+*/
+Tetris::Simulation::LevelGenerator::LevelGenerator() : targetSurvival(60), wallInterval(0), difficulty(0), randomState(1), running(false) {
+	Tetris::Utils::Tuning tuning;
+	graph.build(tuning, 0, 0, 0, 0);
+}
+
+/*
+* Stops the background thread.
+*/
+Tetris::Simulation::LevelGenerator::~LevelGenerator() {
+	stop();
+}
+
+/*
+* Rebuilds the reachability graph for the tuning values and the collider sizes in the world.
+*/
+void Tetris::Simulation::LevelGenerator::configure(const Tetris::Utils::Tuning& tuning, const World& world) {
+	ReachabilityGraph built;
+	built.build(tuning, toFloat(world.width[world.player]), toFloat(world.height[world.player]),
+		toFloat(world.width[world.walls[0]]), toFloat(world.height[world.walls[0]]));
+	std::lock_guard<std::mutex> guard(configLock);
+	graph = built;
+	targetSurvival = tuning.targetSurvival;
+	wallInterval = built.wallInterval;
+}
+
+/*
+* Starts the background thread.
+*/
+void Tetris::Simulation::LevelGenerator::start(unsigned int seed) {
+	if (running) {
+		return;
+	}
+	randomState = seed != 0 ? seed : 1;
+	running = true;
+	thread = std::thread(&LevelGenerator::run, this);
+}
+
+/*
+* Stops the background thread.
+*/
+void Tetris::Simulation::LevelGenerator::stop() {
+	if (!running) {
+		return;
+	}
+	running = false;
+	thread.join();
+}
+
+/*
+* Copies ready segments into the world while it has room for them, each following on from the last gap queued. If
+* the background thread hasn't made one yet the world picks the gap itself when it needs one.
+*/
+void Tetris::Simulation::LevelGenerator::refill(World& world) {
+	while (world.gapCount + SEGMENT_LENGTH <= GAP_QUEUE) {
+		// The walls on screen already have their gaps, so the first queued gap is for the wall after them.
+		int tier = getTier(world.score + WALL_COUNT + world.gapCount);
+		GapSegment segment;
+		if (!ready[world.getLastGap()][tier].pop(segment)) {
+			return;
+		}
+		world.queueGaps(segment.gaps, SEGMENT_LENGTH);
+		difficulty = segment.difficulty;
+	}
+}
+
+/*
+* Gets the difficulty of the last segment given to the world.
+*/
+float Tetris::Simulation::LevelGenerator::getDifficulty() {
+	return difficulty;
+}
+
+/*
+* Keeps a segment waiting for every gap and tier. A segment that doesn't fit is kept until there is room for it
+* rather than thrown away.
+*/
+void Tetris::Simulation::LevelGenerator::run() {
+	Tetris::Utils::setMemoryTag(Tetris::Utils::MEMORY_SIMULATION);
+	GapSegment spare[GAP_ROWS][DIFFICULTY_TIERS];
+	bool hasSpare[GAP_ROWS][DIFFICULTY_TIERS] = {};
+	while (running) {
+		ReachabilityGraph current;
+		{
+			std::lock_guard<std::mutex> guard(configLock);
+			current = graph;
+		}
+		for (int from = 0; from < GAP_ROWS; from++) {
+			for (int tier = 0; tier < DIFFICULTY_TIERS; tier++) {
+				while (true) {
+					if (!hasSpare[from][tier]) {
+						makeSegment(current, from, tier, spare[from][tier]);
+						hasSpare[from][tier] = true;
+					}
+					if (!ready[from][tier].push(spare[from][tier])) {
+						break;
+					}
+					hasSpare[from][tier] = false;
+				}
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(SLEEP_INTERVAL));
+	}
+}
+
+/*
+* Walks the graph from the gap, each time picking at random between the reachable gaps whose move falls in the
+* tier's band of difficulty. The bands split the range up to the hardest move the graph allows, so every tier is
+* used whatever the tuning. If no move falls in the band the one closest to it is taken.
+*/
+void Tetris::Simulation::LevelGenerator::makeSegment(const ReachabilityGraph& graph, int from, int tier, GapSegment& segment) {
+	float low = graph.hardest * tier / DIFFICULTY_TIERS;
+	float high = graph.hardest * (tier + 1) / DIFFICULTY_TIERS;
+	float middle = (low + high) / 2;
+	segment.from = from;
+	float total = 0;
+	int gap = from;
+	for (int i = 0; i < SEGMENT_LENGTH; i++) {
+		int choices[GAP_ROWS];
+		int count = 0;
+		int closest = gap;
+		for (int to = 0; to < GAP_ROWS; to++) {
+			float cost = graph.difficulty[gap][to];
+			if (!graph.reachable(gap, to)) {
+				continue;
+			}
+			if (cost >= low && cost <= high) {
+				choices[count++] = to;
+			}
+			if (fabsf(cost - middle) < fabsf(graph.difficulty[gap][closest] - middle)) {
+				closest = to;
+			}
+		}
+		int next = count > 0 ? choices[random(count)] : closest;
+		total += graph.hardest > 0 ? graph.difficulty[gap][next] / graph.hardest : 0;
+		segment.gaps[i] = next;
+		gap = next;
+	}
+	segment.difficulty = total / SEGMENT_LENGTH;
+}
+
+/*
+* Gets the difficulty tier for the wall with the given number. The tiers rise evenly so the walls reach the hardest
+* tier once the player has survived the target time.
+*/
+int Tetris::Simulation::LevelGenerator::getTier(int wall) {
+	if (targetSurvival <= 0 || wallInterval <= 0) {
+		return DIFFICULTY_TIERS - 1;
+	}
+	int tier = (int)(wall * wallInterval * DIFFICULTY_TIERS / targetSurvival);
+	return tier < DIFFICULTY_TIERS ? tier : DIFFICULTY_TIERS - 1;
+}
+
+/*
+* Gets a random number from 0 up to but not including the limit, using a xorshift generator.
+*/
+int Tetris::Simulation::LevelGenerator::random(int limit) {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return (int)(randomState % limit);
+}
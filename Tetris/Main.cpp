@@ -1,5 +1,7 @@
 // Main.cpp contains the main function which is the entry point to the game
 
+#include <time.h>
+#include <thread>
 #include <allegro5/allegro.h>
 #include <allegro5/allegro_audio.h>
 #include <allegro5/allegro_acodec.h>
@@ -8,6 +10,12 @@
 #include <allegro5/allegro_ttf.h>
 #include <allegro5/allegro_primitives.h>
 #include "game.h"
+#include "options.h"
+#include "benchmark.h"
+#include "spectator.h"
+#include "server.h"
+#include "trainer.h"
+#include "allocation.h"
 
 void initAllegro() {
 	bool init = true;
@@ -39,11 +47,73 @@ void initAllegro() {
 	}
 }
 
+/*
+* Initialises only what drawing to memory bitmaps needs, so it works without a display, keyboard or sound card.
+*/
+void initHeadless() {
+	bool init = true;
+	if (!al_init()) {
+		init = false;
+	}
+	if (!al_init_image_addon()) {
+		init = false;
+	}
+	if (!al_init_primitives_addon()) {
+		init = false;
+	}
+	al_init_font_addon();
+	al_init_ttf_addon();
+	if (!init) {
+		throw "Could not initialise Allegro 5 for headless rendering";
+	}
+}
+
 /*
 * Entry point to the game.
 */
 int main(int n, char** args) {
+	// Before Allegro allocates anything, so all of its memory is counted.
+	Tetris::Utils::trackAllegroMemory();
+	Tetris::Options options;
+	options.parse(n, args);
+	if (options.benchRenderFrames > 0) {
+		initHeadless();
+		Tetris::RenderBenchmark benchmark(options.benchRenderFrames);
+		return benchmark.run(options.goldenImage);
+	}
+	if (options.benchCollisionTicks > 0) {
+		initHeadless();
+		Tetris::CollisionBenchmark benchmark(options.benchCollisionTicks);
+		return benchmark.run();
+	}
+	if (options.benchEnvironmentSteps > 0) {
+		initHeadless();
+		Tetris::Utils::MemoryScope scope(Tetris::Utils::MEMORY_SIMULATION);
+		Tetris::EnvironmentBenchmark benchmark(options.benchEnvironmentSteps, options.environmentGames);
+		return benchmark.run();
+	}
+	if (options.trainGenerations > 0) {
+		initHeadless();
+		Tetris::Utils::MemoryScope scope(Tetris::Utils::MEMORY_SIMULATION);
+		Tetris::Simulation::Trainer trainer(options.population, (unsigned int)time(NULL));
+		return trainer.run(options.trainGenerations, options.networkPath);
+	}
+	if (options.serverPort > 0) {
+		int workers = options.serverWorkers > 0 ? options.serverWorkers : (int)std::thread::hardware_concurrency();
+		return Tetris::Net::runSessionServer(options.serverPort, workers);
+	}
+	if (options.botPort > 0) {
+		return Tetris::Net::runBots(options.botCount, options.botPort, 30);
+	}
+	if (options.spectatePort > 0) {
+		if (options.spectatorLoad > 0) {
+			return Tetris::runSpectatorLoad(options.spectatorLoad, options.spectatePort, 10);
+		}
+		initAllegro();
+		Tetris::SpectatorViewer viewer(options.spectatePort);
+		return viewer.run();
+	}
 	initAllegro();
-	Tetris::Game game;
+	Tetris::Game game(options);
 	return game.loop();
 }
\ No newline at end of file
@@ -0,0 +1,123 @@
+// Mask.cpp implements the 1 bit collision masks
+
+#include <stddef.h>
+#include "mask.h"
+
+/*
+* Creates an empty mask, which never overlaps anything.
+*/
+Tetris::Simulation::CollisionMask::CollisionMask() : width(0), height(0), stride(0) {}
+
+/*
+* Resizes the mask and clears every pixel.
+*/
+void Tetris::Simulation::CollisionMask::create(int width, int height) {
+	this->width = width;
+	this->height = height;
+	stride = (width + 63) / 64;
+	bits.assign((size_t)stride * height, 0);
+}
+
+/*
+* Marks a pixel as solid.
+*/
+void Tetris::Simulation::CollisionMask::set(int x, int y) {
+	if (x < 0 || y < 0 || x >= width || y >= height) {
+		return;
+	}
+	bits[(size_t)y * stride + x / 64] |= 1ull << (x % 64);
+}
+
+/*
+* Checks whether a pixel is solid. Pixels outside the mask aren't.
+*/
+bool Tetris::Simulation::CollisionMask::get(int x, int y) const {
+	if (x < 0 || y < 0 || x >= width || y >= height) {
+		return false;
+	}
+	return (bits[(size_t)y * stride + x / 64] >> (x % 64) & 1) != 0;
+}
+
+/*
+* Gets the number of solid pixels.
+*/
+int Tetris::Simulation::CollisionMask::count() const {
+	int solid = 0;
+	for (unsigned long long word : bits) {
+		for (; word != 0; word &= word - 1) {
+			solid++;
+		}
+	}
+	return solid;
+}
+
+/*
+* Checks the rows the two masks share. For each word of a's row the matching 64 pixels of b's row are shifted into
+* place and ANDed with it. Padding and pixels off the edge of b are clear, so only the columns the masks share can
+* match and no further clipping is needed.
+*/
+bool Tetris::Simulation::CollisionMask::overlap(const CollisionMask& a, int ax, int ay, const CollisionMask& b, int bx, int by) {
+	int left = ax > bx ? ax : bx;
+	int right = ax + a.width < bx + b.width ? ax + a.width : bx + b.width;
+	int top = ay > by ? ay : by;
+	int bottom = ay + a.height < by + b.height ? ay + a.height : by + b.height;
+	if (left >= right || top >= bottom) {
+		return false;
+	}
+	int firstWord = (left - ax) / 64;
+	int lastWord = (right - ax - 1) / 64;
+	int shift = ax - bx;
+	for (int y = top; y < bottom; y++) {
+		const unsigned long long* row = &a.bits[(size_t)(y - ay) * a.stride];
+		for (int word = firstWord; word <= lastWord; word++) {
+			if ((row[word] & b.extract(y - by, word * 64 + shift)) != 0) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/*
+* Gets the 64 pixels of a row starting from the given column, joining the two words they straddle.
+*/
+unsigned long long Tetris::Simulation::CollisionMask::extract(int row, int column) const {
+	if (column >= width || column <= -64) {
+		return 0;
+	}
+	const unsigned long long* words = &bits[(size_t)row * stride];
+	int word = column >= 0 ? column / 64 : -1;
+	int shift = column - word * 64;
+	unsigned long long low = word >= 0 ? words[word] : 0;
+	unsigned long long high = word + 1 < stride ? words[word + 1] : 0;
+	return shift == 0 ? low : low >> shift | high << (64 - shift);
+}
+
+// =========================CollisionMaskSet==================================
+/*
+* Creates a set with no masks, which tests boxes only.
+*/
+Tetris::Simulation::CollisionMaskSet::CollisionMaskSet() {
+	for (int i = 0; i < MAX_MASKED_IMAGES; i++) {
+		masks[i] = nullptr;
+	}
+}
+
+/*
+* Makes entities drawn with the image be tested against the mask once their boxes touch.
+*/
+void Tetris::Simulation::CollisionMaskSet::set(int image, const CollisionMask* mask) {
+	if (image >= 0 && image < MAX_MASKED_IMAGES) {
+		masks[image] = mask;
+	}
+}
+
+/*
+* Gets the mask for the image, or null if it has none.
+*/
+const Tetris::Simulation::CollisionMask* Tetris::Simulation::CollisionMaskSet::get(int image) const {
+	if (image < 0 || image >= MAX_MASKED_IMAGES) {
+		return nullptr;
+	}
+	return masks[image];
+}
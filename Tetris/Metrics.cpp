@@ -0,0 +1,210 @@
+// Metrics.cpp implements the metrics and the server that exposes them
+
+#include <stdio.h>
+#include "metrics.h"
+#include "allocation.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <unistd.h>
+#endif
+
+// =========================Histogram==================================
+/*
+* Bucket bounds from a tenth of a millisecond up to a few frames.
+*/
+const double Tetris::Utils::Histogram::BOUNDS[Tetris::Utils::Histogram::BUCKETS] = {
+	0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.0167, 0.025, 0.05
+};
+
+/*
+* Creates an empty histogram.
+*/
+Tetris::Utils::Histogram::Histogram() : nanoseconds(0) {
+	for (int i = 0; i <= BUCKETS; i++) {
+		counts[i] = 0;
+	}
+}
+
+/*
+* Records a duration in seconds. Only the one bucket it falls in is counted; the cumulative counts Prometheus
+* expects are added up when formatting.
+*/
+void Tetris::Utils::Histogram::observe(double seconds) {
+	int bucket = 0;
+	while (bucket < BUCKETS && seconds > BOUNDS[bucket]) {
+		bucket++;
+	}
+	counts[bucket].fetch_add(1, std::memory_order_relaxed);
+	nanoseconds.fetch_add((long long)(seconds * 1e9), std::memory_order_relaxed);
+}
+
+/*
+* Appends the histogram to the text in the Prometheus exposition format.
+*/
+void Tetris::Utils::Histogram::format(std::string& text, const char* name, const char* help) {
+	char line[160];
+	sprintf(line, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+	text += line;
+	long long total = 0;
+	for (int i = 0; i < BUCKETS; i++) {
+		total += counts[i].load(std::memory_order_relaxed);
+		sprintf(line, "%s_bucket{le=\"%g\"} %lld\n", name, BOUNDS[i], total);
+		text += line;
+	}
+	total += counts[BUCKETS].load(std::memory_order_relaxed);
+	sprintf(line, "%s_bucket{le=\"+Inf\"} %lld\n%s_sum %.9f\n%s_count %lld\n", name, total, name, nanoseconds.load(std::memory_order_relaxed) / 1e9, name, total);
+	text += line;
+}
+
+// =========================Metrics==================================
+/*
+* Starts every counter at zero.
+*/
+Tetris::Utils::Metrics::Metrics() : ticks(0), lateTicks(0), droppedTicks(0), eventsHandled(0), eventBatch(0), fullBatches(0), gamesPlayed(0), floorCrashes(0), wallCrashes(0) {}
+
+/*
+* Appends one counter or gauge to the text.
+*/
+static void formatValue(std::string& text, const char* name, const char* type, const char* help, long long value) {
+	char line[200];
+	sprintf(line, "# HELP %s %s\n# TYPE %s %s\n%s %lld\n", name, help, name, type, name, value);
+	text += line;
+}
+
+/*
+* Formats every metric in the Prometheus exposition format. Called on the server thread.
+*/
+void Tetris::Utils::Metrics::format(std::string& text) {
+	text.clear();
+	tickSeconds.format(text, "tetris_tick_duration_seconds", "Time taken by each game tick.");
+	drawSeconds.format(text, "tetris_draw_duration_seconds", "Time the game loop spent drawing each frame.");
+	formatValue(text, "tetris_ticks_total", "counter", "Ticks run.", ticks.load(std::memory_order_relaxed));
+	formatValue(text, "tetris_late_ticks_total", "counter", "Ticks run more than a frame after the timer fired.", lateTicks.load(std::memory_order_relaxed));
+	formatValue(text, "tetris_dropped_ticks_total", "counter", "Ticks skipped because the game fell behind.", droppedTicks.load(std::memory_order_relaxed));
+	formatValue(text, "tetris_events_handled_total", "counter", "Input and display events handled.", eventsHandled.load(std::memory_order_relaxed));
+	formatValue(text, "tetris_event_queue_depth", "gauge", "Events handled from the queue in the last batch.", eventBatch.load(std::memory_order_relaxed));
+	formatValue(text, "tetris_event_queue_full_batches_total", "counter", "Batches that left events in the queue.", fullBatches.load(std::memory_order_relaxed));
+	formatValue(text, "tetris_games_played_total", "counter", "Games started by the player.", gamesPlayed.load(std::memory_order_relaxed));
+	text += "# HELP tetris_crashes_total Games ended by a crash.\n# TYPE tetris_crashes_total counter\n";
+	char line[100];
+	sprintf(line, "tetris_crashes_total{cause=\"floor\"} %lld\n", floorCrashes.load(std::memory_order_relaxed));
+	text += line;
+	sprintf(line, "tetris_crashes_total{cause=\"wall\"} %lld\n", wallCrashes.load(std::memory_order_relaxed));
+	text += line;
+	formatValue(text, "tetris_resident_memory_bytes", "gauge", "Resident memory of the process.", getResidentMemory());
+	text += "# HELP tetris_heap_bytes Heap memory allocated by each subsystem.\n# TYPE tetris_heap_bytes gauge\n";
+	for (int tag = 0; tag <= Tetris::Utils::MEMORY_TAG_COUNT; tag++) {
+		sprintf(line, "tetris_heap_bytes{tag=\"%s\"} %lld\n", Tetris::Utils::getMemoryTagName((Tetris::Utils::MemoryTag)tag), Tetris::Utils::getMemoryStats((Tetris::Utils::MemoryTag)tag).bytes);
+		text += line;
+	}
+	text += "# HELP tetris_heap_peak_bytes The most heap memory each subsystem has had allocated at once.\n# TYPE tetris_heap_peak_bytes gauge\n";
+	for (int tag = 0; tag <= Tetris::Utils::MEMORY_TAG_COUNT; tag++) {
+		sprintf(line, "tetris_heap_peak_bytes{tag=\"%s\"} %lld\n", Tetris::Utils::getMemoryTagName((Tetris::Utils::MemoryTag)tag), Tetris::Utils::getMemoryStats((Tetris::Utils::MemoryTag)tag).peakBytes);
+		text += line;
+	}
+}
+
+// =========================MetricsServer==================================
+/*
+* Creates a server for the metrics.
+*/
+Tetris::Utils::MetricsServer::MetricsServer(Metrics& metrics) : metrics(metrics), listener(Tetris::Net::INVALID), running(false) {}
+
+/*
+* Stops the server.
+*/
+Tetris::Utils::MetricsServer::~MetricsServer() {
+	stop();
+}
+
+/*
+* Starts listening on the port of 127.0.0.1, so only the machine itself can scrape it.
+*/
+bool Tetris::Utils::MetricsServer::start(int port) {
+	if (running) {
+		return true;
+	}
+	if (!Tetris::Net::startup()) {
+		return false;
+	}
+	listener = Tetris::Net::listenTcp("127.0.0.1", port);
+	if (listener == Tetris::Net::INVALID) {
+		return false;
+	}
+	running = true;
+	thread = std::thread(&Tetris::Utils::MetricsServer::run, this);
+	return true;
+}
+
+/*
+* Stops the server thread and closes the port.
+*/
+void Tetris::Utils::MetricsServer::stop() {
+	if (!running) {
+		return;
+	}
+	running = false;
+	if (thread.joinable()) {
+		thread.join();
+	}
+	Tetris::Net::closeSocket(listener);
+	listener = Tetris::Net::INVALID;
+}
+
+/*
+* The body of the server thread. Answers one scrape at a time, checking every quarter second whether to stop.
+*/
+void Tetris::Utils::MetricsServer::run() {
+	while (running) {
+		Tetris::Net::Socket client = Tetris::Net::acceptClient(listener, 250);
+		if (client != Tetris::Net::INVALID) {
+			respond(client);
+			Tetris::Net::closeSocket(client);
+		}
+	}
+}
+
+/*
+* Reads the request, whatever it asks for, and sends the metrics back.
+*/
+void Tetris::Utils::MetricsServer::respond(Tetris::Net::Socket client) {
+	char request[1024];
+	if (!Tetris::Net::waitReadable(client, 1000) || Tetris::Net::receive(client, request, sizeof(request)) <= 0) {
+		return;
+	}
+	metrics.format(text);
+	char header[160];
+	int headerLength = sprintf(header, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\nConnection: close\r\n\r\n", (int)text.size());
+	if (Tetris::Net::sendAll(client, header, headerLength)) {
+		Tetris::Net::sendAll(client, text.data(), (int)text.size());
+	}
+}
+
+/*
+* Gets the resident memory of the process in bytes, or 0 if it isn't known.
+*/
+long long Tetris::Utils::getResidentMemory() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return (long long)counters.WorkingSetSize;
+	}
+	return 0;
+#else
+	long long pages = 0;
+	long long resident = 0;
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (file == nullptr) {
+		return 0;
+	}
+	if (fscanf(file, "%lld %lld", &pages, &resident) != 2) {
+		resident = 0;
+	}
+	fclose(file);
+	return resident * sysconf(_SC_PAGESIZE);
+#endif
+}
@@ -0,0 +1,187 @@
+// Net.cpp implements the socket wrapper on Windows and POSIX
+
+#include <string.h>
+#include "net.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#endif
+
+/*
+* Fills in an IPv4 address. Returns false if the address isn't a dotted quad.
+*/
+static bool makeAddress(const char* address, int port, sockaddr_in& result) {
+	memset(&result, 0, sizeof(result));
+	result.sin_family = AF_INET;
+	result.sin_port = htons((unsigned short)port);
+	return inet_pton(AF_INET, address, &result.sin_addr) == 1;
+}
+
+/*
+* Starts up the socket library. Only Windows needs this. Broken connections are reported by send instead of
+* killing the process with SIGPIPE.
+*/
+bool Tetris::Net::startup() {
+#ifdef _WIN32
+	WSADATA data;
+	return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+	signal(SIGPIPE, SIG_IGN);
+	return true;
+#endif
+}
+
+/*
+* Opens a TCP socket listening on the port of the given address.
+*/
+Tetris::Net::Socket Tetris::Net::listenTcp(const char* address, int port) {
+	sockaddr_in local;
+	if (!makeAddress(address, port, local)) {
+		return INVALID;
+	}
+	Socket listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listener == INVALID) {
+		return INVALID;
+	}
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+	if (bind(listener, (sockaddr*)&local, sizeof(local)) != 0 || listen(listener, SOMAXCONN) != 0) {
+		closeSocket(listener);
+		return INVALID;
+	}
+	return listener;
+}
+
+/*
+* Opens a TCP connection to the port of the given address. Small writes are sent straight away.
+*/
+Tetris::Net::Socket Tetris::Net::connectTcp(const char* address, int port) {
+	sockaddr_in remote;
+	if (!makeAddress(address, port, remote)) {
+		return INVALID;
+	}
+	Socket connection = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (connection == INVALID) {
+		return INVALID;
+	}
+	if (connect(connection, (sockaddr*)&remote, sizeof(remote)) != 0) {
+		closeSocket(connection);
+		return INVALID;
+	}
+	int noDelay = 1;
+	setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+	return connection;
+}
+
+/*
+* Waits up to the timeout for a connection on the listening socket and accepts it.
+*/
+Tetris::Net::Socket Tetris::Net::acceptClient(Socket listener, int timeoutMilliseconds) {
+	if (!waitReadable(listener, timeoutMilliseconds)) {
+		return INVALID;
+	}
+	Socket client = accept(listener, nullptr, nullptr);
+	if (client != INVALID) {
+		int noDelay = 1;
+		setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+	}
+	return client;
+}
+
+/*
+* Waits up to the timeout for the socket to have data to read.
+*/
+bool Tetris::Net::waitReadable(Socket socket, int timeoutMilliseconds) {
+#ifdef _WIN32
+	WSAPOLLFD entry;
+	entry.fd = socket;
+	entry.events = POLLRDNORM;
+	entry.revents = 0;
+	return WSAPoll(&entry, 1, timeoutMilliseconds) > 0;
+#else
+	pollfd entry;
+	entry.fd = socket;
+	entry.events = POLLIN;
+	entry.revents = 0;
+	return poll(&entry, 1, timeoutMilliseconds) > 0;
+#endif
+}
+
+/*
+* Reads whatever has arrived, up to size bytes.
+*/
+int Tetris::Net::receive(Socket socket, char* buffer, int size) {
+	return (int)recv(socket, buffer, size, 0);
+}
+
+/*
+* Sends every byte, blocking until done.
+*/
+bool Tetris::Net::sendAll(Socket socket, const char* data, int size) {
+	while (size > 0) {
+		int sent = (int)send(socket, data, size, 0);
+		if (sent <= 0) {
+			return false;
+		}
+		data += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+/*
+* Sends as many bytes as the socket will take without waiting.
+*/
+int Tetris::Net::sendSome(Socket socket, const char* data, int size) {
+	int sent = (int)send(socket, data, size, 0);
+	if (sent < 0) {
+		return wouldBlock() ? 0 : -1;
+	}
+	return sent;
+}
+
+/*
+* Checks whether the last failed call on a non-blocking socket failed only because it would have waited.
+*/
+bool Tetris::Net::wouldBlock() {
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+/*
+* Makes sends and receives on the socket return straight away instead of waiting.
+*/
+void Tetris::Net::setNonBlocking(Socket socket) {
+#ifdef _WIN32
+	u_long enabled = 1;
+	ioctlsocket(socket, FIONBIO, &enabled);
+#else
+	fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+/*
+* Closes the socket.
+*/
+void Tetris::Net::closeSocket(Socket socket) {
+#ifdef _WIN32
+	closesocket(socket);
+#else
+	close(socket);
+#endif
+}
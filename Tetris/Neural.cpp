@@ -0,0 +1,214 @@
+// Neural.cpp implements the demo network and the batch of networks the trainer runs
+
+#include <stdio.h>
+#include <string.h>
+#include "neural.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#include <xmmintrin.h>
+#define TETRIS_SSE
+#endif
+
+/*
+* Scales the distance to the front wall into the range of the other inputs.
+*/
+static const float DISTANCE_SCALE = 500;
+
+/*
+* Where each layer starts in the weights.
+*/
+static const int HIDDEN_STRIDE = Tetris::Simulation::NETWORK_INPUTS + 1;
+static const int OUTPUT_START = Tetris::Simulation::NETWORK_HIDDEN * HIDDEN_STRIDE;
+static const int OUTPUT_STRIDE = Tetris::Simulation::NETWORK_HIDDEN + 1;
+
+/*
+* The header of a network file.
+*/
+static const int NETWORK_FILE_VERSION = 1;
+
+/*
+* Turns the outputs into a move: the stronger boost if either wants to fire, otherwise nothing.
+*/
+static Tetris::Simulation::NetworkMove chooseMove(float small, float big) {
+	if (small <= 0 && big <= 0) {
+		return Tetris::Simulation::GLIDE;
+	}
+	return small >= big ? Tetris::Simulation::SMALL_BOOST : Tetris::Simulation::BIG_BOOST;
+}
+
+/*
+* Fills in what a player sees of the world: how high it is, how fast it is falling, how far away the front wall is,
+* and how far below it the middle of the gaps in the front and next walls are.
+*/
+void Tetris::Simulation::readInputs(const World& world, int slot, float inputs[NETWORK_INPUTS]) {
+	int player = world.players[slot];
+	int wall = world.walls[world.front];
+	int next = world.walls[(world.front + 1) % WALL_COUNT];
+	float height = BOTTOM - TOP;
+	float y = toFloat(world.y[player]) + toFloat(world.height[player]) / 2;
+	inputs[0] = (y - TOP) / height * 2 - 1;
+	inputs[1] = toFloat(world.dy[player]) / toFloat(world.terminalVelocity[player]);
+	inputs[2] = (toFloat(world.x[wall]) - toFloat(world.x[player])) / DISTANCE_SCALE;
+	inputs[3] = (TOP + ROW_HEIGHT * (world.gapPosition[wall] + 0.5f) - y) / ROW_HEIGHT;
+	inputs[4] = (TOP + ROW_HEIGHT * (world.gapPosition[next] + 0.5f) - y) / ROW_HEIGHT;
+}
+
+// =========================Network==================================
+/*
+* Works out the move for the inputs.
+*/
+Tetris::Simulation::NetworkMove Tetris::Simulation::Network::decide(const float inputs[NETWORK_INPUTS]) const {
+	float hidden[NETWORK_HIDDEN];
+	for (int h = 0; h < NETWORK_HIDDEN; h++) {
+		const float* neuron = weights + h * HIDDEN_STRIDE;
+		float sum = neuron[NETWORK_INPUTS];
+		for (int i = 0; i < NETWORK_INPUTS; i++) {
+			sum += neuron[i] * inputs[i];
+		}
+		hidden[h] = sum > 0 ? sum : 0;
+	}
+	float outputs[NETWORK_OUTPUTS];
+	for (int o = 0; o < NETWORK_OUTPUTS; o++) {
+		const float* neuron = weights + OUTPUT_START + o * OUTPUT_STRIDE;
+		float sum = neuron[NETWORK_HIDDEN];
+		for (int h = 0; h < NETWORK_HIDDEN; h++) {
+			sum += neuron[h] * hidden[h];
+		}
+		outputs[o] = sum;
+	}
+	return chooseMove(outputs[0], outputs[1]);
+}
+
+/*
+* Decides for a player and gives it the matching boost.
+*/
+void Tetris::Simulation::Network::play(World& world, int slot, const Tetris::Utils::Tuning& tuning) const {
+	float inputs[NETWORK_INPUTS];
+	readInputs(world, slot, inputs);
+	NetworkMove move = decide(inputs);
+	if (move == SMALL_BOOST) {
+		world.boost(tuning.smallBoost, slot);
+	}
+	else if (move == BIG_BOOST) {
+		world.boost(tuning.bigBoost, slot);
+	}
+}
+
+/*
+* Writes "TNET", the version and the number of weights, then the weights.
+*/
+bool Tetris::Simulation::Network::save(const char* path) const {
+	FILE* file = fopen(path, "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	int header[2] = { NETWORK_FILE_VERSION, NETWORK_WEIGHTS };
+	bool written = fwrite("TNET", 1, 4, file) == 4 && fwrite(header, sizeof(int), 2, file) == 2 &&
+		fwrite(weights, sizeof(float), NETWORK_WEIGHTS, file) == NETWORK_WEIGHTS;
+	return fclose(file) == 0 && written;
+}
+
+/*
+* Reads the weights from a file written by save().
+*/
+bool Tetris::Simulation::Network::load(const char* path) {
+	FILE* file = fopen(path, "rb");
+	if (file == nullptr) {
+		return false;
+	}
+	char magic[4];
+	int header[2];
+	float read[NETWORK_WEIGHTS];
+	bool valid = fread(magic, 1, 4, file) == 4 && memcmp(magic, "TNET", 4) == 0 &&
+		fread(header, sizeof(int), 2, file) == 2 && header[0] == NETWORK_FILE_VERSION && header[1] == NETWORK_WEIGHTS &&
+		fread(read, sizeof(float), NETWORK_WEIGHTS, file) == NETWORK_WEIGHTS;
+	fclose(file);
+	if (valid) {
+		memcpy(weights, read, sizeof(weights));
+	}
+	return valid;
+}
+
+// =========================NetworkBatch==================================
+/*
+* Creates a batch for the given number of networks. The padding up to a multiple of four has zero weights.
+*/
+Tetris::Simulation::NetworkBatch::NetworkBatch(int size) : size(size), stride((size + 3) & ~3),
+	weights(NETWORK_WEIGHTS * stride, 0.0f), inputs(NETWORK_INPUTS * stride, 0.0f),
+	hidden(NETWORK_HIDDEN * stride, 0.0f), outputs(NETWORK_OUTPUTS * stride, 0.0f) {}
+
+/*
+* Copies a network's weights into the batch.
+*/
+void Tetris::Simulation::NetworkBatch::setNetwork(int index, const Network& network) {
+	for (int w = 0; w < NETWORK_WEIGHTS; w++) {
+		weights[w * stride + index] = network.weights[w];
+	}
+}
+
+/*
+* Sets the inputs of one network.
+*/
+void Tetris::Simulation::NetworkBatch::setInputs(int index, const float inputs[NETWORK_INPUTS]) {
+	for (int i = 0; i < NETWORK_INPUTS; i++) {
+		this->inputs[i * stride + index] = inputs[i];
+	}
+}
+
+/*
+* Runs the layers four networks at a time. Every network has the same shape, so the same instructions apply to all
+* four lanes and there are no branches until the moves are read.
+*/
+void Tetris::Simulation::NetworkBatch::decide() {
+	const float* w = &weights[0];
+	const float* in = &inputs[0];
+	float* hid = &hidden[0];
+	float* out = &outputs[0];
+	for (int n = 0; n < stride; n += 4) {
+#ifdef TETRIS_SSE
+		__m128 zero = _mm_setzero_ps();
+		for (int h = 0; h < NETWORK_HIDDEN; h++) {
+			int neuron = h * HIDDEN_STRIDE;
+			__m128 sum = _mm_loadu_ps(w + (neuron + NETWORK_INPUTS) * stride + n);
+			for (int i = 0; i < NETWORK_INPUTS; i++) {
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(w + (neuron + i) * stride + n), _mm_loadu_ps(in + i * stride + n)));
+			}
+			_mm_storeu_ps(hid + h * stride + n, _mm_max_ps(sum, zero));
+		}
+		for (int o = 0; o < NETWORK_OUTPUTS; o++) {
+			int neuron = OUTPUT_START + o * OUTPUT_STRIDE;
+			__m128 sum = _mm_loadu_ps(w + (neuron + NETWORK_HIDDEN) * stride + n);
+			for (int h = 0; h < NETWORK_HIDDEN; h++) {
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(w + (neuron + h) * stride + n), _mm_loadu_ps(hid + h * stride + n)));
+			}
+			_mm_storeu_ps(out + o * stride + n, sum);
+		}
+#else
+		for (int lane = n; lane < n + 4; lane++) {
+			for (int h = 0; h < NETWORK_HIDDEN; h++) {
+				int neuron = h * HIDDEN_STRIDE;
+				float sum = w[(neuron + NETWORK_INPUTS) * stride + lane];
+				for (int i = 0; i < NETWORK_INPUTS; i++) {
+					sum += w[(neuron + i) * stride + lane] * in[i * stride + lane];
+				}
+				hid[h * stride + lane] = sum > 0 ? sum : 0;
+			}
+			for (int o = 0; o < NETWORK_OUTPUTS; o++) {
+				int neuron = OUTPUT_START + o * OUTPUT_STRIDE;
+				float sum = w[(neuron + NETWORK_HIDDEN) * stride + lane];
+				for (int h = 0; h < NETWORK_HIDDEN; h++) {
+					sum += w[(neuron + h) * stride + lane] * hid[h * stride + lane];
+				}
+				out[o * stride + lane] = sum;
+			}
+		}
+#endif
+	}
+}
+
+/*
+* Gets the move of a network worked out by decide().
+*/
+Tetris::Simulation::NetworkMove Tetris::Simulation::NetworkBatch::getMove(int index) {
+	return chooseMove(outputs[index], outputs[stride + index]);
+}
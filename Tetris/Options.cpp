@@ -0,0 +1,73 @@
+// Options.cpp implements parsing of the command line options
+
+#include <stdlib.h>
+#include <string.h>
+#include "options.h"
+
+/*
+* Reads the options from the command line. Unknown arguments are ignored.
+*/
+void Tetris::Options::parse(int n, char** args) {
+	for (int i = 1; i < n; i++) {
+		if (strcmp(args[i], "--threaded") == 0) {
+			threadedRendering = true;
+		}
+		else if (strcmp(args[i], "--bench-render") == 0 && i + 1 < n) {
+			benchRenderFrames = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--bench-collision") == 0 && i + 1 < n) {
+			benchCollisionTicks = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--bench-env") == 0 && i + 1 < n) {
+			benchEnvironmentSteps = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--envs") == 0 && i + 1 < n) {
+			environmentGames = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--golden") == 0 && i + 1 < n) {
+			goldenImage = args[++i];
+		}
+		else if (strcmp(args[i], "--capture") == 0 && i + 1 < n) {
+			capturePath = args[++i];
+		}
+		else if (strcmp(args[i], "--metrics-port") == 0 && i + 1 < n) {
+			metricsPort = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--broadcast-port") == 0 && i + 1 < n) {
+			broadcastPort = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--spectate") == 0 && i + 1 < n) {
+			spectatePort = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--spectators") == 0 && i + 1 < n) {
+			spectatorLoad = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--serve") == 0 && i + 1 < n) {
+			serverPort = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--workers") == 0 && i + 1 < n) {
+			serverWorkers = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--bot-port") == 0 && i + 1 < n) {
+			botPort = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--bots") == 0 && i + 1 < n) {
+			botCount = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--players") == 0 && i + 1 < n) {
+			players = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--train") == 0 && i + 1 < n) {
+			trainGenerations = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--population") == 0 && i + 1 < n) {
+			population = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--network") == 0 && i + 1 < n) {
+			networkPath = args[++i];
+		}
+		else if (strcmp(args[i], "--memory-budget") == 0 && i + 1 < n) {
+			memoryBudget = atoi(args[++i]);
+		}
+	}
+}
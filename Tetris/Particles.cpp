@@ -0,0 +1,186 @@
+// Particles.cpp implements the pooled particle system
+
+#include <math.h>
+#include "particles.h"
+#include "allocation.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#include <xmmintrin.h>
+#define TETRIS_SSE
+#endif
+
+/*
+* The pull on every particle in pixels per second squared, and the size each is drawn at.
+*/
+static const float PARTICLE_GRAVITY = 300;
+static const float PARTICLE_SIZE = 3;
+
+/*
+* How each kind of burst looks. Angles are in radians with 0 to the right and y growing down.
+*/
+struct BurstStyle {
+	int count;								// Particles emitted.
+	float angle;							// The direction they head in.
+	float spread;							// How far either side of the angle they scatter.
+	float minSpeed;							// The range of speeds in pixels per second.
+	float maxSpeed;
+	float minLife;							// The range of lifetimes in seconds.
+	float maxLife;
+	unsigned char red;						// The colour, which each particle varies slightly.
+	unsigned char green;
+	unsigned char blue;
+};
+
+/*
+* The style of each ParticleBurst::Kind. Boosts blow exhaust down and back from the jet.
+*/
+static const BurstStyle BURST_STYLES[] = {
+	{ 3000, 0, 3.1416f, 80, 420, 0.5f, 1.5f, 255, 120, 40 },		// CRASH
+	{ 250, 1.9f, 0.35f, 120, 260, 0.2f, 0.5f, 255, 200, 80 },		// SMALL_BOOST
+	{ 600, 1.9f, 0.45f, 160, 380, 0.3f, 0.7f, 255, 170, 60 },		// BIG_BOOST
+	{ 400, -1.5708f, 1.2f, 60, 220, 0.4f, 1.0f, 255, 230, 90 }		// SCORE
+};
+
+/*
+* Creates an empty system that holds up to the given number of particles. Its arrays are counted as UI memory.
+*/
+Tetris::Graphics::ParticleSystem::ParticleSystem(int capacity) : capacity((capacity + 3) / 4 * 4), count(0), randomState(0x9e3779b9) {
+	Tetris::Utils::MemoryScope scope(Tetris::Utils::MEMORY_UI);
+	x.resize(this->capacity, 0);
+	y.resize(this->capacity, 0);
+	dx.resize(this->capacity, 0);
+	dy.resize(this->capacity, 0);
+	life.resize(this->capacity, 0);
+	fade.resize(this->capacity, 0);
+	colour.resize(this->capacity);
+	vertices.resize(this->capacity * 6);
+}
+
+/*
+* Emits the particles of a burst with random directions, speeds and lifetimes within its style. Once the pool is
+* full the rest of the burst is dropped.
+*/
+void Tetris::Graphics::ParticleSystem::emit(const Tetris::Graphics::ParticleBurst& burst) {
+	const BurstStyle& style = BURST_STYLES[burst.kind];
+	for (int i = 0; i < style.count && count < capacity; i++, count++) {
+		float angle = style.angle + (random() * 2 - 1) * style.spread;
+		float speed = style.minSpeed + random() * (style.maxSpeed - style.minSpeed);
+		float lifetime = style.minLife + random() * (style.maxLife - style.minLife);
+		float shade = 0.75f + random() * 0.25f;
+		x[count] = burst.x;
+		y[count] = burst.y;
+		dx[count] = cosf(angle) * speed;
+		dy[count] = sinf(angle) * speed;
+		life[count] = lifetime;
+		fade[count] = 1 / lifetime;
+		colour[count] = al_map_rgb_f(style.red / 255.0f * shade, style.green / 255.0f * shade, style.blue / 255.0f * shade);
+	}
+}
+
+/*
+* Applies gravity, moves and ages the particles four at a time, then removes the dead ones by moving the last live
+* particle into each gap. The padding past count is updated too, which is harmless and saves a scalar tail.
+*/
+void Tetris::Graphics::ParticleSystem::update(float delta) {
+	if (count == 0 || delta <= 0) {
+		return;
+	}
+	int end = (count + 3) / 4 * 4;
+#ifdef TETRIS_SSE
+	__m128 time = _mm_set1_ps(delta);
+	__m128 pull = _mm_set1_ps(PARTICLE_GRAVITY * delta);
+	for (int i = 0; i < end; i += 4) {
+		__m128 vy = _mm_add_ps(_mm_loadu_ps(&dy[i]), pull);
+		_mm_storeu_ps(&dy[i], vy);
+		_mm_storeu_ps(&x[i], _mm_add_ps(_mm_loadu_ps(&x[i]), _mm_mul_ps(_mm_loadu_ps(&dx[i]), time)));
+		_mm_storeu_ps(&y[i], _mm_add_ps(_mm_loadu_ps(&y[i]), _mm_mul_ps(vy, time)));
+		_mm_storeu_ps(&life[i], _mm_sub_ps(_mm_loadu_ps(&life[i]), time));
+	}
+#else
+	for (int i = 0; i < end; i++) {
+		dy[i] += PARTICLE_GRAVITY * delta;
+		x[i] += dx[i] * delta;
+		y[i] += dy[i] * delta;
+		life[i] -= delta;
+	}
+#endif
+	for (int i = 0; i < count;) {
+		if (life[i] > 0) {
+			i++;
+			continue;
+		}
+		count--;
+		x[i] = x[count];
+		y[i] = y[count];
+		dx[i] = dx[count];
+		dy[i] = dy[count];
+		life[i] = life[count];
+		fade[i] = fade[count];
+		colour[i] = colour[count];
+	}
+}
+
+/*
+* Fills in a square of two triangles for each particle, with its colour premultiplied by how much life it has
+* left to match Allegro's default blender, and draws them all with one call. The vertices were zeroed when they
+* were allocated, so z and the texture coordinates never need writing.
+*/
+void Tetris::Graphics::ParticleSystem::draw() {
+	if (count == 0) {
+		return;
+	}
+	ALLEGRO_VERTEX* vertex = &vertices[0];
+	for (int i = 0; i < count; i++) {
+		float alpha = life[i] * fade[i];
+		ALLEGRO_COLOR tint = colour[i];
+		tint.r *= alpha;
+		tint.g *= alpha;
+		tint.b *= alpha;
+		tint.a = alpha;
+		float left = x[i];
+		float top = y[i];
+		float right = left + PARTICLE_SIZE;
+		float bottom = top + PARTICLE_SIZE;
+		vertex[0].x = left;
+		vertex[0].y = top;
+		vertex[1].x = right;
+		vertex[1].y = top;
+		vertex[2].x = left;
+		vertex[2].y = bottom;
+		vertex[3].x = right;
+		vertex[3].y = top;
+		vertex[4].x = right;
+		vertex[4].y = bottom;
+		vertex[5].x = left;
+		vertex[5].y = bottom;
+		for (int corner = 0; corner < 6; corner++) {
+			vertex[corner].color = tint;
+		}
+		vertex += 6;
+	}
+	al_draw_prim(&vertices[0], NULL, NULL, 0, count * 6, ALLEGRO_PRIM_TRIANGLE_LIST);
+}
+
+/*
+* Removes every particle.
+*/
+void Tetris::Graphics::ParticleSystem::clear() {
+	count = 0;
+}
+
+/*
+* Gets the number of live particles.
+*/
+int Tetris::Graphics::ParticleSystem::getCount() {
+	return count;
+}
+
+/*
+* Gets a random number from 0 up to but not including 1, using a xorshift generator.
+*/
+float Tetris::Graphics::ParticleSystem::random() {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return (randomState >> 8) * (1.0f / 16777216);
+}
@@ -0,0 +1,289 @@
+// Renderer.cpp implements the SceneRenderer and RenderThread classes
+
+#include <chrono>
+#include <allegro5/allegro.h>
+#include "renderer.h"
+#include "allocation.h"
+
+/*
+* The share of a 60 Hz frame the render thread aims to draw in, leaving the rest for the flip.
+*/
+static const double RENDER_BUDGET = 0.75 / 60;
+
+// =========================SceneRenderer==================================
+/*
+* Builds the widgets of each screen with the same layout as the game.
+*/
+Tetris::Graphics::SceneRenderer::SceneRenderer(ALLEGRO_BITMAP* background, ALLEGRO_BITMAP* tetrisImage, ALLEGRO_BITMAP* wallImage, ALLEGRO_FONT* bigFont, ALLEGRO_FONT* normalFont) : background(background), arena(ARENA_SIZE) {
+	menu.setBounds(Rectangle(0, 0, Tetris::Layout::SCREEN_WIDTH, Tetris::Layout::SCREEN_HEIGHT));
+	title = arena.create<Label>("Tetris", bigFont);
+	title->setPosition(Tetris::Layout::TITLE_X, Tetris::Layout::TITLE_Y);
+	title->setColour(al_map_rgb(7, 70, 70));
+	menu.addWidget(title);
+	const char* names[3] = { "Play", "Demo", "Quit" };
+	const float y[3] = { Tetris::Layout::PLAY_Y, Tetris::Layout::DEMO_Y, Tetris::Layout::QUIT_Y };
+	for (int i = 0; i < 3; i++) {
+		buttons[i] = arena.create<Button>(names[i], normalFont);
+		buttons[i]->setPosition(Tetris::Layout::BUTTON_X, y[i]);
+		menu.addWidget(buttons[i]);
+	}
+
+	game.setBounds(Rectangle(0, 0, Tetris::Layout::SCREEN_WIDTH, Tetris::Layout::SCREEN_HEIGHT));
+	info = arena.create<InformationBox>(Tetris::Layout::SCREEN_WIDTH, Tetris::Layout::INFO_HEIGHT, normalFont);
+	game.addWidget(info);
+	canvas.setBounds(Rectangle(0, Tetris::Layout::INFO_HEIGHT, Tetris::Layout::SCREEN_WIDTH, Tetris::Layout::SCREEN_HEIGHT - Tetris::Layout::INFO_HEIGHT));
+	view = arena.create<WorldView>();
+	view->setBounds(canvas.getBounds());
+	view->setImage(Tetris::Utils::ImageManager::TETRIS, tetrisImage);
+	view->setImage(Tetris::Utils::ImageManager::WALL, wallImage);
+	view->setParticles(&particles);
+	canvas.addWidget(view);
+	game.addWidget(&canvas);
+}
+
+/*
+* Copies the snapshot into the widgets and draws the screen it shows. When costs are wanted the game screen's
+* widgets are drawn one at a time, which gives the same picture as drawing the panel since it covers the target.
+*/
+void Tetris::Graphics::SceneRenderer::draw(const Tetris::FrameSnapshot& frame, Costs* costs) {
+	for (int i = 0; i < frame.burstCount; i++) {
+		particles.emit(frame.bursts[i]);
+	}
+	particles.update(frame.particleSeconds);
+	double start = costs != nullptr ? al_get_time() : 0;
+	al_draw_bitmap(background, 0, 0, 0);
+	if (costs != nullptr) {
+		double now = al_get_time();
+		costs->background += now - start;
+		start = now;
+	}
+	if (frame.screen == Tetris::FrameSnapshot::MENU) {
+		for (int i = 0; i < 3; i++) {
+			if (i == frame.hoveredButton) {
+				buttons[i]->onMouseOver(buttons[i]->getBounds());
+			}
+			else {
+				buttons[i]->onMouseOut();
+			}
+		}
+		menu.draw();
+		if (costs != nullptr) {
+			costs->menu += al_get_time() - start;
+		}
+	}
+	else {
+		info->updateScores(frame.world);
+		info->updateBest(frame.bestScore);
+		info->setState(frame.state);
+		view->setWorld(&frame.world);
+		if (costs == nullptr) {
+			game.draw();
+			return;
+		}
+		info->draw();
+		double now = al_get_time();
+		costs->information += now - start;
+		canvas.draw();
+		costs->world += al_get_time() - now;
+	}
+}
+
+/*
+* Changes one of the images used for drawing.
+*/
+void Tetris::Graphics::SceneRenderer::setImage(Tetris::Utils::ImageManager::Image image, ALLEGRO_BITMAP* bitmap) {
+	if (image == Tetris::Utils::ImageManager::GAMEMUSIC) {
+		background = bitmap;
+	}
+	else {
+		view->setImage(image, bitmap);
+	}
+}
+
+// =========================RenderThread==================================
+/*
+* Takes over the image manager's bitmaps and gives it memory bitmap copies instead. Done on the calling thread, before
+* the render thread starts, so no reload can change the images while they are being copied and the game loop's
+* thread never touches a bitmap on the display again.
+*/
+Tetris::Graphics::RenderThread::RenderThread(ALLEGRO_DISPLAY* display, Tetris::Utils::ImageManager& images, Tetris::Utils::FontManager& fonts) : display(display), fonts(fonts), capture(nullptr), running(false), framesDrawn(0), resized(false) {
+	Tetris::Utils::MemoryScope scope(Tetris::Utils::MEMORY_IMAGES);
+	int flags = al_get_new_bitmap_flags();
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+	for (int i = 0; i < 3; i++) {
+		Tetris::Utils::ImageManager::Image image = (Tetris::Utils::ImageManager::Image)i;
+		bitmaps[i] = images.getImage(image);
+		ALLEGRO_BITMAP* copy = al_clone_bitmap(bitmaps[i]);
+		if (copy == nullptr) {
+			al_set_new_bitmap_flags(flags);
+			throw "Could not copy the images for the render thread";
+		}
+		images.replaceImage(image, copy);
+	}
+	al_set_new_bitmap_flags(flags);
+}
+
+/*
+* Stops the render thread.
+*/
+Tetris::Graphics::RenderThread::~RenderThread() {
+	stop();
+	// Only memory bitmaps are left in the queue, so they can be freed on any thread.
+	ImageSwap swap;
+	while (swaps.pop(swap)) {
+		al_destroy_bitmap(swap.bitmap);
+		al_destroy_bitmap(swap.retired);
+	}
+}
+
+/*
+* Records every frame drawn with the capture. Must be called before start().
+*/
+void Tetris::Graphics::RenderThread::setCapture(Tetris::Utils::VideoCapture* capture) {
+	this->capture = capture;
+}
+
+/*
+* Starts the render thread. The calling thread must have released the display.
+*/
+void Tetris::Graphics::RenderThread::start() {
+	if (running) {
+		return;
+	}
+	running = true;
+	thread = std::thread(&Tetris::Graphics::RenderThread::run, this);
+}
+
+/*
+* Stops the render thread, which releases the display as it exits.
+*/
+void Tetris::Graphics::RenderThread::stop() {
+	if (!running) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(wakeLock);
+		running = false;
+	}
+	wake.notify_one();
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+/*
+* Gets the snapshot to fill in for the next frame.
+*/
+Tetris::FrameSnapshot& Tetris::Graphics::RenderThread::beginFrame() {
+	return frames.back();
+}
+
+/*
+* Hands the filled in snapshot to the render thread. The lock is only ever held by the render thread while it
+* checks for a frame, so this never waits on drawing.
+*/
+void Tetris::Graphics::RenderThread::publish() {
+	frames.publish();
+	{
+		std::lock_guard<std::mutex> lock(wakeLock);
+	}
+	wake.notify_one();
+}
+
+/*
+* Replaces one of the images. The bitmap is uploaded and the retired one destroyed on the render thread before the
+* next frame. Both are memory bitmaps, so if the queue is full they are simply freed here and the render thread
+* keeps the image it has.
+*/
+void Tetris::Graphics::RenderThread::replaceImage(Tetris::Utils::ImageManager::Image image, ALLEGRO_BITMAP* bitmap, ALLEGRO_BITMAP* retired) {
+	ImageSwap swap;
+	swap.image = image;
+	swap.bitmap = bitmap;
+	swap.retired = retired;
+	if (!swaps.push(swap)) {
+		al_destroy_bitmap(bitmap);
+		al_destroy_bitmap(retired);
+	}
+}
+
+/*
+* Gets the number of frames drawn so far.
+*/
+long long Tetris::Graphics::RenderThread::getFramesDrawn() {
+	return framesDrawn;
+}
+
+/*
+* Asks the render thread to acknowledge that the display was resized, since it owns the display.
+*/
+void Tetris::Graphics::RenderThread::resize() {
+	resized = true;
+}
+
+/*
+* The body of the render thread. Takes the display and draws every new snapshot with the images it took over until
+* stopped.
+*/
+void Tetris::Graphics::RenderThread::run() {
+	al_set_target_backbuffer(display);
+	// Everything the render thread allocates is for drawing the widgets and effects, apart from swapped in images.
+	Tetris::Utils::setMemoryTag(Tetris::Utils::MEMORY_UI);
+	SceneRenderer* renderer = new SceneRenderer(bitmaps[Tetris::Utils::ImageManager::GAMEMUSIC],
+		bitmaps[Tetris::Utils::ImageManager::TETRIS], bitmaps[Tetris::Utils::ImageManager::WALL],
+		fonts.getFont(Tetris::Utils::FontManager::TITLE), fonts.getFont(Tetris::Utils::FontManager::NORMAL));
+	DynamicResolution resolution(Tetris::Layout::SCREEN_WIDTH, Tetris::Layout::SCREEN_HEIGHT, RENDER_BUDGET);
+
+	while (running) {
+		{
+			std::unique_lock<std::mutex> lock(wakeLock);
+			bool fresh = wake.wait_for(lock, std::chrono::milliseconds(100), [this] { return !running || frames.acquire(); });
+			if (!running) {
+				break;
+			}
+			if (!fresh) {
+				continue;
+			}
+		}
+		if (resized.exchange(false)) {
+			al_acknowledge_resize(display);
+		}
+		swapImages(*renderer);
+		resolution.beginFrame(display);
+		renderer->draw(frames.front());
+		resolution.endFrame(display);
+		if (capture != nullptr) {
+			capture->captureFrame(resolution.getTarget(), al_get_time());
+		}
+		al_flip_display();
+		framesDrawn++;
+	}
+
+	delete renderer;
+	for (int i = 0; i < 3; i++) {
+		al_destroy_bitmap(bitmaps[i]);
+		bitmaps[i] = nullptr;
+	}
+	al_set_target_bitmap(NULL);
+}
+
+/*
+* Uploads and swaps in images replaced since the last frame, and destroys the bitmaps the game retired.
+*/
+void Tetris::Graphics::RenderThread::swapImages(Tetris::Graphics::SceneRenderer& renderer) {
+	Tetris::Utils::MemoryScope scope(Tetris::Utils::MEMORY_IMAGES);
+	ImageSwap swap;
+	while (swaps.pop(swap)) {
+		al_destroy_bitmap(swap.retired);
+		if (swap.bitmap == nullptr) {
+			continue;
+		}
+		ALLEGRO_BITMAP* bitmap = al_clone_bitmap(swap.bitmap);
+		al_destroy_bitmap(swap.bitmap);
+		if (bitmap == nullptr) {
+			continue;
+		}
+		renderer.setImage(swap.image, bitmap);
+		al_destroy_bitmap(bitmaps[swap.image]);
+		bitmaps[swap.image] = bitmap;
+	}
+}
@@ -0,0 +1,127 @@
+// Resolution.cpp implements the offscreen target that adapts its resolution to keep drawing within a time budget
+
+#include "resolution.h"
+
+/*
+* The range and step of the scale.
+*/
+static const float MIN_SCALE = 0.4f;
+static const float MAX_SCALE = 2.0f;
+static const float SCALE_STEP = 0.1f;
+
+/*
+* Scaling up only happens when frames take less than this share of the budget, so a scale that just fits doesn't
+* bounce up and straight back down.
+*/
+static const double HEADROOM = 0.6;
+
+/*
+* Gets how much the logical frame is scaled to fit the display, keeping its aspect ratio.
+*/
+static float getWindowScale(ALLEGRO_DISPLAY* display, float logicalWidth, float logicalHeight) {
+	float scaleX = al_get_display_width(display) / logicalWidth;
+	float scaleY = al_get_display_height(display) / logicalHeight;
+	return scaleX < scaleY ? scaleX : scaleY;
+}
+
+/*
+* Prepares to draw frames of the given logical size within the budget in seconds.
+*/
+Tetris::Graphics::DynamicResolution::DynamicResolution(float logicalWidth, float logicalHeight, double budget) : logicalWidth(logicalWidth),
+	logicalHeight(logicalHeight), budget(budget), target(nullptr), scale(1), frameStart(0), average(0), frames(0) {}
+
+/*
+* Frees the offscreen bitmap.
+*/
+Tetris::Graphics::DynamicResolution::~DynamicResolution() {
+	if (target != nullptr) {
+		al_destroy_bitmap(target);
+	}
+}
+
+/*
+* Targets the offscreen bitmap, recreating it if the scale changed. The scale never goes above the window's, since
+* pixels beyond that are thrown away when the frame is shrunk to fit.
+*/
+void Tetris::Graphics::DynamicResolution::beginFrame(ALLEGRO_DISPLAY* display) {
+	frameStart = al_get_time();
+	float windowScale = getWindowScale(display, logicalWidth, logicalHeight);
+	if (scale > windowScale) {
+		scale = windowScale > MIN_SCALE ? windowScale : MIN_SCALE;
+	}
+	int width = (int)(logicalWidth * scale + 0.5f);
+	int height = (int)(logicalHeight * scale + 0.5f);
+	if (target == nullptr || al_get_bitmap_width(target) != width || al_get_bitmap_height(target) != height) {
+		if (target != nullptr) {
+			al_destroy_bitmap(target);
+		}
+		target = al_create_bitmap(width, height);
+	}
+	al_set_target_bitmap(target);
+	ALLEGRO_TRANSFORM transform;
+	al_identity_transform(&transform);
+	al_scale_transform(&transform, (float)width / logicalWidth, (float)height / logicalHeight);
+	al_use_transform(&transform);
+}
+
+/*
+* Draws the offscreen bitmap centred in the backbuffer at the window's scale, then adapts the scale.
+*/
+void Tetris::Graphics::DynamicResolution::endFrame(ALLEGRO_DISPLAY* display) {
+	al_set_target_backbuffer(display);
+	ALLEGRO_TRANSFORM identity;
+	al_identity_transform(&identity);
+	al_use_transform(&identity);
+	float windowScale = getWindowScale(display, logicalWidth, logicalHeight);
+	float width = logicalWidth * windowScale;
+	float height = logicalHeight * windowScale;
+	al_clear_to_color(al_map_rgb(0, 0, 0));
+	al_draw_scaled_bitmap(target, 0, 0, al_get_bitmap_width(target), al_get_bitmap_height(target),
+		(al_get_display_width(display) - width) / 2, (al_get_display_height(display) - height) / 2, width, height, 0);
+	adapt(al_get_time() - frameStart, windowScale);
+}
+
+/*
+* Gets the resolution the frames are drawn at, as a fraction of the logical size.
+*/
+float Tetris::Graphics::DynamicResolution::getScale() {
+	return scale;
+}
+
+/*
+* Gets the offscreen bitmap the last frame was drawn to.
+*/
+ALLEGRO_BITMAP* Tetris::Graphics::DynamicResolution::getTarget() {
+	return target;
+}
+
+/*
+* Converts a position in the window to logical coordinates by undoing the centring and scaling done by endFrame().
+*/
+void Tetris::Graphics::DynamicResolution::toLogical(ALLEGRO_DISPLAY* display, float logicalWidth, float logicalHeight, float& x, float& y) {
+	float windowScale = getWindowScale(display, logicalWidth, logicalHeight);
+	if (windowScale <= 0) {
+		return;
+	}
+	x = (x - (al_get_display_width(display) - logicalWidth * windowScale) / 2) / windowScale;
+	y = (y - (al_get_display_height(display) - logicalHeight * windowScale) / 2) / windowScale;
+}
+
+/*
+* Keeps a moving average of the draw time and, every ADAPT_FRAMES frames, steps the scale down if the average is
+* over budget or up if it is well under.
+*/
+void Tetris::Graphics::DynamicResolution::adapt(double seconds, float windowScale) {
+	average = frames == 0 && average == 0 ? seconds : average * 0.9 + seconds * 0.1;
+	if (++frames < ADAPT_FRAMES) {
+		return;
+	}
+	frames = 0;
+	float limit = windowScale < MAX_SCALE ? windowScale : MAX_SCALE;
+	if (average > budget && scale > MIN_SCALE) {
+		scale = scale - SCALE_STEP > MIN_SCALE ? scale - SCALE_STEP : MIN_SCALE;
+	}
+	else if (average < budget * HEADROOM && scale < limit) {
+		scale = scale + SCALE_STEP < limit ? scale + SCALE_STEP : limit;
+	}
+}
@@ -0,0 +1,225 @@
+// Scores.cpp implements the high score table and its memory mapped file
+
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include "scores.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/*
+* The version of the file layout.
+*/
+static const unsigned int SCORE_FILE_VERSION = 1;
+
+// =========================ScoreTable==================================
+/*
+* Adds a score if it is good enough to make the table, shifting lower scores down. A score equal to one already in
+* the table goes below it, so earlier scores keep their place.
+*/
+bool Tetris::Utils::ScoreTable::add(int score, long long time) {
+	if (score <= 0) {
+		return false;
+	}
+	int position = count;
+	while (position > 0 && scores[position - 1] < score) {
+		position--;
+	}
+	if (position == SIZE) {
+		return false;
+	}
+	int last = count < SIZE ? count : SIZE - 1;
+	for (int i = last; i > position; i--) {
+		scores[i] = scores[i - 1];
+		times[i] = times[i - 1];
+	}
+	scores[position] = score;
+	times[position] = time;
+	if (count < SIZE) {
+		count++;
+	}
+	return true;
+}
+
+/*
+* Gets the best score, or 0 if there are none.
+*/
+int Tetris::Utils::ScoreTable::best() const {
+	return count > 0 ? scores[0] : 0;
+}
+
+// =========================HighScores==================================
+/*
+* Creates an empty table that isn't backed by a file.
+*/
+Tetris::Utils::HighScores::HighScores() : mapped(nullptr), running(false) {
+	memset(&table, 0, sizeof(table));
+#ifdef _WIN32
+	file = INVALID_HANDLE_VALUE;
+	mapping = nullptr;
+#else
+	file = -1;
+#endif
+}
+
+/*
+* Flushes the table and closes the file.
+*/
+Tetris::Utils::HighScores::~HighScores() {
+	close();
+}
+
+/*
+* Maps the file, creating it if needed. A file that is new or doesn't look like a score file starts out empty.
+* Otherwise the table is read straight out of the mapping.
+*/
+bool Tetris::Utils::HighScores::open(const char* path) {
+	if (mapped != nullptr) {
+		return true;
+	}
+#ifdef _WIN32
+	file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, 0, sizeof(ScoreFile), NULL);
+	if (mapping != nullptr) {
+		mapped = (ScoreFile*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(ScoreFile));
+	}
+#else
+	file = ::open(path, O_RDWR | O_CREAT, 0644);
+	if (file < 0) {
+		return false;
+	}
+	if (ftruncate(file, sizeof(ScoreFile)) == 0) {
+		void* memory = mmap(nullptr, sizeof(ScoreFile), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		mapped = memory != MAP_FAILED ? (ScoreFile*)memory : nullptr;
+	}
+#endif
+	if (mapped == nullptr) {
+		unmap();
+		return false;
+	}
+
+	if (memcmp(mapped->magic, "TSCR", 4) != 0 || mapped->version != SCORE_FILE_VERSION || mapped->table.count < 0 || mapped->table.count > ScoreTable::SIZE) {
+		memset(mapped, 0, sizeof(ScoreFile));
+		memcpy(mapped->magic, "TSCR", 4);
+		mapped->version = SCORE_FILE_VERSION;
+		sync();
+	}
+	table = mapped->table;
+	running = true;
+	thread = std::thread(&Tetris::Utils::HighScores::run, this);
+	return true;
+}
+
+/*
+* Stops the writer thread, which writes the latest table before it exits, and unmaps the file.
+*/
+void Tetris::Utils::HighScores::close() {
+	if (running) {
+		running = false;
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+	unmap();
+}
+
+/*
+* Adds a score to the game loop's copy of the table. If it made the table the new table is handed to the writer
+* thread, which never makes this wait.
+*/
+bool Tetris::Utils::HighScores::submit(int score) {
+	if (!table.add(score, (long long)time(NULL))) {
+		return false;
+	}
+	if (mapped != nullptr) {
+		submitted.back() = table;
+		submitted.publish();
+	}
+	return true;
+}
+
+/*
+* Gets the table as the game loop sees it.
+*/
+const Tetris::Utils::ScoreTable& Tetris::Utils::HighScores::getTable() {
+	return table;
+}
+
+/*
+* The body of the writer thread. Checks for a new table every SYNC_INTERVAL so several scores in quick succession
+* cost one flush, and writes whatever is left when stopped.
+*/
+void Tetris::Utils::HighScores::run() {
+	const int step = 50;
+	int waited = 0;
+	while (running) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(step));
+		waited += step;
+		if (waited >= SYNC_INTERVAL) {
+			waited = 0;
+			write();
+		}
+	}
+	write();
+}
+
+/*
+* Copies the latest submitted table into the mapping and flushes it. Returns whether there was one.
+*/
+bool Tetris::Utils::HighScores::write() {
+	if (!submitted.acquire()) {
+		return false;
+	}
+	mapped->table = submitted.front();
+	sync();
+	return true;
+}
+
+/*
+* Flushes the mapping to disk.
+*/
+void Tetris::Utils::HighScores::sync() {
+#ifdef _WIN32
+	FlushViewOfFile(mapped, sizeof(ScoreFile));
+	FlushFileBuffers(file);
+#else
+	msync(mapped, sizeof(ScoreFile), MS_SYNC);
+#endif
+}
+
+/*
+* Unmaps and closes the file.
+*/
+void Tetris::Utils::HighScores::unmap() {
+#ifdef _WIN32
+	if (mapped != nullptr) {
+		UnmapViewOfFile(mapped);
+	}
+	if (mapping != nullptr) {
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+	if (file != INVALID_HANDLE_VALUE) {
+		CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (mapped != nullptr) {
+		munmap(mapped, sizeof(ScoreFile));
+	}
+	if (file >= 0) {
+		::close(file);
+		file = -1;
+	}
+#endif
+	mapped = nullptr;
+}
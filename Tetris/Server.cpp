@@ -0,0 +1,614 @@
+// Server.cpp implements the authoritative game server and the bots used to load it
+
+#include <stdio.h>
+#include <chrono>
+#include "server.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+/*
+* The states sent to clients. Matches Tetris::Graphics::InformationBox::State.
+*/
+static const int STATE_ACTIVE = 0;
+static const int STATE_OVER = 2;
+
+/*
+* The value stored with the listening socket in an epoll set, in place of a session index.
+*/
+static const unsigned int LISTENER_EVENT = 0xFFFFFFFF;
+
+/*
+* The physics every session plays with.
+*/
+static const Tetris::Utils::Tuning TUNING = Tetris::Utils::Tuning();
+
+/*
+* Gets the time from a monotonic clock in microseconds.
+*/
+static long long microseconds() {
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+/*
+* Gets the CPU time used by the calling thread in seconds.
+*/
+static double threadSeconds() {
+	timespec used;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &used);
+	return used.tv_sec + used.tv_nsec / 1e9;
+}
+
+// =========================SessionServer==================================
+/*
+* Creates a server with the given number of worker threads, at least one.
+*/
+Tetris::Net::SessionServer::SessionServer(int workers) : listener(INVALID), running(false), seeds(1) {
+	if (workers < 1) {
+		workers = 1;
+	}
+	for (int i = 0; i < workers; i++) {
+		Worker* worker = new Worker();
+		worker->epoll = -1;
+		this->workers.push_back(worker);
+	}
+}
+
+/*
+* Stops the server.
+*/
+Tetris::Net::SessionServer::~SessionServer() {
+	stop();
+	for (Worker* worker : workers) {
+		delete worker;
+	}
+}
+
+/*
+* Opens the listening socket and gives every worker an epoll set watching it. EPOLLEXCLUSIVE wakes only one of the
+* workers for each new client, which spreads clients between them without a thread handing them out.
+*/
+bool Tetris::Net::SessionServer::start(int port) {
+	if (!startup()) {
+		return false;
+	}
+	listener = listenTcp("0.0.0.0", port);
+	if (listener == INVALID) {
+		return false;
+	}
+	setNonBlocking(listener);
+	running = true;
+	long long now = microseconds() / 1000;
+	for (Worker* worker : workers) {
+		worker->epoll = epoll_create1(0);
+		epoll_event event;
+		event.events = EPOLLIN | EPOLLEXCLUSIVE;
+		event.data.u32 = LISTENER_EVENT;
+		epoll_ctl(worker->epoll, EPOLL_CTL_ADD, listener, &event);
+		for (int i = 0; i < WHEEL_SLOTS; i++) {
+			worker->wheel[i] = -1;
+		}
+		worker->now = now;
+		worker->stats.sessions = 0;
+		worker->stats.ticks = 0;
+		worker->stats.jitterSum = 0;
+		worker->stats.jitterMax = 0;
+		worker->stats.busySeconds = 0;
+		worker->thread = std::thread(&SessionServer::run, this, std::ref(*worker));
+	}
+	return true;
+}
+
+/*
+* Disconnects every client and stops the workers.
+*/
+void Tetris::Net::SessionServer::stop() {
+	if (!running) {
+		return;
+	}
+	running = false;
+	for (Worker* worker : workers) {
+		worker->thread.join();
+		for (int i = 0; i < (int)worker->sessions.size(); i++) {
+			if (worker->sessions[i].socket != INVALID) {
+				closeSession(*worker, i);
+			}
+		}
+		close(worker->epoll);
+		worker->epoll = -1;
+	}
+	closeSocket(listener);
+	listener = INVALID;
+}
+
+/*
+* Adds up the counters of every worker since the last call, then clears them.
+*/
+Tetris::Net::SessionServer::Stats Tetris::Net::SessionServer::takeStats() {
+	Stats total = { 0, 0, 0, 0, 0 };
+	for (Worker* worker : workers) {
+		std::lock_guard<std::mutex> guard(worker->statsLock);
+		total.sessions += worker->stats.sessions;
+		total.ticks += worker->stats.ticks;
+		total.jitterSum += worker->stats.jitterSum;
+		if (worker->stats.jitterMax > total.jitterMax) {
+			total.jitterMax = worker->stats.jitterMax;
+		}
+		total.busySeconds += worker->stats.busySeconds;
+		worker->stats.ticks = 0;
+		worker->stats.jitterSum = 0;
+		worker->stats.jitterMax = 0;
+		worker->stats.busySeconds = 0;
+	}
+	return total;
+}
+
+/*
+* Gets the number of worker threads.
+*/
+int Tetris::Net::SessionServer::getWorkerCount() {
+	return (int)workers.size();
+}
+
+/*
+* Runs the wheel up to the current millisecond, ticking every session that is due, then sleeps in epoll_wait until
+* a client sends something or the next occupied slot comes round.
+*/
+void Tetris::Net::SessionServer::run(Worker& worker) {
+	const int MAX_EVENTS = 256;
+	epoll_event events[MAX_EVENTS];
+	double busyStart = threadSeconds();
+	while (running) {
+		long long now = microseconds();
+		long long ticks = 0;
+		double jitterSum = 0;
+		double jitterMax = 0;
+		for (; worker.now <= now / 1000; worker.now++) {
+			int slot = (int)(worker.now % WHEEL_SLOTS);
+			int index = worker.wheel[slot];
+			worker.wheel[slot] = -1;
+			while (index != -1) {
+				Session& session = worker.sessions[index];
+				int next = session.next;
+				session.next = -1;
+				session.previous = -1;
+				if ((session.due + 999) / 1000 > worker.now) {
+					// Due on a later turn of the wheel.
+					schedule(worker, index);
+					index = next;
+					continue;
+				}
+				long long start = microseconds();
+				double late = (start - session.due) / 1e6;
+				jitterSum += late;
+				if (late > jitterMax) {
+					jitterMax = late;
+				}
+				ticks++;
+				session.due += TICK_MICROSECONDS;
+				if (session.due < start) {
+					// Too far behind to catch up; skip the missed ticks rather than run them in a burst.
+					session.due = start + TICK_MICROSECONDS;
+				}
+				if (tickSession(session)) {
+					schedule(worker, index);
+				}
+				else {
+					closeSession(worker, index);
+				}
+				index = next;
+			}
+		}
+
+		{
+			double busyEnd = threadSeconds();
+			std::lock_guard<std::mutex> guard(worker.statsLock);
+			worker.stats.ticks += ticks;
+			worker.stats.jitterSum += jitterSum;
+			if (jitterMax > worker.stats.jitterMax) {
+				worker.stats.jitterMax = jitterMax;
+			}
+			worker.stats.busySeconds += busyEnd - busyStart;
+			busyStart = busyEnd;
+		}
+
+		// Sleep until the next occupied slot, checking for shutdown at least every turn of the wheel. The wheel has
+		// been run past the current millisecond, so slot worker.now + i comes round at the start of that millisecond;
+		// sleeping until then rounded up keeps an occupied next slot from turning into a zero timeout busy poll.
+		int timeout = WHEEL_SLOTS;
+		for (int i = 0; i < WHEEL_SLOTS; i++) {
+			if (worker.wheel[(worker.now + i) % WHEEL_SLOTS] != -1) {
+				long long remaining = (worker.now + i) * 1000 - microseconds();
+				timeout = remaining > 0 ? (int)((remaining + 999) / 1000) : 0;
+				break;
+			}
+		}
+		int count = epoll_wait(worker.epoll, events, MAX_EVENTS, timeout);
+		for (int i = 0; i < count; i++) {
+			if (events[i].data.u32 == LISTENER_EVENT) {
+				acceptSessions(worker, microseconds());
+			}
+			else {
+				int index = (int)events[i].data.u32;
+				if (worker.sessions[index].socket != INVALID && !readInputs(worker.sessions[index])) {
+					closeSession(worker, index);
+				}
+			}
+		}
+	}
+}
+
+/*
+* Accepts every waiting client, giving each a new world and a first tick one tick from now.
+*/
+void Tetris::Net::SessionServer::acceptSessions(Worker& worker, long long now) {
+	while (true) {
+		Socket client = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+		if (client == INVALID) {
+			return;
+		}
+		int index;
+		if (!worker.freeSessions.empty()) {
+			index = worker.freeSessions.back();
+			worker.freeSessions.pop_back();
+		}
+		else {
+			index = (int)worker.sessions.size();
+			worker.sessions.push_back(Session());
+		}
+		Session& session = worker.sessions[index];
+		session.socket = client;
+		// Sessions aren't sized from images, so they test boxes only, the same as the bots.
+		session.world.create(nullptr, SESSION_PLAYER_WIDTH, SESSION_PLAYER_HEIGHT, SESSION_WALL_WIDTH, SESSION_WALL_HEIGHT, seeds.fetch_add(1));
+		session.over = false;
+		session.changed = true;
+		session.tick = 0;
+		session.due = now + TICK_MICROSECONDS;
+		session.sent.tick = 0;
+		session.pending.clear();
+		schedule(worker, index);
+
+		epoll_event event;
+		event.events = EPOLLIN | EPOLLRDHUP;
+		event.data.u32 = (unsigned int)index;
+		epoll_ctl(worker.epoll, EPOLL_CTL_ADD, client, &event);
+
+		std::lock_guard<std::mutex> guard(worker.statsLock);
+		worker.stats.sessions++;
+	}
+}
+
+/*
+* Reads every input the client has sent. Inputs apply to the next tick, like key presses in the game.
+*/
+bool Tetris::Net::SessionServer::readInputs(Session& session) {
+	char inputs[256];
+	while (true) {
+		int count = receive(session.socket, inputs, sizeof(inputs));
+		if (count == 0) {
+			return false;
+		}
+		if (count < 0) {
+			return wouldBlock();
+		}
+		for (int i = 0; i < count; i++) {
+			if (inputs[i] == INPUT_SMALL_BOOST && !session.over) {
+				session.world.boost(TUNING.smallBoost);
+			}
+			else if (inputs[i] == INPUT_BIG_BOOST && !session.over) {
+				session.world.boost(TUNING.bigBoost);
+			}
+			else if (inputs[i] == INPUT_RESTART && session.over) {
+				session.world.reset();
+				session.over = false;
+				session.changed = true;
+			}
+		}
+	}
+}
+
+/*
+* Steps the world unless the player has crashed, then queues the state for the client if it changed and sends as
+* much as the socket will take.
+*/
+bool Tetris::Net::SessionServer::tickSession(Session& session) {
+	session.tick++;
+	if (!session.over) {
+		Tetris::Simulation::StepResult result = session.world.step(1.0f / 60);
+		if (result == Tetris::Simulation::CRASHED_FLOOR || result == Tetris::Simulation::CRASHED_WALL) {
+			session.over = true;
+		}
+		session.changed = true;
+	}
+	if (session.changed) {
+		SpectatorFrame frame;
+		makeFrame(frame, session.tick, session.world, session.over ? STATE_OVER : STATE_ACTIVE);
+		unsigned char message[1 + MAX_ENCODED_FRAME];
+		int size = encodeFrame(frame, session.sent.tick != 0 ? &session.sent : nullptr, message + 1);
+		message[0] = (unsigned char)size;
+		session.pending.insert(session.pending.end(), message, message + 1 + size);
+		session.sent = frame;
+		session.changed = false;
+	}
+	if (!session.pending.empty()) {
+		int sent = sendSome(session.socket, (const char*)&session.pending[0], (int)session.pending.size());
+		if (sent < 0) {
+			return false;
+		}
+		session.pending.erase(session.pending.begin(), session.pending.begin() + sent);
+	}
+	return session.pending.size() <= MAX_PENDING;
+}
+
+/*
+* Puts a session at the head of the slot for the first millisecond after it is due, or the next slot if that has
+* passed, so a tick never runs early.
+*/
+void Tetris::Net::SessionServer::schedule(Worker& worker, int index) {
+	Session& session = worker.sessions[index];
+	long long due = (session.due + 999) / 1000;
+	if (due <= worker.now) {
+		due = worker.now + 1;
+	}
+	int slot = (int)(due % WHEEL_SLOTS);
+	session.previous = -1;
+	session.next = worker.wheel[slot];
+	if (session.next != -1) {
+		worker.sessions[session.next].previous = index;
+	}
+	worker.wheel[slot] = index;
+}
+
+/*
+* Takes a session out of its slot. The slot is found from the due time the same way schedule() picked it.
+*/
+void Tetris::Net::SessionServer::unschedule(Worker& worker, int index) {
+	Session& session = worker.sessions[index];
+	if (session.previous != -1) {
+		worker.sessions[session.previous].next = session.next;
+	}
+	else {
+		for (int i = 0; i < WHEEL_SLOTS; i++) {
+			if (worker.wheel[i] == index) {
+				worker.wheel[i] = session.next;
+				break;
+			}
+		}
+	}
+	if (session.next != -1) {
+		worker.sessions[session.next].previous = session.previous;
+	}
+	session.next = -1;
+	session.previous = -1;
+}
+
+/*
+* Disconnects a session and frees its slot.
+*/
+void Tetris::Net::SessionServer::closeSession(Worker& worker, int index) {
+	Session& session = worker.sessions[index];
+	if (session.socket == INVALID) {
+		return;
+	}
+	unschedule(worker, index);
+	epoll_ctl(worker.epoll, EPOLL_CTL_DEL, session.socket, nullptr);
+	closeSocket(session.socket);
+	session.socket = INVALID;
+	session.pending.clear();
+	worker.freeSessions.push_back(index);
+
+	std::lock_guard<std::mutex> guard(worker.statsLock);
+	worker.stats.sessions--;
+}
+
+/*
+* Runs a session server until the process is killed, printing its load every few seconds. Sessions per core is the
+* number of sessions divided by the cores the workers kept busy, which is what the server could hold per core if the
+* load grew evenly.
+*/
+int Tetris::Net::runSessionServer(int port, int workers) {
+	const int REPORT_INTERVAL = 5;
+	SessionServer server(workers);
+	if (!server.start(port)) {
+		fprintf(stderr, "Could not serve sessions on port %d\n", port);
+		return 1;
+	}
+	printf("Serving sessions on port %d with %d workers\n", port, server.getWorkerCount());
+	server.takeStats();
+	long long last = microseconds();
+	while (true) {
+		std::this_thread::sleep_for(std::chrono::seconds(REPORT_INTERVAL));
+		long long now = microseconds();
+		double elapsed = (now - last) / 1e6;
+		last = now;
+		SessionServer::Stats stats = server.takeStats();
+		double cores = stats.busySeconds / elapsed;
+		printf("%d sessions, %.0f ticks/s, %.2f cores busy", stats.sessions, stats.ticks / elapsed, cores);
+		if (cores > 0) {
+			printf(", %.0f sessions per core", stats.sessions / cores);
+		}
+		if (stats.ticks > 0) {
+			printf(", jitter %.3f ms mean %.3f ms max", stats.jitterSum / stats.ticks * 1000, stats.jitterMax * 1000);
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+}
+
+// =========================Bots==================================
+/*
+* A bot's connection and the game as it last saw it.
+*/
+struct Bot {
+	Tetris::Net::Socket socket;						// The connection, or INVALID once lost.
+	std::vector<unsigned char> received;			// Bytes received but not decoded yet.
+	Tetris::Net::SpectatorFrame latest;				// The last frame decoded, the base of the next one.
+	Tetris::Simulation::World world;				// The game the frames are applied to for the demo AI.
+	long long frames;								// Frames decoded.
+	long long bytes;								// Bytes received.
+	long long games;								// Games restarted after crashing.
+};
+
+/*
+* Decodes every complete message the bot has received, then answers the newest frame the way the demo plays: a
+* boost when the AI would jump, a restart after a crash. Returns false if the stream couldn't be decoded.
+*/
+static bool playBot(Bot& bot) {
+	size_t used = 0;
+	bool decoded = false;
+	while (used < bot.received.size() && used + 1 + bot.received[used] <= bot.received.size()) {
+		int size = bot.received[used];
+		Tetris::Net::SpectatorFrame frame;
+		if (Tetris::Net::decodeFrame(&bot.received[used + 1], size, bot.frames > 0 ? &bot.latest : nullptr, frame) != size) {
+			return false;
+		}
+		bot.latest = frame;
+		bot.frames++;
+		used += 1 + size;
+		decoded = true;
+	}
+	bot.received.erase(bot.received.begin(), bot.received.begin() + used);
+	if (!decoded) {
+		return true;
+	}
+	char input = 0;
+	if (bot.latest.state == STATE_OVER) {
+		input = Tetris::Net::INPUT_RESTART;
+		bot.games++;
+	}
+	else {
+		Tetris::Net::applyFrame(bot.latest, bot.world);
+		float before = Tetris::Simulation::toFloat(bot.world.dy[bot.world.player]);
+		bot.world.demoMove(TUNING);
+		float after = Tetris::Simulation::toFloat(bot.world.dy[bot.world.player]);
+		if (after != before) {
+			input = after == TUNING.bigBoost ? Tetris::Net::INPUT_BIG_BOOST : Tetris::Net::INPUT_SMALL_BOOST;
+		}
+	}
+	return input == 0 || Tetris::Net::sendSome(bot.socket, &input, 1) >= 0;
+}
+
+/*
+* Connects the bots and plays them all from one epoll loop, so a single process can load a server with thousands
+* of clients.
+*/
+int Tetris::Net::runBots(int bots, int port, double seconds) {
+	if (!startup()) {
+		return 1;
+	}
+	int epoll = epoll_create1(0);
+	std::vector<Bot> players(bots);
+	int connected = 0;
+	for (int i = 0; i < bots; i++) {
+		Bot& bot = players[i];
+		bot.frames = 0;
+		bot.bytes = 0;
+		bot.games = 0;
+		bot.world.create(nullptr, SESSION_PLAYER_WIDTH, SESSION_PLAYER_HEIGHT, SESSION_WALL_WIDTH, SESSION_WALL_HEIGHT, 1);
+		bot.socket = connectTcp("127.0.0.1", port);
+		if (bot.socket == INVALID) {
+			continue;
+		}
+		setNonBlocking(bot.socket);
+		epoll_event event;
+		event.events = EPOLLIN | EPOLLRDHUP;
+		event.data.u32 = (unsigned int)i;
+		epoll_ctl(epoll, EPOLL_CTL_ADD, bot.socket, &event);
+		connected++;
+	}
+	printf("Connected %d of %d bots to port %d\n", connected, bots, port);
+
+	const int MAX_EVENTS = 256;
+	epoll_event events[MAX_EVENTS];
+	char buffer[4096];
+	int lost = 0;
+	long long start = microseconds();
+	long long end = start + (long long)(seconds * 1000000);
+	while (microseconds() < end) {
+		int count = epoll_wait(epoll, events, MAX_EVENTS, 10);
+		for (int i = 0; i < count; i++) {
+			Bot& bot = players[events[i].data.u32];
+			bool alive = true;
+			while (alive) {
+				int received = receive(bot.socket, buffer, sizeof(buffer));
+				if (received > 0) {
+					bot.bytes += received;
+					bot.received.insert(bot.received.end(), buffer, buffer + received);
+				}
+				else {
+					alive = received < 0 && wouldBlock();
+					break;
+				}
+			}
+			if (alive) {
+				alive = playBot(bot);
+			}
+			if (!alive) {
+				epoll_ctl(epoll, EPOLL_CTL_DEL, bot.socket, nullptr);
+				closeSocket(bot.socket);
+				bot.socket = INVALID;
+				lost++;
+			}
+		}
+	}
+	double elapsed = (microseconds() - start) / 1e6;
+
+	long long frames = 0;
+	long long bytes = 0;
+	long long games = 0;
+	for (Bot& bot : players) {
+		frames += bot.frames;
+		bytes += bot.bytes;
+		games += bot.games;
+		if (bot.socket != INVALID) {
+			closeSocket(bot.socket);
+		}
+	}
+	close(epoll);
+	printf("%d still connected, %d lost after %.1f s, %lld games restarted\n", connected - lost, lost, elapsed, games);
+	if (bots > 0 && frames > 0) {
+		printf("  %.1f frames/s per bot, %.1f KB/s in total, %.1f bytes per frame\n", frames / elapsed / bots, bytes / elapsed / 1024, (double)bytes / frames);
+	}
+	return connected == bots && lost == 0 ? 0 : 1;
+}
+
+#else
+
+// The server and bots use epoll, so elsewhere they only report that they aren't available.
+
+Tetris::Net::SessionServer::SessionServer(int workers) : listener(INVALID), running(false), seeds(1) {}
+
+Tetris::Net::SessionServer::~SessionServer() {}
+
+bool Tetris::Net::SessionServer::start(int port) {
+	return false;
+}
+
+void Tetris::Net::SessionServer::stop() {}
+
+Tetris::Net::SessionServer::Stats Tetris::Net::SessionServer::takeStats() {
+	Stats total = { 0, 0, 0, 0, 0 };
+	return total;
+}
+
+int Tetris::Net::SessionServer::getWorkerCount() {
+	return 0;
+}
+
+int Tetris::Net::runSessionServer(int port, int workers) {
+	fprintf(stderr, "The session server is only available on Linux\n");
+	return 1;
+}
+
+int Tetris::Net::runBots(int bots, int port, double seconds) {
+	fprintf(stderr, "The bots are only available on Linux\n");
+	return 1;
+}
+
+#endif
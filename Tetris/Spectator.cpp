@@ -0,0 +1,135 @@
+// Spectator.cpp implements the spectator viewer and the spectator load generator
+
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <allegro5/allegro.h>
+#include "spectator.h"
+#include "broadcast.h"
+#include "renderer.h"
+#include "utils.h"
+
+/*
+* Prepares to watch the game broadcast on the port.
+*/
+Tetris::SpectatorViewer::SpectatorViewer(int port) : port(port) {}
+
+/*
+* Opens a window and draws the newest frame received sixty times a second. The frames only move the objects of a
+* world created the same way as the game's, so the same SceneRenderer draws it.
+*/
+int Tetris::SpectatorViewer::run() {
+	Tetris::Net::SpectatorConnection connection;
+	if (!connection.connect(port)) {
+		fprintf(stderr, "Could not connect to the game on port %d\n", port);
+		return 1;
+	}
+	ALLEGRO_DISPLAY* display = al_create_display(Tetris::Layout::SCREEN_WIDTH, Tetris::Layout::SCREEN_HEIGHT);
+	if (display == nullptr) {
+		fprintf(stderr, "Could not create the display\n");
+		return 1;
+	}
+	al_set_window_title(display, "Tetris - Spectating");
+	ALLEGRO_EVENT_QUEUE* queue = al_create_event_queue();
+	ALLEGRO_TIMER* timer = al_create_timer(1.0 / 60);
+	al_register_event_source(queue, al_get_display_event_source(display));
+	al_register_event_source(queue, al_get_keyboard_event_source());
+	al_register_event_source(queue, al_get_timer_event_source(timer));
+
+	int result = 0;
+	{
+		Tetris::Utils::ImageManager images;
+		Tetris::Utils::FontManager fonts;
+		ALLEGRO_BITMAP* tetrisImage = images.getImage(Tetris::Utils::ImageManager::TETRIS);
+		ALLEGRO_BITMAP* wallImage = images.getImage(Tetris::Utils::ImageManager::WALL);
+		Tetris::Graphics::SceneRenderer renderer(images.getImage(Tetris::Utils::ImageManager::GAMEMUSIC), tetrisImage, wallImage,
+			fonts.getFont(Tetris::Utils::FontManager::TITLE), fonts.getFont(Tetris::Utils::FontManager::NORMAL));
+		FrameSnapshot frame;
+		frame.screen = FrameSnapshot::GAME;
+		frame.hoveredButton = -1;
+		frame.bestScore = 0;
+		frame.state = Tetris::Graphics::InformationBox::OVER;
+		frame.burstCount = 0;
+		frame.particleSeconds = 0;
+		// Only ever filled in from the broadcast and drawn, never stepped, so it needs no masks.
+		frame.world.create(nullptr, al_get_bitmap_width(tetrisImage), al_get_bitmap_height(tetrisImage), al_get_bitmap_width(wallImage), al_get_bitmap_height(wallImage), 1);
+
+		al_start_timer(timer);
+		bool watching = true;
+		while (watching) {
+			ALLEGRO_EVENT event;
+			al_wait_for_event(queue, &event);
+			if (event.type == ALLEGRO_EVENT_DISPLAY_CLOSE) {
+				watching = false;
+			}
+			else if (event.type == ALLEGRO_EVENT_KEY_UP && event.keyboard.keycode == ALLEGRO_KEY_ESCAPE) {
+				watching = false;
+			}
+			else if (event.type == ALLEGRO_EVENT_TIMER && al_is_event_queue_empty(queue)) {
+				if (!connection.poll()) {
+					fprintf(stderr, "The broadcast ended\n");
+					result = 1;
+					watching = false;
+				}
+				const Tetris::Net::SpectatorFrame* latest = connection.getLatest();
+				if (latest != nullptr) {
+					Tetris::Net::applyFrame(*latest, frame.world);
+					frame.state = (Tetris::Graphics::InformationBox::State)latest->state;
+				}
+				renderer.draw(frame);
+				al_flip_display();
+			}
+		}
+	}
+	al_destroy_timer(timer);
+	al_destroy_event_queue(queue);
+	al_destroy_display(display);
+	return result;
+}
+
+/*
+* Connects the spectators and polls every one of them in turn, like a viewer would, for the given number of seconds.
+*/
+int Tetris::runSpectatorLoad(int spectators, int port, double seconds) {
+	std::vector<Tetris::Net::SpectatorConnection> connections(spectators);
+	int connected = 0;
+	for (Tetris::Net::SpectatorConnection& connection : connections) {
+		if (connection.connect(port)) {
+			connected++;
+		}
+	}
+	printf("Connected %d of %d spectators to port %d\n", connected, spectators, port);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point end = start + std::chrono::milliseconds((long long)(seconds * 1000));
+	int lost = 0;
+	std::vector<bool> alive(spectators, true);
+	while (std::chrono::steady_clock::now() < end) {
+		for (int i = 0; i < spectators; i++) {
+			if (alive[i] && !connections[i].poll()) {
+				alive[i] = false;
+				lost++;
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	long long frames = 0;
+	long long bytes = 0;
+	long long fewest = -1;
+	for (Tetris::Net::SpectatorConnection& connection : connections) {
+		frames += connection.getFramesDecoded();
+		bytes += connection.getBytesReceived();
+		if (fewest < 0 || connection.getFramesDecoded() < fewest) {
+			fewest = connection.getFramesDecoded();
+		}
+	}
+	printf("%d still connected, %d lost after %.1f s\n", connected - lost, lost, elapsed);
+	if (spectators > 0 && frames > 0) {
+		printf("  %.1f frames/s per spectator (fewest %lld frames)\n", frames / elapsed / spectators, fewest);
+		printf("  %.1f KB/s in total, %.1f bytes per frame\n", bytes / elapsed / 1024, (double)bytes / frames);
+	}
+	return connected == spectators && lost == 0 ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+// Trainer.cpp implements the trainer that evolves networks to play the demo
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <thread>
+#include <allegro5/allegro.h>
+#include "trainer.h"
+#include "utils.h"
+#include "allocation.h"
+
+/*
+* How much the networks are changed when bred.
+*/
+static const float INITIAL_WEIGHT = 0.5f;		// Standard deviation of the random starting weights.
+static const float MUTATION_RATE = 0.1f;		// The chance of each weight being changed.
+static const float MUTATION_SIZE = 0.3f;		// Standard deviation of a change.
+
+/*
+* Creates a population of random networks.
+*/
+Tetris::Simulation::Trainer::Trainer(int population, unsigned int seed) : genomes(population), playerWidth(0), playerHeight(0),
+	wallWidth(0), wallHeight(0), randomState(seed != 0 ? seed : 1), decisions(0) {
+	for (Genome& genome : genomes) {
+		for (int w = 0; w < NETWORK_WEIGHTS; w++) {
+			genome.network.weights[w] = gaussian() * INITIAL_WEIGHT;
+		}
+		genome.fitness = 0;
+		genome.score = 0;
+	}
+}
+
+/*
+* Loads the images as memory bitmaps to get the collider sizes and masks the game uses, then evolves. Each generation plays a
+* different set of walls so the networks learn to fly rather than to remember one course.
+*/
+int Tetris::Simulation::Trainer::run(int generations, const char* path) {
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+	{
+		Tetris::Utils::ImageManager images;
+		ALLEGRO_BITMAP* tetrisImage = images.getImage(Tetris::Utils::ImageManager::TETRIS);
+		ALLEGRO_BITMAP* wallImage = images.getImage(Tetris::Utils::ImageManager::WALL);
+		if (tetrisImage == nullptr || wallImage == nullptr) {
+			fprintf(stderr, "Could not load the images\n");
+			return 1;
+		}
+		playerWidth = (float)al_get_bitmap_width(tetrisImage);
+		playerHeight = (float)al_get_bitmap_height(tetrisImage);
+		wallWidth = (float)al_get_bitmap_width(wallImage);
+		wallHeight = (float)al_get_bitmap_height(wallImage);
+		playerMask = images.getMask(Tetris::Utils::ImageManager::TETRIS);
+		wallMask = images.getMask(Tetris::Utils::ImageManager::WALL);
+		masks.set(Tetris::Utils::ImageManager::TETRIS, &playerMask);
+		masks.set(Tetris::Utils::ImageManager::WALL, &wallMask);
+	}
+	printf("Training %d networks for %d generations on %u threads\n", (int)genomes.size(), generations, std::thread::hardware_concurrency());
+	for (int generation = 1; generation <= generations; generation++) {
+		double start = al_get_time();
+		decisions = 0;
+		evaluate(random());
+		std::sort(genomes.begin(), genomes.end(), [](const Genome& a, const Genome& b) {
+			return a.fitness > b.fitness;
+		});
+		double elapsed = al_get_time() - start;
+		double total = 0;
+		for (const Genome& genome : genomes) {
+			total += genome.fitness;
+		}
+		printf("Generation %d: best %.1f (score %d), mean %.1f, %.2f s, %.1f million decisions/s\n", generation,
+			genomes[0].fitness, genomes[0].score, total / genomes.size(), elapsed, decisions / elapsed / 1e6);
+		if (!genomes[0].network.save(path)) {
+			fprintf(stderr, "Could not save the network to %s\n", path);
+			return 1;
+		}
+		if (generation < generations) {
+			breed();
+		}
+	}
+	printf("Saved the best network to %s\n", path);
+	return 0;
+}
+
+/*
+* Plays every genome on walls from the given seed, sharing them out between the threads.
+*/
+void Tetris::Simulation::Trainer::evaluate(unsigned int wallSeed) {
+	int threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+	int population = (int)genomes.size();
+	std::vector<std::thread> threads;
+	std::vector<long long> made(threadCount, 0);
+	for (int t = 0; t < threadCount; t++) {
+		int begin = population * t / threadCount;
+		int end = population * (t + 1) / threadCount;
+		threads.push_back(std::thread([this, &made, t, begin, end, wallSeed]() {
+			Tetris::Utils::setMemoryTag(Tetris::Utils::MEMORY_SIMULATION);
+			made[t] = evaluateRange(begin, end, wallSeed);
+		}));
+	}
+	for (int t = 0; t < threadCount; t++) {
+		threads[t].join();
+		decisions += made[t];
+	}
+}
+
+/*
+* Plays a range of genomes together. Each tick the inputs of every game still going are gathered into the batch,
+* every network decides at once, then each game is boosted and stepped.
+*/
+long long Tetris::Simulation::Trainer::evaluateRange(int begin, int end, unsigned int wallSeed) {
+	int count = end - begin;
+	Tetris::Utils::Tuning tuning;
+	NetworkBatch batch(count);
+	std::vector<World> worlds(count);
+	std::vector<bool> playing(count, true);
+	for (int i = 0; i < count; i++) {
+		batch.setNetwork(i, genomes[begin + i].network);
+		worlds[i].create(&masks, playerWidth, playerHeight, wallWidth, wallHeight, wallSeed);
+		genomes[begin + i].fitness = 0;
+	}
+	long long made = 0;
+	int left = count;
+	for (int tick = 1; tick <= MAX_TICKS && left > 0; tick++) {
+		float inputs[NETWORK_INPUTS];
+		for (int i = 0; i < count; i++) {
+			if (playing[i]) {
+				readInputs(worlds[i], 0, inputs);
+				batch.setInputs(i, inputs);
+			}
+		}
+		batch.decide();
+		made += left;
+		for (int i = 0; i < count; i++) {
+			if (!playing[i]) {
+				continue;
+			}
+			NetworkMove move = batch.getMove(i);
+			if (move == SMALL_BOOST) {
+				worlds[i].boost(tuning.smallBoost);
+			}
+			else if (move == BIG_BOOST) {
+				worlds[i].boost(tuning.bigBoost);
+			}
+			StepResult result = worlds[i].step(1.0f / 60);
+			if (result == CRASHED_FLOOR || result == CRASHED_WALL || tick == MAX_TICKS) {
+				Genome& genome = genomes[begin + i];
+				genome.score = worlds[i].score;
+				genome.fitness = worlds[i].score * SCORE_FITNESS + tick / 60.0f;
+				playing[i] = false;
+				left--;
+			}
+		}
+	}
+	return made;
+}
+
+/*
+* Keeps the best tenth as they are and fills the rest of the population with children of tournament winners: each
+* weight from either parent, then a few weights nudged. Expects the population sorted best first.
+*/
+void Tetris::Simulation::Trainer::breed() {
+	int population = (int)genomes.size();
+	int elites = std::max(1, population / 10);
+	std::vector<Network> children(population - elites);
+	for (Network& child : children) {
+		const Genome& mother = tournament();
+		const Genome& father = tournament();
+		for (int w = 0; w < NETWORK_WEIGHTS; w++) {
+			child.weights[w] = (random() & 1) ? mother.network.weights[w] : father.network.weights[w];
+			if ((random() & 0xFFFF) < MUTATION_RATE * 0x10000) {
+				child.weights[w] += gaussian() * MUTATION_SIZE;
+			}
+		}
+	}
+	for (int i = elites; i < population; i++) {
+		genomes[i].network = children[i - elites];
+	}
+}
+
+/*
+* Picks the best of a few random genomes.
+*/
+const Tetris::Simulation::Trainer::Genome& Tetris::Simulation::Trainer::tournament() {
+	const Genome* best = nullptr;
+	for (int i = 0; i < TOURNAMENT; i++) {
+		const Genome& genome = genomes[random() % genomes.size()];
+		if (best == nullptr || genome.fitness > best->fitness) {
+			best = &genome;
+		}
+	}
+	return *best;
+}
+
+/*
+* Gets a random number from a xorshift generator.
+*/
+unsigned int Tetris::Simulation::Trainer::random() {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState;
+}
+
+/*
+* Gets a normally distributed random number with the Box-Muller transform.
+*/
+float Tetris::Simulation::Trainer::gaussian() {
+	float u = (random() + 1.0f) / 4294967296.0f;
+	float v = random() / 4294967296.0f;
+	return sqrtf(-2 * logf(u)) * cosf(6.2831853f * v);
+}
@@ -0,0 +1,35 @@
+// Tuning.cpp implements loading of the tuning constants
+
+#include <stdlib.h>
+#include <allegro5\allegro.h>
+#include "tuning.h"
+
+/*
+* Reads a float from the physics section of the config, keeping the current value if the key is missing.
+*/
+static void readValue(ALLEGRO_CONFIG* config, const char* key, float* value) {
+	const char* text = al_get_config_value(config, "physics", key);
+	if (text != nullptr) {
+		*value = (float)atof(text);
+	}
+}
+
+/*
+* Loads the values from the config file. Returns false if the file could not be read.
+*/
+bool Tetris::Utils::Tuning::load(const char* filename) {
+	ALLEGRO_CONFIG* config = al_load_config_file(filename);
+	if (config == nullptr) {
+		return false;
+	}
+	readValue(config, "gravity", &gravity);
+	readValue(config, "terminal_velocity", &terminalVelocity);
+	readValue(config, "wall_speed", &wallSpeed);
+	readValue(config, "small_boost", &smallBoost);
+	readValue(config, "big_boost", &bigBoost);
+	readValue(config, "big_boost_hold_time", &bigBoostHoldTime);
+	readValue(config, "wall_spacing", &wallSpacing);
+	readValue(config, "target_survival", &targetSurvival);
+	al_destroy_config(config);
+	return true;
+}
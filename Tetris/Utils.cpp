@@ -1,18 +1,123 @@
-// Utils.cpp implements the SoundManager utility class
+// Utils.cpp implements the SoundManager, ImageManager and FontManager utility classes
 #include <allegro5\allegro.h>
 #include <allegro5\allegro_audio.h>
 #include <allegro5\allegro_acodec.h>
+#include <allegro5\allegro_font.h>
+#include <allegro5\allegro_ttf.h>
+#include <allegro5\allegro_memfile.h>
+#include <stdlib.h>
+#include <vector>
 #include "utils.h"
+#include "allocation.h"
+
+/*
+* How far the colour of a pixel can be from the background's, as the sum of the channel differences, and still be
+* background. JPEG noise moves plain backgrounds by a few steps in each channel.
+*/
+static const int BACKGROUND_TOLERANCE = 48;
+
+/*
+* Pixels less opaque than this are left out of collision masks.
+*/
+static const int SOLID_ALPHA = 128;
+
+/*
+* Checks whether two pixels, as RGBA bytes, are close enough in colour to both be background.
+*/
+static bool sameColour(const unsigned char* a, const unsigned char* b) {
+	return abs(a[0] - b[0]) + abs(a[1] - b[1]) + abs(a[2] - b[2]) <= BACKGROUND_TOLERANCE;
+}
+
+/*
+* Makes the collision mask of a bitmap. Transparent pixels are clear. If keyBackground is set, so are the pixels of
+* the plain background around a sprite, found by flooding in from the pixels on the border that have the colour of
+* the top left pixel. That covers the corners of images without alpha such as JPEGs. A bitmap that can't be read
+* is solid everywhere, which is the same as testing its box.
+*/
+static void buildMask(ALLEGRO_BITMAP* bitmap, Tetris::Simulation::CollisionMask& mask, bool keyBackground) {
+	if (bitmap == NULL) {
+		mask.create(0, 0);
+		return;
+	}
+	int width = al_get_bitmap_width(bitmap);
+	int height = al_get_bitmap_height(bitmap);
+	mask.create(width, height);
+	ALLEGRO_LOCKED_REGION* region = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY);
+	if (region == NULL) {
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				mask.set(x, y);
+			}
+		}
+		return;
+	}
+	const unsigned char* pixels = (const unsigned char*)region->data;
+	std::vector<bool> clear((size_t)width * height, false);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			clear[(size_t)y * width + x] = pixels[y * region->pitch + x * 4 + 3] < SOLID_ALPHA;
+		}
+	}
+	if (keyBackground && width > 0 && height > 0) {
+		const unsigned char* background = pixels;
+		std::vector<bool> seen((size_t)width * height, false);
+		std::vector<int> pending;
+		for (int x = 0; x < width; x++) {
+			pending.push_back(x);
+			pending.push_back((height - 1) * width + x);
+		}
+		for (int y = 0; y < height; y++) {
+			pending.push_back(y * width);
+			pending.push_back(y * width + width - 1);
+		}
+		while (!pending.empty()) {
+			int index = pending.back();
+			pending.pop_back();
+			int x = index % width;
+			int y = index / width;
+			if (seen[index] || !sameColour(&pixels[y * region->pitch + x * 4], background)) {
+				continue;
+			}
+			seen[index] = true;
+			clear[index] = true;
+			if (x > 0) {
+				pending.push_back(index - 1);
+			}
+			if (x < width - 1) {
+				pending.push_back(index + 1);
+			}
+			if (y > 0) {
+				pending.push_back(index - width);
+			}
+			if (y < height - 1) {
+				pending.push_back(index + width);
+			}
+		}
+	}
+	al_unlock_bitmap(bitmap);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			if (!clear[(size_t)y * width + x]) {
+				mask.set(x, y);
+			}
+		}
+	}
+}
 
 // =========================Sound Manager==================================
 /*
 * Initilaises the sound manager and loads all the resources.
 */
 Tetris::Utils::SoundManager::SoundManager() {
+	MemoryScope scope(MEMORY_AUDIO);
 	al_reserve_samples(2);
-	gameMusic = al_load_sample("assets/sounds/gameMusic.ogg");
-	missionImpossible = al_load_sample("assets/sounds/Mission Impossible.ogg");
-	crash = al_load_sample("assets/sounds/crash.wav");
+	gameMusic = al_load_sample(getPath(GAME_MUSIC));
+	missionImpossible = al_load_sample(getPath(MISSION_IMPOSSIBLE));
+	crash = al_load_sample(getPath(CRASH));
+	for (int i = 0; i < 3; i++) {
+		started[i] = false;
+		looping[i] = false;
+	}
 }
 
 /*
@@ -28,21 +133,36 @@ Tetris::Utils::SoundManager::~SoundManager() {
 * Plays a sound file.
 */
 void Tetris::Utils::SoundManager::playSound(Tetris::Utils::SoundManager::SoundTrack sound, ALLEGRO_PLAYMODE mode, float volume) {
+	if (mode != ALLEGRO_PLAYMODE_ONCE) {
+		looping[sound] = true;
+		loopMode[sound] = mode;
+		loopVolume[sound] = volume;
+	}
+	bool played = false;
 	if (sound == GAME_MUSIC) {
-		al_play_sample(gameMusic, volume, 0.0, 1.0, mode, &gameMusicId);
+		played = al_play_sample(gameMusic, volume, 0.0, 1.0, mode, &gameMusicId);
 	}
 	else if (sound == MISSION_IMPOSSIBLE) {
-		al_play_sample(missionImpossible, volume, 0.0, 1.0, mode, &missionImpossibleId);
+		played = al_play_sample(missionImpossible, volume, 0.0, 1.0, mode, &missionImpossibleId);
 	}
 	else if (sound == CRASH) {
-		al_play_sample(crash, volume, 0.0, 1.0, mode, &crashId);
+		played = al_play_sample(crash, volume, 0.0, 1.0, mode, &crashId);
+	}
+	// The ID is only filled in when a sample starts playing.
+	if (played) {
+		started[sound] = true;
 	}
 }
 
 /*
-* Stops playing the sound. Usually for sound tracks that are played in a loop.
+* Stops playing the sound. Usually for sound tracks that are played in a loop. A sound that never started has no
+* ID to stop.
 */
 void Tetris::Utils::SoundManager::stopSound(Tetris::Utils::SoundManager::SoundTrack sound) {
+	looping[sound] = false;
+	if (!started[sound]) {
+		return;
+	}
 	if (sound == GAME_MUSIC) {
 		al_stop_sample(&gameMusicId);
 	}
@@ -54,14 +174,56 @@ void Tetris::Utils::SoundManager::stopSound(Tetris::Utils::SoundManager::SoundTr
 	}
 }
 
+/*
+* Replaces the sample of a sound and frees the old one. A looping sound is restarted with the new sample.
+*/
+void Tetris::Utils::SoundManager::replaceSound(Tetris::Utils::SoundManager::SoundTrack sound, ALLEGRO_SAMPLE* sample) {
+	bool wasLooping = looping[sound];
+	stopSound(sound);
+	if (sound == GAME_MUSIC) {
+		al_destroy_sample(gameMusic);
+		gameMusic = sample;
+	}
+	else if (sound == MISSION_IMPOSSIBLE) {
+		al_destroy_sample(missionImpossible);
+		missionImpossible = sample;
+	}
+	else if (sound == CRASH) {
+		al_destroy_sample(crash);
+		crash = sample;
+	}
+	if (wasLooping) {
+		playSound(sound, loopMode[sound], loopVolume[sound]);
+	}
+}
+
+/*
+* Gets the file the sound is loaded from.
+*/
+const char* Tetris::Utils::SoundManager::getPath(Tetris::Utils::SoundManager::SoundTrack sound) {
+	switch (sound) {
+	case GAME_MUSIC:
+		return "assets/sounds/gameMusic.ogg";
+	case MISSION_IMPOSSIBLE:
+		return "assets/sounds/Mission Impossible.ogg";
+	case CRASH:
+		return "assets/sounds/crash.wav";
+	default:
+		return NULL;
+	}
+}
+
 // ===================ImageManager============================
 /*
 * Initialises the image manager and loads all the resources.
 */
 Tetris::Utils::ImageManager::ImageManager() {
-	gameMusic = al_load_bitmap("assets/images/gameMusic.jpg");
-	Tetris = al_load_bitmap("assets/images/Tetris.jpg");
-	wall = al_load_bitmap("assets/images/wall.jpg");
+	MemoryScope scope(MEMORY_IMAGES);
+	gameMusic = al_load_bitmap(getPath(GAMEMUSIC));
+	Tetris = al_load_bitmap(getPath(TETRIS));
+	wall = al_load_bitmap(getPath(WALL));
+	buildMask(Tetris, masks[TETRIS], true);
+	buildMask(wall, masks[WALL], false);
 }
 
 /*
@@ -90,4 +252,152 @@ ALLEGRO_BITMAP* Tetris::Utils::ImageManager::getImage(Tetris::Utils::ImageManage
 	default:
 		return NULL;
 	}
+}
+
+/*
+* Replaces the bitmap associated with the enum and returns the old one.
+*/
+ALLEGRO_BITMAP* Tetris::Utils::ImageManager::replaceImage(Tetris::Utils::ImageManager::Image image, ALLEGRO_BITMAP* bitmap) {
+	ALLEGRO_BITMAP* old = NULL;
+	switch (image) {
+	case GAMEMUSIC:
+		old = gameMusic;
+		gameMusic = bitmap;
+		break;
+	case TETRIS:
+		old = Tetris;
+		Tetris = bitmap;
+		break;
+	case WALL:
+		old = wall;
+		wall = bitmap;
+		break;
+	}
+	if (image != GAMEMUSIC) {
+		// Only Tetris is a sprite on a plain background; the wall fills its image.
+		MemoryScope scope(MEMORY_IMAGES);
+		buildMask(bitmap, masks[image], image == TETRIS);
+	}
+	return old;
+}
+
+/*
+* Gets the collision mask of the image. The background's is left empty since nothing collides with it.
+*/
+const Tetris::Simulation::CollisionMask& Tetris::Utils::ImageManager::getMask(Tetris::Utils::ImageManager::Image image) {
+	return masks[image];
+}
+
+/*
+* Gets the file the image is loaded from.
+*/
+const char* Tetris::Utils::ImageManager::getPath(Tetris::Utils::ImageManager::Image image) {
+	switch (image) {
+	case GAMEMUSIC:
+		return "assets/images/gameMusic.jpg";
+	case TETRIS:
+		return "assets/images/Tetris.jpg";
+	case WALL:
+		return "assets/images/wall.jpg";
+	default:
+		return NULL;
+	}
+}
+
+// ===================FontManager============================
+/*
+* Every character the Label, Button and InformationBox widgets can display (printable ASCII).
+*/
+static const char* PREBAKED_GLYPHS =
+	" !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~";
+
+/*
+* Reads the font file into memory and creates a font for each size used by the game.
+*/
+Tetris::Utils::FontManager::FontManager() : fontData(nullptr), fontDataSize(0) {
+	MemoryScope scope(MEMORY_FONTS);
+	ALLEGRO_FILE* file = al_fopen("assets/fonts/arial.ttf", "rb");
+	if (file != nullptr) {
+		fontDataSize = al_fsize(file);
+		if (fontDataSize > 0) {
+			fontData = new char[(size_t)fontDataSize];
+			if (al_fread(file, fontData, (size_t)fontDataSize) != (size_t)fontDataSize) {
+				delete[] fontData;
+				fontData = nullptr;
+				fontDataSize = 0;
+			}
+		}
+		al_fclose(file);
+	}
+	title = loadFont(72);
+	normal = loadFont(20);
+}
+
+/*
+* Frees the fonts and the font file data. The fonts read from the data so they have to go first.
+*/
+Tetris::Utils::FontManager::~FontManager() {
+	if (title != nullptr) {
+		al_destroy_font(title);
+	}
+	if (normal != nullptr) {
+		al_destroy_font(normal);
+	}
+	delete[] fontData;
+}
+
+/*
+* Creates a font of the given size from the in-memory font file. The memfile is owned by the font and closed
+* when the font is destroyed.
+*/
+ALLEGRO_FONT* Tetris::Utils::FontManager::loadFont(int size) {
+	if (fontData == nullptr) {
+		return nullptr;
+	}
+	ALLEGRO_FILE* file = al_open_memfile(fontData, fontDataSize, "rb");
+	if (file == nullptr) {
+		return nullptr;
+	}
+	ALLEGRO_FONT* font = al_load_ttf_font_f(file, "arial.ttf", size, 0);
+	if (font == nullptr) {
+		al_fclose(file);
+	}
+	return font;
+}
+
+/*
+* Gets the font associated with the enum.
+*/
+ALLEGRO_FONT* Tetris::Utils::FontManager::getFont(Tetris::Utils::FontManager::Font font) {
+	switch (font) {
+	case TITLE:
+		return title;
+	case NORMAL:
+		return normal;
+	default:
+		return NULL;
+	}
+}
+
+/*
+* Draws every prebaked glyph once into a scratch bitmap. The TTF addon renders glyphs into its cache pages on
+* first use, so doing it here moves that work out of the first frames.
+*/
+void Tetris::Utils::FontManager::prebake() {
+	MemoryScope scope(MEMORY_FONTS);
+	ALLEGRO_BITMAP* previousTarget = al_get_target_bitmap();
+	ALLEGRO_BITMAP* scratch = al_create_bitmap(1, 1);
+	if (scratch == nullptr) {
+		return;
+	}
+	al_set_target_bitmap(scratch);
+	ALLEGRO_COLOR white = al_map_rgb(255, 255, 255);
+	if (title != nullptr) {
+		al_draw_text(title, white, 0, 0, ALLEGRO_ALIGN_LEFT, PREBAKED_GLYPHS);
+	}
+	if (normal != nullptr) {
+		al_draw_text(normal, white, 0, 0, ALLEGRO_ALIGN_LEFT, PREBAKED_GLYPHS);
+	}
+	al_set_target_bitmap(previousTarget);
+	al_destroy_bitmap(scratch);
 }
\ No newline at end of file
@@ -0,0 +1,171 @@
+// VecEnv.cpp implements the batch of headless games that agents are trained on from Python
+
+#include <algorithm>
+#include "vecenv.h"
+
+static const float TICK_SECONDS = 1.0f / 60;		// The game's fixed tick.
+static const unsigned int SEED_STRIDE = 0x9E3779B9;	// Spreads the seeds of neighbouring games apart.
+
+/*
+* Creates the games and starts the pool threads, which sleep until the first job.
+*/
+Tetris::Simulation::VectorEnvironment::VectorEnvironment(const CollisionMaskSet* masks, int count, unsigned int seed, int threads, float playerWidth, float playerHeight,
+	float wallWidth, float wallHeight) : worlds(std::max(1, count)), ticks(std::max(1, count), 0), generation(0), pending(0), job(RESET),
+	actions(nullptr), observations(nullptr), rewards(nullptr), dones(nullptr) {
+	for (int i = 0; i < (int)worlds.size(); i++) {
+		worlds[i].create(masks, playerWidth, playerHeight, wallWidth, wallHeight, seed + i * SEED_STRIDE);
+		worlds[i].applyTuning(tuning);
+	}
+	if (threads <= 0) {
+		threads = std::max(1, (int)std::thread::hardware_concurrency());
+	}
+	threadCount = std::max(1, std::min(threads, (int)worlds.size() / MIN_GAMES_PER_THREAD));
+	for (int t = 1; t < threadCount; t++) {
+		this->threads.push_back(std::thread(&VectorEnvironment::work, this, t));
+	}
+}
+
+/*
+* Stops the threads.
+*/
+Tetris::Simulation::VectorEnvironment::~VectorEnvironment() {
+	runJob(STOP);
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+/*
+* Resets every game and writes their observations.
+*/
+void Tetris::Simulation::VectorEnvironment::reset(float* observations) {
+	this->observations = observations;
+	runJob(RESET);
+}
+
+/*
+* Steps every game with its action.
+*/
+void Tetris::Simulation::VectorEnvironment::step(const int* actions, float* observations, float* rewards, unsigned char* dones) {
+	this->actions = actions;
+	this->observations = observations;
+	this->rewards = rewards;
+	this->dones = dones;
+	runJob(STEP);
+}
+
+/*
+* Gets the number of games.
+*/
+int Tetris::Simulation::VectorEnvironment::getCount() const {
+	return (int)worlds.size();
+}
+
+/*
+* Gets the number of threads stepping the games, the calling thread included.
+*/
+int Tetris::Simulation::VectorEnvironment::getThreadCount() const {
+	return threadCount;
+}
+
+/*
+* Publishes the job by bumping the generation. Threads still spinning see it straight away; the lock makes sure a
+* thread about to sleep either sees it or is woken.
+*/
+void Tetris::Simulation::VectorEnvironment::runJob(Job job) {
+	this->job = job;
+	if (threadCount == 1) {
+		if (job != STOP) {
+			runShare(0);
+		}
+		return;
+	}
+	pending.store(threadCount - 1, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> guard(wakeLock);
+		generation.fetch_add(1, std::memory_order_release);
+	}
+	wake.notify_all();
+	if (job == STOP) {
+		return;
+	}
+	runShare(0);
+	while (pending.load(std::memory_order_acquire) != 0) {
+		std::this_thread::yield();
+	}
+}
+
+/*
+* Waits for each job, yielding for a while first since steps usually come back to back, then sleeping.
+*/
+void Tetris::Simulation::VectorEnvironment::work(int thread) {
+	unsigned int seen = 0;
+	while (true) {
+		int spins = 0;
+		while (generation.load(std::memory_order_acquire) == seen) {
+			if (++spins < SPIN_LIMIT) {
+				std::this_thread::yield();
+			}
+			else {
+				std::unique_lock<std::mutex> guard(wakeLock);
+				wake.wait(guard, [this, seen]() {
+					return generation.load(std::memory_order_acquire) != seen;
+				});
+			}
+		}
+		seen = generation.load(std::memory_order_acquire);
+		if (job == STOP) {
+			return;
+		}
+		runShare(thread);
+		pending.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+/*
+* Does the current job for a thread's share of the games. Each game's results only touch its own slots of the
+* buffers, so the threads never write to the same place.
+*/
+void Tetris::Simulation::VectorEnvironment::runShare(int thread) {
+	int count = (int)worlds.size();
+	int begin = (int)((long long)count * thread / threadCount);
+	int end = (int)((long long)count * (thread + 1) / threadCount);
+	for (int i = begin; i < end; i++) {
+		World& world = worlds[i];
+		if (job == RESET) {
+			world.reset();
+			ticks[i] = 0;
+		}
+		else {
+			if (actions[i] == SMALL_BOOST) {
+				world.boost(tuning.smallBoost);
+			}
+			else if (actions[i] == BIG_BOOST) {
+				world.boost(tuning.bigBoost);
+			}
+			StepResult result = world.step(TICK_SECONDS);
+			ticks[i]++;
+			float reward = 0;
+			unsigned char done = ENV_RUNNING;
+			if (result == CRASHED_FLOOR || result == CRASHED_WALL) {
+				reward = -1;
+				done = ENV_CRASHED;
+			}
+			else {
+				if (result == SCORED) {
+					reward = 1;
+				}
+				if (ticks[i] >= ENV_MAX_TICKS) {
+					done = ENV_TIME_LIMIT;
+				}
+			}
+			rewards[i] = reward;
+			dones[i] = done;
+			if (done != ENV_RUNNING) {
+				world.reset();
+				ticks[i] = 0;
+			}
+		}
+		readInputs(world, 0, observations + i * ENV_OBSERVATIONS);
+	}
+}
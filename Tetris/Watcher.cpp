@@ -0,0 +1,176 @@
+// Watcher.cpp implements the AssetWatcher class
+
+#include <chrono>
+#include <allegro5\allegro.h>
+#include <allegro5\allegro_audio.h>
+#include "watcher.h"
+#include "allocation.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+/*
+* Gets the modification time of a file, or 0 if it doesn't exist.
+*/
+static time_t modifiedTime(const std::string& path) {
+	ALLEGRO_FS_ENTRY* entry = al_create_fs_entry(path.c_str());
+	if (entry == nullptr) {
+		return 0;
+	}
+	time_t modified = al_fs_entry_exists(entry) ? al_get_fs_entry_mtime(entry) : 0;
+	al_destroy_fs_entry(entry);
+	return modified;
+}
+
+/*
+* Creates a watcher that isn't watching anything yet.
+*/
+Tetris::Utils::AssetWatcher::AssetWatcher() : running(false), notifyFd(-1) {
+#ifdef __linux__
+	notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+/*
+* Stops the watcher thread and frees reloads that were never taken.
+*/
+Tetris::Utils::AssetWatcher::~AssetWatcher() {
+	stop();
+	for (Reload& reload : pending) {
+		if (reload.image != nullptr) {
+			al_destroy_bitmap(reload.image);
+		}
+		if (reload.sample != nullptr) {
+			al_destroy_sample(reload.sample);
+		}
+	}
+#ifdef __linux__
+	if (notifyFd >= 0) {
+		close(notifyFd);
+	}
+#endif
+}
+
+/*
+* Adds a file to be watched. Must be called before start().
+*/
+void Tetris::Utils::AssetWatcher::watch(Tetris::Utils::AssetWatcher::Kind kind, int id, const char* path) {
+	Entry entry;
+	entry.kind = kind;
+	entry.id = id;
+	entry.path = path;
+	entry.modified = modifiedTime(entry.path);
+	entries.push_back(entry);
+#ifdef __linux__
+	if (notifyFd >= 0) {
+		// Editors often save by renaming a new file over the old one, so watch the directory rather than the file.
+		std::string::size_type slash = entry.path.find_last_of('/');
+		std::string directory = slash == std::string::npos ? "." : entry.path.substr(0, slash);
+		inotify_add_watch(notifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	}
+#endif
+}
+
+/*
+* Starts the watcher thread.
+*/
+void Tetris::Utils::AssetWatcher::start() {
+	if (running) {
+		return;
+	}
+	running = true;
+	thread = std::thread(&Tetris::Utils::AssetWatcher::run, this);
+}
+
+/*
+* Stops the watcher thread.
+*/
+void Tetris::Utils::AssetWatcher::stop() {
+	running = false;
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+/*
+* Moves the reloads completed since the last call into reloads without blocking.
+*/
+bool Tetris::Utils::AssetWatcher::takeReloads(std::vector<Tetris::Utils::AssetWatcher::Reload>& reloads) {
+	std::unique_lock<std::mutex> lock(pendingLock, std::try_to_lock);
+	if (!lock.owns_lock() || pending.empty()) {
+		return false;
+	}
+	reloads.swap(pending);
+	return true;
+}
+
+/*
+* The body of the watcher thread. Every file whose modification time changed is loaded here so that the game
+* loop only has to swap pointers.
+*/
+void Tetris::Utils::AssetWatcher::run() {
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+	while (running) {
+		waitForChange(0.25);
+		for (Entry& entry : entries) {
+			time_t modified = modifiedTime(entry.path);
+			if (modified == 0 || modified == entry.modified) {
+				continue;
+			}
+			Reload reload;
+			if (load(entry, reload)) {
+				entry.modified = modified;
+				std::lock_guard<std::mutex> lock(pendingLock);
+				pending.push_back(reload);
+			}
+		}
+	}
+}
+
+/*
+* Blocks until a watched directory changes or the timeout passes. Uses inotify on Linux and plain polling
+* elsewhere.
+*/
+void Tetris::Utils::AssetWatcher::waitForChange(double timeout) {
+#ifdef __linux__
+	if (notifyFd >= 0) {
+		pollfd descriptor;
+		descriptor.fd = notifyFd;
+		descriptor.events = POLLIN;
+		if (poll(&descriptor, 1, (int)(timeout * 1000)) > 0) {
+			// The events only wake us up - the modification times decide what gets reloaded.
+			char buffer[4096];
+			while (read(notifyFd, buffer, sizeof(buffer)) > 0) {
+			}
+		}
+		return;
+	}
+#endif
+	std::this_thread::sleep_for(std::chrono::milliseconds((int)(timeout * 1000)));
+}
+
+/*
+* Loads the file of the entry. Returns false if it couldn't be loaded, e.g. because it is still being written.
+*/
+bool Tetris::Utils::AssetWatcher::load(Tetris::Utils::AssetWatcher::Entry& entry, Tetris::Utils::AssetWatcher::Reload& reload) {
+	reload.kind = entry.kind;
+	reload.id = entry.id;
+	reload.image = nullptr;
+	reload.sample = nullptr;
+	MemoryScope scope(entry.kind == SOUND ? MEMORY_AUDIO : MEMORY_IMAGES);
+	switch (entry.kind) {
+	case TUNING:
+		return reload.tuning.load(entry.path.c_str());
+	case IMAGE:
+		reload.image = al_load_bitmap(entry.path.c_str());
+		return reload.image != nullptr;
+	case SOUND:
+		reload.sample = al_load_sample(entry.path.c_str());
+		return reload.sample != nullptr;
+	default:
+		return false;
+	}
+}
@@ -0,0 +1,407 @@
+// World.cpp implements the component store and the systems that update the game objects
+
+#include <math.h>
+#include "world.h"
+
+/*
+* Where each wall starts and which of its rows is left open.
+*/
+static const float WALL_START_X[Tetris::Simulation::WALL_COUNT] = { 480, 980, 1460 };
+static const int WALL_START_GAP[Tetris::Simulation::WALL_COUNT] = { 1, 2, 3 };
+
+/*
+* The images the player and the walls are drawn with. Matches Tetris::Utils::ImageManager::Image.
+*/
+static const int PLAYER_IMAGE = 1;
+static const int WALL_IMAGE = 2;
+
+/*
+* The components of a player that is still flying. A crash takes away all but POSITION, RENDERABLE and PLAYER, so
+* the systems leave it where it crashed.
+*/
+static const unsigned int FLYING_PLAYER = Tetris::Simulation::POSITION | Tetris::Simulation::VELOCITY | Tetris::Simulation::GRAVITY |
+	Tetris::Simulation::COLLIDER | Tetris::Simulation::RENDERABLE | Tetris::Simulation::PLAYER;
+static const unsigned int CRASHED_PLAYER = Tetris::Simulation::POSITION | Tetris::Simulation::RENDERABLE | Tetris::Simulation::PLAYER;
+
+/*
+* Gets the pixel a position falls in, which is where the masks are lined up. A Fixed is rounded down from its raw
+* value, since converting it to a float first loses the fraction once the value needs more than 24 bits.
+*/
+static int toPixel(float value) {
+	return (int)floorf(value);
+}
+
+static int toPixel(Tetris::Simulation::Fixed value) {
+	// An arithmetic shift, so negative values round down too.
+	return value.raw >> Tetris::Simulation::Fixed::FRACTION_BITS;
+}
+
+/*
+* Checks whether a mask was made from an image of the collider's size. If not, the image has been swapped without
+* its mask or the collider wasn't sized from an image, and the box is all there is to go on.
+*/
+template <typename Number>
+static bool fitsMask(const Tetris::Simulation::CollisionMask& mask, Number width, Number height) {
+	return mask.getWidth() == toPixel(width) && mask.getHeight() == toPixel(height);
+}
+
+/*
+* Creates the players and the walls with the sizes of their images and puts them at their start positions.
+*/
+template <typename Number>
+void Tetris::Simulation::BasicWorld<Number>::create(const CollisionMaskSet* masks, float playerWidth, float playerHeight, float wallWidth, float wallHeight, unsigned int seed, int playerCount) {
+	clear();
+	this->masks = masks;
+	// Xorshift gets stuck at zero.
+	randomState = seed != 0 ? seed : 1;
+	// Walls come first so they are drawn behind the player.
+	for (int i = 0; i < WALL_COUNT; i++) {
+		walls[i] = createEntity(POSITION | VELOCITY | COLLIDER | RENDERABLE | WALL, WALL_IMAGE);
+		width[walls[i]] = wallWidth;
+		height[walls[i]] = wallHeight;
+		gapPosition[walls[i]] = WALL_START_GAP[i];
+	}
+	if (playerCount < 1) {
+		playerCount = 1;
+	}
+	if (playerCount > MAX_PLAYERS) {
+		playerCount = MAX_PLAYERS;
+	}
+	this->playerCount = playerCount;
+	for (int i = 0; i < playerCount; i++) {
+		players[i] = createEntity(FLYING_PLAYER, PLAYER_IMAGE);
+		width[players[i]] = playerWidth;
+		height[players[i]] = playerHeight;
+	}
+	player = players[0];
+	applyTuning(Tetris::Utils::Tuning());
+	reset();
+}
+
+/*
+* Removes every entity.
+*/
+template <typename Number>
+void Tetris::Simulation::BasicWorld<Number>::clear() {
+	entityCount = 0;
+	player = -1;
+	playerCount = 0;
+	crashed = 0;
+	for (int i = 0; i < MAX_PLAYERS; i++) {
+		players[i] = -1;
+		finalScores[i] = 0;
+	}
+	for (int i = 0; i < WALL_COUNT; i++) {
+		walls[i] = -1;
+	}
+	front = 0;
+	back = WALL_COUNT - 1;
+	score = 0;
+	wallSpacing = Number(0);
+	gapHead = 0;
+	gapCount = 0;
+}
+
+/*
+* Adds an entity with the given components. Every field starts at zero so systems can run over it straight away.
+*/
+template <typename Number>
+int Tetris::Simulation::BasicWorld<Number>::createEntity(unsigned int components, int image) {
+	if (entityCount == MAX_ENTITIES) {
+		return -1;
+	}
+	int entity = entityCount++;
+	this->components[entity] = components;
+	x[entity] = Number(0);
+	y[entity] = Number(0);
+	dx[entity] = Number(0);
+	dy[entity] = Number(0);
+	gravity[entity] = Number(0);
+	terminalVelocity[entity] = Number(0);
+	width[entity] = Number(0);
+	height[entity] = Number(0);
+	this->image[entity] = image;
+	gapPosition[entity] = 0;
+	return entity;
+}
+
+/*
+* Puts the players and the walls back at their start positions and clears the score.
+*/
+template <typename Number>
+void Tetris::Simulation::BasicWorld<Number>::reset() {
+	for (int i = 0; i < playerCount; i++) {
+		components[players[i]] = FLYING_PLAYER;
+		x[players[i]] = PLAYER_START_X;
+		y[players[i]] = PLAYER_START_Y;
+		dy[players[i]] = Number(0);
+		finalScores[i] = 0;
+	}
+	crashed = 0;
+	for (int i = 0; i < WALL_COUNT; i++) {
+		x[walls[i]] = WALL_START_X[i];
+		y[walls[i]] = TOP;
+	}
+	front = 0;
+	back = WALL_COUNT - 1;
+	score = 0;
+	// Planned gaps followed on from where the last game ended, so start planning again from the start gaps.
+	gapHead = 0;
+	gapCount = 0;
+}
+
+/*
+* Sets the gravity of the player, the speed of the walls and the spacing between them.
+*/
+template <typename Number>
+void Tetris::Simulation::BasicWorld<Number>::applyTuning(const Tetris::Utils::Tuning& tuning) {
+	for (int i = 0; i < playerCount; i++) {
+		gravity[players[i]] = tuning.gravity;
+		terminalVelocity[players[i]] = tuning.terminalVelocity;
+	}
+	for (int i = 0; i < WALL_COUNT; i++) {
+		dx[walls[i]] = tuning.wallSpeed;
+	}
+	wallSpacing = tuning.wallSpacing;
+}
+
+/*
+* Sets the collider size of every entity drawn with the given image.
+*/
+template <typename Number>
+void Tetris::Simulation::BasicWorld<Number>::setImageSize(int image, float width, float height) {
+	for (int i = 0; i < entityCount; i++) {
+		if ((components[i] & (COLLIDER | RENDERABLE)) == (COLLIDER | RENDERABLE) && this->image[i] == image) {
+			this->width[i] = width;
+			this->height[i] = height;
+		}
+	}
+}
+
+/*
+* Gives a player a vertical velocity, unless it has crashed.
+*/
+template <typename Number>
+void Tetris::Simulation::BasicWorld<Number>::boost(float velocity, int slot) {
+	if (!hasCrashed(slot)) {
+		dy[players[slot]] = velocity;
+	}
+}
+
+/*
+* Simulated AI to decide whether the robot should move or not.
+*/
+template <typename Number>
+void Tetris::Simulation::BasicWorld<Number>::demoMove(const Tetris::Utils::Tuning& tuning, int slot) {
+	int player = players[slot];
+	int wall = walls[front];
+	Number gapY = Number(TOP) + Number(ROW_HEIGHT) * Number(gapPosition[wall]);	// The y position of the gap.
+	if (y[player] < gapY) {
+		// Tetris is above the gap position - Let gravity pull him down
+	}
+	else if (y[player] > gapY + height[wall]) {
+		// Tetris is below the gap position
+		boost(tuning.bigBoost, slot);
+	}
+	else {
+		// Tetris is line up in between the gap - Do little jump when he gets to a certain y coordinate just above the wall.
+		if (y[player] + height[player] > gapY + height[wall] - Number(10)) {
+			boost(tuning.smallBoost, slot);
+		}
+	}
+}
+
+/*
+* Gets a player's score: the walls passed so far, or before it crashed.
+*/
+template <typename Number>
+int Tetris::Simulation::BasicWorld<Number>::getScore(int slot) const {
+	return hasCrashed(slot) ? finalScores[slot] : score;
+}
+
+/*
+* Gets the entity of the wall in front of the player.
+*/
+template <typename Number>
+int Tetris::Simulation::BasicWorld<Number>::getFrontWall() {
+	return walls[front];
+}
+
+/*
+* Runs the systems in order: gravity, movement, then the players' collisions. The systems and the wall rotation run
+* once however many players there are; only the collision checks are per player. A crashed player loses its
+* VELOCITY, GRAVITY and COLLIDER so nothing moves or checks it again until the world is reset. A wall that has gone
+* off the left of the screen is moved behind the back wall with a new gap, which scores a point for everyone still
+* flying.
+*/
+template <typename Number>
+Tetris::Simulation::StepResult Tetris::Simulation::BasicWorld<Number>::step(float delta) {
+	Number time = Number(delta);
+	applyGravity(*this, time);
+	integrate(*this, time);
+
+	StepResult crash = NOTHING;
+	for (int p = 0; p < playerCount; p++) {
+		if (hasCrashed(p)) {
+			continue;
+		}
+		int player = players[p];
+		if (y[player] < Number(TOP)) {
+			y[player] = Number(TOP);
+			dy[player] = Number(0);
+		}
+		StepResult result = NOTHING;
+		if (y[player] > Number(BOTTOM) - height[player]) {
+			result = CRASHED_FLOOR;
+		}
+		else {
+			for (int i = 0; i < WALL_COUNT; i++) {
+				if (collidesWithWall(walls[i], x[player], y[player], width[player], height[player], image[player])) {
+					result = CRASHED_WALL;
+					break;
+				}
+			}
+		}
+		if (result != NOTHING) {
+			crashed |= 1u << p;
+			finalScores[p] = score;
+			components[player] = CRASHED_PLAYER;
+			crash = result;
+		}
+	}
+	if (crashed == (1u << playerCount) - 1) {
+		return crash;
+	}
+
+	int wall = walls[front];
+	if (x[wall] < -width[wall]) {
+		score++;
+		x[wall] = x[walls[back]] + Number(3) * width[wall] + wallSpacing;
+		gapPosition[wall] = nextGap();
+		back = front;
+		front = (front + 1) % WALL_COUNT;
+		return SCORED;
+	}
+	return NOTHING;
+}
+
+/*
+* Checks whether the rectangle touches any segment of the wall entity. Touching edges count as a collision. The
+* boxes are the broad phase: only segments they say touch are tested with the masks, at whole pixel positions.
+*/
+template <typename Number>
+bool Tetris::Simulation::BasicWorld<Number>::collidesWithWall(int wall, Number x, Number y, Number width, Number height, int image) {
+	Number left = this->x[wall];
+	Number right = left + this->width[wall];
+	if (x > right || x + width < left) {
+		return false;
+	}
+	const CollisionMask* mask = masks != nullptr ? masks->get(image) : nullptr;
+	const CollisionMask* wallMask = masks != nullptr ? masks->get(this->image[wall]) : nullptr;
+	bool precise = mask != nullptr && wallMask != nullptr && fitsMask(*mask, width, height) && fitsMask(*wallMask, this->width[wall], this->height[wall]);
+	for (int row = 0; row < WALL_ROWS; row++) {
+		if (row == gapPosition[wall]) {
+			continue;
+		}
+		Number top = Number(TOP) + Number(ROW_HEIGHT) * Number(row);
+		if (y <= top + this->height[wall] && y + height >= top) {
+			if (!precise || CollisionMask::overlap(*mask, toPixel(x), toPixel(y), *wallMask, toPixel(left), toPixel(top))) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/*
+* Gets a random number from 0 up to but not including the limit, using a xorshift generator. Its state lives in
+* the world so restoring a snapshot replays the same gaps.
+*/
+template <typename Number>
+int Tetris::Simulation::BasicWorld<Number>::random(int limit) {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return (int)(randomState % limit);
+}
+
+/*
+* Adds planned gaps for the walls to come. Returns false, adding none, if there isn't room for them all.
+*/
+template <typename Number>
+bool Tetris::Simulation::BasicWorld<Number>::queueGaps(const int* gaps, int count) {
+	if (gapCount + count > GAP_QUEUE) {
+		return false;
+	}
+	for (int i = 0; i < count; i++) {
+		upcomingGaps[(gapHead + gapCount + i) % GAP_QUEUE] = gaps[i];
+	}
+	gapCount += count;
+	return true;
+}
+
+/*
+* Gets the gap the next planned gap has to be reachable from: the last one queued, or the back wall's.
+*/
+template <typename Number>
+int Tetris::Simulation::BasicWorld<Number>::getLastGap() const {
+	if (gapCount > 0) {
+		return upcomingGaps[(gapHead + gapCount - 1) % GAP_QUEUE];
+	}
+	return gapPosition[walls[back]];
+}
+
+/*
+* Takes the next planned gap. Without a LevelGenerator feeding the world, as in headless runs, gaps are picked at
+* random from the world's own generator so they still replay from the seed.
+*/
+template <typename Number>
+int Tetris::Simulation::BasicWorld<Number>::nextGap() {
+	if (gapCount == 0) {
+		return random(GAP_ROWS);
+	}
+	int gap = upcomingGaps[gapHead];
+	gapHead = (gapHead + 1) % GAP_QUEUE;
+	gapCount--;
+	return gap;
+}
+
+/*
+* Applies gravity to the velocity of every entity with a GRAVITY component, up to its terminal velocity.
+*/
+template <typename Number>
+void Tetris::Simulation::applyGravity(Tetris::Simulation::BasicWorld<Number>& world, Number delta) {
+	for (int i = 0; i < world.entityCount; i++) {
+		if ((world.components[i] & (GRAVITY | VELOCITY)) != (GRAVITY | VELOCITY)) {
+			continue;
+		}
+		world.dy[i] += world.gravity[i] * delta;
+		if (world.dy[i] > world.terminalVelocity[i]) {
+			world.dy[i] = world.terminalVelocity[i];
+		}
+	}
+}
+
+/*
+* Moves every entity with a POSITION and VELOCITY by its velocity.
+*/
+template <typename Number>
+void Tetris::Simulation::integrate(Tetris::Simulation::BasicWorld<Number>& world, Number delta) {
+	for (int i = 0; i < world.entityCount; i++) {
+		if ((world.components[i] & (POSITION | VELOCITY)) != (POSITION | VELOCITY)) {
+			continue;
+		}
+		world.x[i] += world.dx[i] * delta;
+		world.y[i] += world.dy[i] * delta;
+	}
+}
+
+/*
+* The worlds the game can be built with.
+*/
+template struct Tetris::Simulation::BasicWorld<float>;
+template struct Tetris::Simulation::BasicWorld<Tetris::Simulation::Fixed>;
+template void Tetris::Simulation::applyGravity<float>(Tetris::Simulation::BasicWorld<float>& world, float delta);
+template void Tetris::Simulation::applyGravity<Tetris::Simulation::Fixed>(Tetris::Simulation::BasicWorld<Tetris::Simulation::Fixed>& world, Tetris::Simulation::Fixed delta);
+template void Tetris::Simulation::integrate<float>(Tetris::Simulation::BasicWorld<float>& world, float delta);
+template void Tetris::Simulation::integrate<Tetris::Simulation::Fixed>(Tetris::Simulation::BasicWorld<Tetris::Simulation::Fixed>& world, Tetris::Simulation::Fixed delta);
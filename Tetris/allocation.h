@@ -0,0 +1,84 @@
+// allocation.h contains the heap allocation counters, kept per subsystem
+
+#ifndef ALLOCATION_H
+#define ALLOCATION_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+namespace Tetris {
+	namespace Utils {
+		/*
+		* The subsystems heap memory is counted against. Allocations are tagged with the tag current on the thread
+		* that makes them, including the ones Allegro makes for bitmaps, samples and fonts.
+		*/
+		enum MemoryTag {
+			MEMORY_GENERAL,					// Anything not made under another tag.
+			MEMORY_AUDIO,					// Decoded samples.
+			MEMORY_IMAGES,					// Bitmaps and their collision masks.
+			MEMORY_FONTS,					// The font file and glyph caches.
+			MEMORY_UI,						// Widgets and particle effects.
+			MEMORY_SIMULATION,				// Worlds, history, level planning and training.
+			MEMORY_TAG_COUNT
+		};
+
+		/*
+		* What a tag, or every tag together, has allocated.
+		*/
+		struct MemoryStats {
+			long long bytes;				// Bytes allocated and not yet freed.
+			long long peakBytes;			// The most bytes allocated at once.
+			long long allocations;			// Allocations made in total.
+		};
+
+		/*
+		* Tags the allocations the current thread makes while the scope lasts, then puts back the tag from before.
+		*/
+		class MemoryScope {
+		public:
+			MemoryScope(MemoryTag tag);
+			~MemoryScope();
+		private:
+			MemoryTag previous;				// The tag to put back.
+		};
+
+		/*
+		* Gets the number of allocations the calling thread has made through operator new since it started. Used by
+		* the game loop's thread to check that its tick and draw path doesn't allocate once the game is running;
+		* other threads' allocations never show up in it.
+		*/
+		long long getAllocationCount();
+		/*
+		* Sets the tag of the current thread's allocations and returns the one it replaces.
+		*/
+		MemoryTag setMemoryTag(MemoryTag tag);
+		/*
+		* Allocates memory counted against a tag, for allocators that get their memory in large blocks. Returns null
+		* if there isn't enough. Freed with release().
+		*/
+		void* allocate(size_t size, MemoryTag tag);
+		/*
+		* Frees memory from allocate(). Null is ignored.
+		*/
+		void release(void* memory);
+		/*
+		* Gets what a tag has allocated, or every tag together for MEMORY_TAG_COUNT.
+		*/
+		MemoryStats getMemoryStats(MemoryTag tag);
+		/*
+		* Gets the name of a tag, as used in reports and metrics.
+		*/
+		const char* getMemoryTagName(MemoryTag tag);
+		/*
+		* Routes Allegro's allocations through the counters. Has to be called before Allegro is initialised, since
+		* memory Allegro allocated before can't be freed through them.
+		*/
+		void trackAllegroMemory();
+		/*
+		* Prints the memory used by each tag. If the budget in bytes isn't 0, a peak over it is reported as a warning.
+		*/
+		void printMemoryReport(FILE* out, long long budget);
+	}
+}
+
+#endif
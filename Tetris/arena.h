@@ -0,0 +1,110 @@
+// arena.h contains the arena allocator that owns the objects of a scene
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdlib.h>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include "allocation.h"
+
+namespace Tetris {
+	namespace Utils {
+		/*
+		* Owns the objects of one scene in a single block of memory. Objects are placed one after the other as they
+		* are created and destroyed together, in reverse order, when the arena is cleared. The records used to call
+		* their destructors are stored at the other end of the block, so the arena never allocates after it is
+		* created.
+		*/
+		class Arena {
+		public:
+			/*
+			* Creates an arena that can hold the given number of bytes, including one destructor record per object.
+			* Scenes are made of widgets, so the block is counted as UI memory.
+			*/
+			Arena(size_t capacity) : capacity(capacity), used(0), objects(0) {
+				memory = (char*)allocate(capacity, MEMORY_UI);
+				if (memory == nullptr) {
+					throw "Could not allocate the scene arena";
+				}
+			}
+			/*
+			* Destroys the objects and frees the block.
+			*/
+			~Arena() {
+				clear();
+				release(memory);
+			}
+			/*
+			* Constructs an object in the arena. The arena owns it and destroys it when cleared.
+			*/
+			template <typename T, typename... Args>
+			T* create(Args&&... args) {
+				size_t alignment = std::alignment_of<T>::value;
+				size_t start = (used + alignment - 1) / alignment * alignment;
+				size_t recordBytes = (objects + 1) * sizeof(Record);
+				size_t available = (char*)records() - memory;
+				if (recordBytes > available || start + sizeof(T) > available - recordBytes) {
+					throw "The scene arena is full";
+				}
+				T* object = new (memory + start) T(std::forward<Args>(args)...);
+				Record* record = records() - (objects + 1);
+				record->object = object;
+				record->destroy = &destroy<T>;
+				objects++;
+				used = start + sizeof(T);
+				return object;
+			}
+			/*
+			* Destroys every object in the reverse order they were created and makes the memory available again.
+			*/
+			void clear() {
+				while (objects > 0) {
+					Record* record = records() - objects;
+					record->destroy(record->object);
+					objects--;
+				}
+				used = 0;
+			}
+			/*
+			* Gets the number of bytes taken up by objects.
+			*/
+			size_t getUsed() {
+				return used;
+			}
+		private:
+			/*
+			* How to destroy an object in the arena.
+			*/
+			struct Record {
+				void* object;
+				void (*destroy)(void* object);
+			};
+
+			/*
+			* Calls the destructor of an object of type T.
+			*/
+			template <typename T>
+			static void destroy(void* object) {
+				static_cast<T*>(object)->~T();
+			}
+			/*
+			* Gets the end of the record area. Records are stored backwards from the end of the block.
+			*/
+			Record* records() {
+				return (Record*)(memory + (capacity / sizeof(Record)) * sizeof(Record));
+			}
+
+			char* memory;			// The block of memory holding the objects and records.
+			size_t capacity;		// The size of the block in bytes.
+			size_t used;			// Bytes taken up by objects from the start of the block.
+			size_t objects;			// The number of objects in the arena.
+
+			Arena(const Arena&);
+			Arena& operator=(const Arena&);
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,88 @@
+// benchmark.h contains the benchmarks that measure how fast frames are drawn, collisions are tested and training games are stepped
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <vector>
+#include "renderer.h"
+#include "world.h"
+#include "vecenv.h"
+
+namespace Tetris {
+	/*
+	* Draws recorded game states to a memory bitmap as fast as it can and reports the frame rate and what each part
+	* of a frame costs. It never creates a display, so it runs on machines without a window system or GPU.
+	*/
+	class RenderBenchmark {
+	public:
+		/*
+		* Prepares to draw the given number of frames.
+		*/
+		RenderBenchmark(int frames);
+		/*
+		* Records the game states, draws them and prints the results. The last frame is saved to goldenImage if it
+		* isn't null, to compare against a known good image. Returns 0 on success.
+		*/
+		int run(const char* goldenImage);
+	private:
+		/*
+		* Plays the demo with a fixed seed to get the game states to draw, with some menu frames first.
+		*/
+		void record(float playerWidth, float playerHeight, float wallWidth, float wallHeight);
+
+		static const unsigned int SEED = 1;		// Seeds the recorded game so every run draws the same frames.
+		int frames;								// The number of frames to draw.
+		std::vector<FrameSnapshot> snapshots;	// The recorded game states.
+		int menuFrames;							// How many of the snapshots show the menu.
+	};
+
+	/*
+	* Measures what testing collisions against the images' masks costs on top of testing their boxes, over the
+	* states of a recorded demo game. Like the render benchmark it only needs memory bitmaps.
+	*/
+	class CollisionBenchmark {
+	public:
+		/*
+		* Prepares to test the given number of ticks.
+		*/
+		CollisionBenchmark(int ticks);
+		/*
+		* Records the ticks, times the collision tests of every tick with boxes and then masks, and prints the
+		* results. Returns 0 on success.
+		*/
+		int run();
+	private:
+		/*
+		* Runs the collision tests of every recorded tick, the way World::step does, and returns how many hit.
+		*/
+		int testTicks();
+
+		static const unsigned int SEED = 1;		// Seeds the recorded game so every run tests the same ticks.
+		static const int REPEATS = 20;			// Times the ticks are tested, to get a measurable run.
+		int ticks;								// The number of ticks to test.
+		std::vector<Tetris::Simulation::World> worlds;	// The world at each recorded tick.
+	};
+
+	/*
+	* Steps a VectorEnvironment the way the Python module does, with the actions changing every step, and reports
+	* the environment steps per second. Needs no images.
+	*/
+	class EnvironmentBenchmark {
+	public:
+		/*
+		* Prepares to step the given number of games the given number of times.
+		*/
+		EnvironmentBenchmark(int steps, int games);
+		/*
+		* Steps the games and prints the results. Returns 0 on success.
+		*/
+		int run();
+	private:
+		static const unsigned int SEED = 1;		// Seeds the games so every run flies the same courses.
+
+		int steps;								// Times every game is stepped.
+		int games;								// Games stepped together.
+	};
+}
+
+#endif
@@ -0,0 +1,215 @@
+// broadcast.h contains the classes used to stream the game to spectators
+
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "net.h"
+#include "world.h"
+#include "concurrency.h"
+
+namespace Tetris {
+	namespace Net {
+		/*
+		* The state of the game at one tick, as much as a spectator needs to draw it.
+		*/
+		struct SpectatorFrame {
+			unsigned int tick;									// The tick number, starting at 1.
+			unsigned char playerCount;							// The number of players, 1 to MAX_PLAYERS.
+			unsigned char crashed;								// One bit per player that has crashed.
+			float playerY[Tetris::Simulation::MAX_PLAYERS];		// Position and speed of each player.
+			float playerDy[Tetris::Simulation::MAX_PLAYERS];
+			int finalScores[Tetris::Simulation::MAX_PLAYERS];	// The score each crashed player had when it crashed.
+			float wallX[Tetris::Simulation::WALL_COUNT];		// Position of each wall.
+			unsigned char gaps[Tetris::Simulation::WALL_COUNT];	// Gap row of each wall.
+			int score;											// The score.
+			unsigned char state;								// The InformationBox::State.
+		};
+
+		/*
+		* Copies what a spectator needs out of the world, every player included.
+		*/
+		void makeFrame(SpectatorFrame& frame, unsigned int tick, const Tetris::Simulation::World& world, int state);
+		/*
+		* Puts a received frame into a world created the same way as the game's. The world is created again with
+		* the frame's players if it has a different number.
+		*/
+		void applyFrame(const SpectatorFrame& frame, Tetris::Simulation::World& world);
+		/*
+		* Writes the frame as the fields that differ from the base frame, or every field if there is no base or the
+		* base has a different number of players. Returns the number of bytes written, at most MAX_ENCODED_FRAME.
+		*/
+		int encodeFrame(const SpectatorFrame& frame, const SpectatorFrame* base, unsigned char* out);
+		/*
+		* Reads the tick of the base frame an encoded frame was written against, or NO_BASE if it has none.
+		*/
+		unsigned int peekBase(const unsigned char* in, int size);
+		/*
+		* Reads a frame written by encodeFrame against the given base. Returns the number of bytes read, or -1 if the
+		* data is cut short or the base is missing.
+		*/
+		int decodeFrame(const unsigned char* in, int size, const SpectatorFrame* base, SpectatorFrame& frame);
+
+		const unsigned int NO_BASE = 0xFFFFFFFF;		// The base tick of a frame with every field written.
+		const int MAX_ENCODED_FRAME = 96;				// The most bytes an encoded frame takes.
+
+		/*
+		* The most recent frames, looked up by tick.
+		*/
+		class FrameHistory {
+		public:
+			static const int SIZE = 128;				// Frames kept, a little over two seconds.
+
+			/*
+			* Creates an empty history.
+			*/
+			FrameHistory();
+			/*
+			* Adds a frame, replacing the one SIZE ticks before it.
+			*/
+			void add(const SpectatorFrame& frame);
+			/*
+			* Finds the frame for the tick, or null if it isn't kept.
+			*/
+			const SpectatorFrame* find(unsigned int tick) const;
+		private:
+			SpectatorFrame frames[SIZE];				// Frames by tick modulo SIZE.
+		};
+
+		/*
+		* Streams the game to any number of spectators connected to a local port. The game loop hands each tick's
+		* frame over a lock-free queue and carries on. A server thread sends the frames to each spectator every
+		* BATCH_INTERVAL, several ticks to a packet, each written as the difference from the one before it. The
+		* first frame of a packet is written against the last frame the spectator acknowledged. Spectators that
+		* can't keep up are disconnected rather than held in memory.
+		*
+		* A packet is a 32 bit length and a frame count followed by the encoded frames. Spectators send back the
+		* 32 bit tick of the last frame they decoded.
+		*/
+		class SpectatorServer {
+		public:
+			/*
+			* Creates a server that isn't listening yet.
+			*/
+			SpectatorServer();
+			/*
+			* Stops the server.
+			*/
+			~SpectatorServer();
+			/*
+			* Starts listening on the port of 127.0.0.1. Returns false if the port couldn't be opened.
+			*/
+			bool start(int port);
+			/*
+			* Disconnects every spectator and stops the server thread.
+			*/
+			void stop();
+			/*
+			* Hands a frame to the server thread. Only called by the game loop. Never blocks; the frame is dropped if
+			* the server thread has fallen a whole queue behind.
+			*/
+			void publish(const SpectatorFrame& frame);
+			/*
+			* Gets the number of spectators connected.
+			*/
+			int getSpectatorCount();
+		private:
+			/*
+			* A connected spectator.
+			*/
+			struct Spectator {
+				Socket socket;
+				unsigned int acknowledged;			// The last tick the spectator decoded, or NO_BASE.
+				unsigned int sent;					// The last tick sent, or 0.
+				std::string pending;				// Bytes the socket hasn't taken yet.
+				char acks[4];						// A partly received acknowledgement.
+				int ackBytes;
+			};
+
+			static const int BATCH_INTERVAL = 50;		// Milliseconds between packets.
+			static const int MAX_PENDING = 64 * 1024;	// Unsent bytes allowed before a spectator is dropped.
+
+			/*
+			* The body of the server thread.
+			*/
+			void run();
+			/*
+			* Accepts every spectator waiting to connect.
+			*/
+			void acceptSpectators();
+			/*
+			* Reads acknowledgements from the spectator. Returns false if it disconnected.
+			*/
+			bool readAcks(Spectator& spectator);
+			/*
+			* Queues a packet of the frames the spectator hasn't been sent yet and sends what the socket will take.
+			* Returns false if the spectator disconnected or fell too far behind.
+			*/
+			bool sendFrames(Spectator& spectator);
+
+			Socket listener;								// The listening socket.
+			Tetris::Utils::SpscQueue<SpectatorFrame, 256> queue;	// Frames from the game loop.
+			FrameHistory history;							// Recent frames, owned by the server thread.
+			unsigned int latest;							// The newest tick in the history, or 0.
+			std::vector<Spectator> spectators;				// The connected spectators.
+			std::vector<unsigned char> packet;				// Storage for building packets.
+			std::thread thread;								// The server thread.
+			std::atomic<bool> running;						// Whether the server thread should keep going.
+			std::atomic<int> spectatorCount;				// The number of spectators connected.
+		};
+
+		/*
+		* A connection to a spectator server that decodes the frames it receives.
+		*/
+		class SpectatorConnection {
+		public:
+			/*
+			* Creates a connection that isn't connected yet.
+			*/
+			SpectatorConnection();
+			/*
+			* Disconnects.
+			*/
+			~SpectatorConnection();
+			/*
+			* Connects to the port of 127.0.0.1. Returns false if it couldn't.
+			*/
+			bool connect(int port);
+			/*
+			* Disconnects.
+			*/
+			void disconnect();
+			/*
+			* Reads and decodes whatever has arrived, acknowledging the last frame decoded. Never blocks. Returns false
+			* once the connection is lost.
+			*/
+			bool poll();
+			/*
+			* Gets the newest frame decoded, or null if there hasn't been one.
+			*/
+			const SpectatorFrame* getLatest();
+			/*
+			* Gets the number of frames decoded and bytes received so far.
+			*/
+			long long getFramesDecoded();
+			long long getBytesReceived();
+		private:
+			/*
+			* Decodes one complete packet. Returns false if it is malformed.
+			*/
+			bool decodePacket(const unsigned char* data, int size);
+
+			Socket socket;						// The connection, or INVALID.
+			std::vector<unsigned char> received;	// Bytes received but not decoded yet.
+			FrameHistory history;				// Frames decoded, used as the bases of later frames.
+			unsigned int latest;				// The newest tick decoded, or 0.
+			long long framesDecoded;			// Frames decoded so far.
+			long long bytesReceived;			// Bytes received so far.
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,103 @@
+// capture.h contains the declaration of the class that records gameplay video in the background
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdio.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <allegro5/allegro.h>
+#include "concurrency.h"
+
+namespace Tetris {
+	namespace Utils {
+		/*
+		* Records the frames drawn to a file. The drawing thread copies each frame into one of a pool of buffers
+		* allocated up front and queues it for an encoder thread, which writes the difference from the frame before
+		* and hands the buffer back. If every buffer is in use the frame is dropped, so capture never holds up the game.
+		*
+		* The file starts with the header "TCAP", a version, the width and the height, each a 32 bit little endian
+		* integer. Each frame then has its number and timestamp (a double), followed by runs that together cover
+		* every pixel: a count of pixels unchanged from the previous frame, a count of changed pixels and the changed
+		* pixels themselves, XORed with the previous frame. Pixels are 32 bit RGBA.
+		*/
+		class VideoCapture {
+		public:
+			/*
+			* Creates a capture of frames with the given size. Allocates the buffers.
+			*/
+			VideoCapture(int width, int height);
+			/*
+			* Stops capturing.
+			*/
+			~VideoCapture();
+			/*
+			* Opens the file and starts the encoder thread. Returns false if the file couldn't be opened.
+			*/
+			bool start(const char* path);
+			/*
+			* Writes the frames still queued, stops the encoder thread and closes the file.
+			*/
+			void stop();
+			/*
+			* Copies the bitmap into a free buffer and queues it for the encoder. A bitmap of another size is scaled to
+			* the capture's size. Only called by the thread that draws. Drops the frame if no buffer is free.
+			*/
+			void captureFrame(ALLEGRO_BITMAP* bitmap, double time);
+			/*
+			* Gets the number of frames queued, dropped and written.
+			*/
+			long long getFramesCaptured();
+			long long getFramesDropped();
+			long long getFramesWritten();
+		private:
+			static const int POOL_SIZE = 4;				// The number of frame buffers.
+
+			/*
+			* A frame buffer and when it was captured.
+			*/
+			struct Frame {
+				int buffer;
+				long long number;
+				double time;
+			};
+
+			/*
+			* The body of the encoder thread.
+			*/
+			void run();
+			/*
+			* Writes the frame as runs of unchanged and changed pixels and remembers it for the next frame.
+			*/
+			void encode(const Frame& frame);
+			/*
+			* Writes a 32 bit little endian integer.
+			*/
+			void writeInt(unsigned int value);
+			/*
+			* Writes changed pixels XORed with the previous frame.
+			*/
+			void writeChanges(const unsigned int* pixels, const unsigned int* last, int count);
+
+			int width;									// The size of the frames.
+			int height;
+			std::vector<unsigned int> buffers[POOL_SIZE];	// The frame buffers.
+			std::vector<unsigned int> previous;			// The last frame written, owned by the encoder thread.
+			std::vector<int> columns;					// The source column of each captured column, owned by the drawing thread.
+			int mappedWidth;							// The source width columns was worked out for, or 0.
+			unsigned char chunk[4096];					// Changed pixels waiting to be written, owned by the encoder thread.
+			SpscQueue<Frame, POOL_SIZE> filled;			// Frames waiting to be encoded.
+			SpscQueue<int, POOL_SIZE> available;		// Buffers ready to be filled.
+			int spare;									// A buffer taken by the drawing thread but not filled yet, or -1.
+			FILE* file;									// The file being written.
+			std::thread thread;							// The encoder thread.
+			std::atomic<bool> running;					// Whether the encoder thread should keep going.
+			std::atomic<long long> framesCaptured;		// Frames queued for the encoder.
+			std::atomic<long long> framesDropped;		// Frames dropped because no buffer was free.
+			std::atomic<long long> framesWritten;		// Frames written to the file.
+		};
+	}
+}
+
+#endif
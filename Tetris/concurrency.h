@@ -0,0 +1,100 @@
+// concurrency.h contains lock-free structures for handing data between threads
+
+#ifndef CONCURRENCY_H
+#define CONCURRENCY_H
+
+#include <atomic>
+
+namespace Tetris {
+	namespace Utils {
+		/*
+		* Hands the latest value from one writer thread to one reader thread without either ever waiting. The writer
+		* fills back() and publishes it, the reader acquires the most recently published value. Values published
+		* faster than the reader takes them are skipped.
+		*/
+		template <typename T>
+		class TripleBuffer {
+		public:
+			/*
+			* Creates the buffer with nothing published.
+			*/
+			TripleBuffer() : shared(1), writing(0), reading(2) {}
+			/*
+			* Gets the slot the writer fills before publishing.
+			*/
+			T& back() { return slots[writing]; }
+			/*
+			* Makes the back slot the latest value and gives the writer a free slot.
+			*/
+			void publish() { writing = shared.exchange(writing | FRESH) & INDEX; }
+			/*
+			* Takes the latest published value if there is one the reader hasn't seen. Returns false otherwise.
+			*/
+			bool acquire() {
+				if ((shared.load() & FRESH) == 0) {
+					return false;
+				}
+				reading = shared.exchange(reading) & INDEX;
+				return true;
+			}
+			/*
+			* Gets the value the reader last acquired.
+			*/
+			const T& front() { return slots[reading]; }
+		private:
+			static const int INDEX = 3;			// Mask for the slot index.
+			static const int FRESH = 4;			// Set when the shared slot hasn't been read yet.
+
+			T slots[3];							// The value being written, the latest value and the value being read.
+			std::atomic<int> shared;			// The slot in the middle, plus the FRESH flag.
+			int writing;						// The slot owned by the writer.
+			int reading;						// The slot owned by the reader.
+		};
+
+		/*
+		* A fixed size queue between one writer thread and one reader thread. Neither side ever waits: push fails when
+		* the queue is full and pop fails when it is empty.
+		*/
+		template <typename T, int CAPACITY>
+		class SpscQueue {
+		public:
+			/*
+			* Creates an empty queue.
+			*/
+			SpscQueue() : head(0), tail(0) {}
+			/*
+			* Adds a value to the back of the queue. Only called by the writer. Returns false if the queue is full.
+			*/
+			bool push(const T& value) {
+				int back = tail.load(std::memory_order_relaxed);
+				int next = (back + 1) % SLOTS;
+				if (next == head.load(std::memory_order_acquire)) {
+					return false;
+				}
+				slots[back] = value;
+				tail.store(next, std::memory_order_release);
+				return true;
+			}
+			/*
+			* Takes the value at the front of the queue. Only called by the reader. Returns false if the queue is empty.
+			*/
+			bool pop(T& value) {
+				int front = head.load(std::memory_order_relaxed);
+				if (front == tail.load(std::memory_order_acquire)) {
+					return false;
+				}
+				value = slots[front];
+				head.store((front + 1) % SLOTS, std::memory_order_release);
+				return true;
+			}
+		private:
+			static const int SLOTS = CAPACITY + 1;	// One slot is always left empty to tell full from empty.
+
+			T slots[SLOTS];						// The values in the queue.
+			std::atomic<int> head;				// The next slot to read, owned by the reader.
+			std::atomic<int> tail;				// The next slot to write, owned by the writer.
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,72 @@
+// fixed.h contains the fixed point number type used for deterministic physics
+
+#ifndef FIXED_H
+#define FIXED_H
+
+namespace Tetris {
+	namespace Simulation {
+		/*
+		* A Q16.16 fixed point number: a 32 bit integer counting in steps of 1/65536. Every operation is done with
+		* integer arithmetic, so the same inputs give the same bits on any compiler, optimisation level or CPU.
+		*/
+		struct Fixed {
+			static const int FRACTION_BITS = 16;			// Bits after the binary point.
+			static const int ONE = 1 << FRACTION_BITS;		// The raw value of 1.
+
+			int raw;										// The value multiplied by ONE.
+
+			/*
+			* Leaves the value uninitialised, like a float.
+			*/
+			Fixed() {}
+			/*
+			* Converts a whole number.
+			*/
+			Fixed(int value) : raw(value * ONE) {}
+			/*
+			* Converts a float, rounding towards zero. Scaling by a power of two is exact, so this is deterministic too.
+			*/
+			Fixed(float value) : raw((int)(value * ONE)) {}
+			/*
+			* Creates a number from its raw value.
+			*/
+			static Fixed fromRaw(int raw) {
+				Fixed fixed;
+				fixed.raw = raw;
+				return fixed;
+			}
+			/*
+			* Converts to a float for drawing.
+			*/
+			float toFloat() const {
+				return (float)raw / ONE;
+			}
+
+			Fixed operator-() const { return fromRaw(-raw); }
+			Fixed operator+(Fixed other) const { return fromRaw(raw + other.raw); }
+			Fixed operator-(Fixed other) const { return fromRaw(raw - other.raw); }
+			Fixed operator*(Fixed other) const { return fromRaw((int)(((long long)raw * other.raw) >> FRACTION_BITS)); }
+			Fixed operator/(Fixed other) const { return fromRaw((int)(((long long)raw << FRACTION_BITS) / other.raw)); }
+			Fixed& operator+=(Fixed other) { raw += other.raw; return *this; }
+			Fixed& operator-=(Fixed other) { raw -= other.raw; return *this; }
+			bool operator==(Fixed other) const { return raw == other.raw; }
+			bool operator!=(Fixed other) const { return raw != other.raw; }
+			bool operator<(Fixed other) const { return raw < other.raw; }
+			bool operator>(Fixed other) const { return raw > other.raw; }
+			bool operator<=(Fixed other) const { return raw <= other.raw; }
+			bool operator>=(Fixed other) const { return raw >= other.raw; }
+		};
+
+		/*
+		* Converts a physics value to a float for drawing and for the game's own logic.
+		*/
+		inline float toFloat(float value) {
+			return value;
+		}
+		inline float toFloat(Fixed value) {
+			return value.toFloat();
+		}
+	}
+}
+
+#endif
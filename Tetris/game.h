@@ -5,8 +5,22 @@
 
 #include <allegro5/allegro.h>
 #include <allegro5/allegro_font.h>
+#include <vector>
 #include "utils.h"
 #include "graphics.h"
+#include "tuning.h"
+#include "watcher.h"
+#include "renderer.h"
+#include "options.h"
+#include "arena.h"
+#include "world.h"
+#include "history.h"
+#include "scores.h"
+#include "metrics.h"
+#include "broadcast.h"
+#include "neural.h"
+#include "level.h"
+#include "resolution.h"
 
 namespace Tetris {
 	/*
@@ -17,7 +31,7 @@ namespace Tetris {
 		/*
 		* Makes the calls to initialise allegro and sets up the game components.
 		*/
-		Game();
+		Game(const Tetris::Options& options);
 		/*
 		* Frees up memory allocated.
 		*/
@@ -26,6 +40,22 @@ namespace Tetris {
 		* The main game loop.
 		*/
 		int loop();
+		/*
+		* Counters kept by the tick scheduler.
+		*/
+		struct SchedulerStats {
+			long long ticks;				// Ticks run.
+			long long lateTicks;			// Ticks run more than a frame after the timer fired.
+			long long droppedTicks;			// Ticks skipped because the game fell too far behind.
+		};
+		/*
+		* Gets the counters of ticks run, late and dropped.
+		*/
+		const SchedulerStats& getSchedulerStats();
+		/*
+		* Gets the number of heap allocations made by the tick and draw path after it warmed up. Should be 0.
+		*/
+		long long getSteadyStateAllocations();
 	private:
 		/*
 		* Helper class for buttons.
@@ -69,15 +99,50 @@ namespace Tetris {
 			Game* game;
 		};
 
+		/*
+		* The screens that have their own event handlers.
+		*/
+		enum Screen { MENU_SCREEN, GAME_SCREEN, SCREEN_COUNT };
+		/*
+		* A function that handles one type of event.
+		*/
+		typedef void (Game::*EventHandler)(ALLEGRO_EVENT& event);
+		static const int EVENT_TABLE_SIZE = 64;	// Covers every built-in Allegro event type.
+
+		Tetris::Options options;				// The options the game was started with.
+		static const size_t MENU_ARENA_SIZE = 2048;	// Bytes reserved for the main menu's widgets.
+		static const size_t GAME_ARENA_SIZE = 4096;	// Bytes reserved for the game screen's widgets.
+		Tetris::Utils::Arena menuArena;			// Owns the main menu's widgets.
+		Tetris::Utils::Arena gameArena;			// Owns the game screen's widgets.
 		ALLEGRO_DISPLAY *gameWindow;			// The main window for outputting graphics.
-		ALLEGRO_EVENT_QUEUE *eventQueue;		// The queue that holds all the events except the timer.
+		ALLEGRO_EVENT_QUEUE *eventQueue;		// The queue that holds all the input and display events.
 		ALLEGRO_EVENT_QUEUE *timerQueue;		// The queue for the timer events so that they don't starve handling of the other events.
 		Tetris::Utils::SoundManager soundManager;				// The sound manager.
 		Tetris::Utils::ImageManager imageManager;				// The image manager.
+		Tetris::Utils::FontManager fontManager;					// The font manager.
+		Tetris::Utils::Tuning tuning;							// The gameplay constants.
+		Tetris::Utils::AssetWatcher assetWatcher;				// Reloads assets and tuning when their files change.
+		std::vector<Tetris::Utils::AssetWatcher::Reload> reloads;	// Reloads taken from the watcher, kept to reuse the storage.
 		ALLEGRO_TIMER* timer;					// Timer for updating at 60Fps.
 		const int FPS = 60;						// The frame rate.
 		const float FPSIncrement = 1.0f / FPS;	// Frames per second increment (delta).
+		const int IDLE_FPS = 4;					// The tick rate while nothing on screen moves, enough to pick up reloads.
+		bool idle;								// Whether the timer is slowed down because nothing on screen moves.
 		bool shouldRun;							// Whether the game should run or not.
+		bool redraw;							// Whether the display needs to be redrawn.
+		const int EVENT_BATCH = 32;				// The most events handled before checking whether to redraw.
+		const int MAX_CATCH_UP = 5;				// The most ticks run back to back when the game falls behind.
+		double nextTickTime;					// When the next timer tick is expected.
+		SchedulerStats schedulerStats;			// Counters of ticks run, late and dropped.
+		const long long WARM_UP_TICKS = 120;	// Ticks before the loop is expected to stop allocating.
+		long long steadyStateAllocations;		// Heap allocations made by the loop after warming up.
+		long long steadyStatePasses;			// Passes through the loop after warming up.
+		long long worstPassAllocations;			// The most heap allocations made by one of those passes.
+		EventHandler handlers[SCREEN_COUNT][EVENT_TABLE_SIZE];	// Event handlers by screen and event type.
+		float mouseX;							// The latest mouse position.
+		float mouseY;
+		bool mouseMoved;						// Whether the mouse moved since the last hit test.
+		float boostStartHold[Tetris::Simulation::MAX_PLAYERS];	// When each player's boost key was pressed.
 
 		Tetris::Graphics::Panel *currDisplay;	// The current display.
 		ALLEGRO_FONT* bigFont;					// Font for the title of the game.
@@ -92,34 +157,135 @@ namespace Tetris {
 		Tetris::Graphics::Panel gameScreen;		// The game screen.
 		Tetris::Graphics::InformationBox* info;	// The information display at the top of the game screen.
 		Tetris::Graphics::Panel gameCanvas;		// The canvase to draw Tetris and the obstacles on.
+		Tetris::Graphics::WorldView* worldView;	// Draws the game objects onto the canvas.
 
 		Tetris::Graphics::Widget* lastHover;	// The last widget the mouse hovered over.
 		Tetris::Graphics::InformationBox::State state;	// The state of the game
-		Tetris::Graphics::TetrisSprite* tetris;	// The main character.
-		Tetris::Graphics::Wall* wall1;			// The first wall.
-		Tetris::Graphics::Wall* wall2;			// The second wall
-		Tetris::Graphics::Wall* wall3;			// The second wall
-		Tetris::Graphics::Wall* front;			// The wall that is in front
-		Tetris::Graphics::Wall* back;			// The wall that is at the very back
-
-		int score;								// The player's score.
+		Tetris::Simulation::World world;		// Tetris, the walls and the score.
+		Tetris::Simulation::CollisionMaskSet collisionMasks;	// The image manager's masks, which the world collides with.
+		Tetris::Simulation::Network demoNetwork;	// The trained network that plays the demo.
+		bool hasDemoNetwork;					// Whether demoNetwork was loaded; if not the demo uses World::demoMove.
+		Tetris::Simulation::LevelGenerator levels;	// Plans the gaps of the walls to come.
+		Tetris::Graphics::ParticleSystem particles;	// The crash, boost and score effects when drawing on this thread.
+		Tetris::Graphics::ParticleBurst pendingBursts[Tetris::Graphics::MAX_BURSTS];	// Bursts not yet handed to the render thread.
+		int pendingBurstCount;
+		float pendingParticleSeconds;			// Game time not yet handed to the render thread's particles.
+		int effectTicks;						// Ticks until the last burst's particles have all died.
+		static const int REWIND_TICKS = 3 * 60;	// How far back rewinding after a crash goes.
+		Tetris::Utils::History<Tetris::Simulation::World> history;	// The world at each recent tick, for rewinding.
+		Tetris::Utils::HighScores highScores;	// The best scores, kept on disk.
+		bool scoresPending;						// Whether the run is over but its scores wait in case it is rewound.
+		Tetris::Graphics::RenderThread* renderThread;	// Draws the frames when rendering is threaded, otherwise null.
+		Tetris::Graphics::DynamicResolution resolution;	// Scales the frames drawn on this thread to the window.
+		Tetris::Utils::VideoCapture* capture;	// Records gameplay video when asked for, otherwise null.
+		Tetris::Utils::Metrics metrics;			// Counters and timings for monitoring.
+		Tetris::Utils::MetricsServer* metricsServer;	// Serves the metrics when asked for, otherwise null.
+		Tetris::Net::SpectatorServer* spectatorServer;	// Broadcasts the game when asked for, otherwise null.
+		unsigned int broadcastTick;				// The number of the last frame broadcast.
 
 		/*
 		* Initialises the game components.
 		*/
 		void initGame();
 		/*
+		* Fills in the event handler table.
+		*/
+		void initHandlers();
+		/*
+		* Gets the screen that is currently displayed.
+		*/
+		Screen currentScreen();
+		/*
+		* Runs the timer ticks that are owed.
+		*/
+		void serviceTimer();
+		/*
+		* Handles a bounded batch of input and display events.
+		*/
+		void drainEvents();
+		/*
+		* Checks whether the screen is one where nothing moves: paused, or the main menu or game over once the
+		* particle effects have finished.
+		*/
+		bool isStatic();
+		/*
+		* Slows the timer down on static screens and brings it back to full rate when the game starts moving.
+		*/
+		void pace();
+		/*
+		* Sleeps until an event arrives or the next tick is due.
+		*/
+		void waitForEvents();
+		/*
+		* Updates the game by one frame.
+		*/
+		void tick();
+		/*
+		* Ends the game, or restarts it in demo mode, after Tetris crashes into the floor or a wall.
+		*/
+		void crash(Tetris::Simulation::StepResult cause);
+		/*
+		* Gets the player whose boost key this is, or -1 if it isn't one.
+		*/
+		int getBoostPlayer(int keycode);
+		/*
+		* Starts a particle effect at a player.
+		*/
+		void burst(Tetris::Graphics::ParticleBurst::Kind kind, int slot);
+		/*
+		* Puts the world back to how it was a few seconds ago and carries on playing.
+		*/
+		void rewind();
+		/*
+		* Submits the scores of a run that ended in a crash, once it can no longer be rewound.
+		*/
+		void submitScores();
+		/*
+		* Adds the allocations made since the given allocation count to steadyStateAllocations.
+		*/
+		void checkAllocations(long long since);
+		/*
+		* Prints the heap memory used by each subsystem and the allocations made by the loop.
+		*/
+		void reportMemory();
+		/*
+		* Calls the handler for the event on the current screen.
+		*/
+		void dispatch(ALLEGRO_EVENT& event);
+		/*
+		* Hit tests the latest mouse position if the mouse has moved.
+		*/
+		void flushMouseMove();
+		/*
+		* Event handlers.
+		*/
+		void onDisplayClose(ALLEGRO_EVENT& event);
+		void onDisplayResize(ALLEGRO_EVENT& event);
+		void onMouseMove(ALLEGRO_EVENT& event);
+		void onMouseClick(ALLEGRO_EVENT& event);
+		void onGameKeyDown(ALLEGRO_EVENT& event);
+		void onGameKeyUp(ALLEGRO_EVENT& event);
+		void onMenuKeyUp(ALLEGRO_EVENT& event);
+		/*
 		* Display graphics.
 		*/
 		void display();
 		/*
+		* Copies the state needed to draw a frame into the snapshot.
+		*/
+		void takeSnapshot(Tetris::FrameSnapshot& frame);
+		/*
 		* Resets the game.
 		*/
 		void reset();
 		/*
-		* AI decides whether the robot should use the jet or not.
+		* Pushes the tuning values to the world.
+		*/
+		void applyTuning();
+		/*
+		* Swaps in assets and tuning values the watcher has reloaded since the last tick.
 		*/
-		void demoMove();
+		void applyReloads();
 	};
 }
 
@@ -8,6 +8,8 @@
 #include <string>
 #include <allegro5/allegro_font.h>
 #include "utils.h"
+#include "world.h"
+#include "particles.h"
 
 namespace Tetris {
 	namespace Graphics {
@@ -16,6 +18,10 @@ namespace Tetris {
 		*/
 		class Rectangle {
 		public:
+			/*
+			* Creates an empty rectangle at the origin.
+			*/
+			Rectangle();
 			/*
 			* Creates a new rectangle with the given bounds.
 			*/
@@ -67,6 +73,8 @@ namespace Tetris {
 			float height;
 		};
 
+		class Panel;
+
 		/*
 		* The base class for all objects that can be displayed on the screen.
 		*/
@@ -75,7 +83,7 @@ namespace Tetris {
 			/*
 			* Initialises the bounding rectangle.
 			*/
-			Displayable() : bounds(Rectangle(0, 0, 0, 0)) {}
+			Displayable() : bounds(Rectangle(0, 0, 0, 0)), parent(nullptr) {}
 			/*
 			* Gets the bounding rectangle of the displayable object.
 			*/
@@ -89,11 +97,16 @@ namespace Tetris {
 			*/
 			void setBounds(Rectangle bounds);
 			/*
+			* Sets the panel this object was added to, which is told whenever the bounds change.
+			*/
+			void setParent(Panel* parent);
+			/*
 			* Draws the displayable object to the screen.
 			*/
 			virtual void draw() = 0;
 		private:
 			Rectangle bounds;			// The bounds of the displayable object.
+			Panel* parent;				// The panel containing this object, if any.
 		};
 
 		/*
@@ -148,8 +161,34 @@ namespace Tetris {
 			* Called when the mouse moves out of this component.
 			*/
 			void onMouseOut();
+			/*
+			* Marks the hit testing grid as out of date. Called when a widget on the panel moves.
+			*/
+			void invalidateGrid();
 		private:
+			/*
+			* Finds the first widget added to the panel that intersects the mouse, or null if there is none.
+			*/
+			Widget* widgetAt(Rectangle mouse);
+			/*
+			* Rebuilds the hit testing grid from the current widget bounds.
+			*/
+			void rebuildGrid();
+			/*
+			* Gets the column and row ranges of the grid cells the rectangle covers, clamped to the grid.
+			*/
+			void cellRange(Rectangle& rect, int& firstColumn, int& lastColumn, int& firstRow, int& lastRow);
+
+			static const int CELL_SIZE = 64;		// The width and height of a grid cell.
+
 			std::vector<Widget*> widgets;			// The widgets on the panel.
+			std::vector<Rectangle> widgetBounds;	// The bounds of each widget when the grid was built.
+			std::vector<int> cellStart;				// Where each cell's widgets start in cellWidgets.
+			std::vector<int> cellWidgets;			// Indices of the widgets overlapping each cell, cell by cell.
+			Rectangle gridBounds = Rectangle(0, 0, 0, 0);	// The panel bounds when the grid was built.
+			int columns = 0;						// The size of the grid.
+			int rows = 0;
+			bool gridDirty = true;					// Whether the grid needs to be rebuilt.
 		};
 
 		/*
@@ -241,6 +280,14 @@ namespace Tetris {
 			*/
 			void updateScore(int score);
 			/*
+			* Updates the score to be displayed from the world, showing every player's score when there are several.
+			*/
+			void updateScores(const Tetris::Simulation::World& world);
+			/*
+			* Updates the best score to be displayed.
+			*/
+			void updateBest(int best);
+			/*
 			* Sets the state of the game. A different instruction message will be displayed depending on whether the game
 			* is paused or not.
 			*/
@@ -266,135 +313,53 @@ namespace Tetris {
 			ALLEGRO_COLOR white;		// White
 			ALLEGRO_COLOR black;		// Black
 			int score;					// The score to be displayed
+			char scoreText[96];			// The score formatted for display, updated when the score changes.
+			int best;					// The best score to be displayed.
+			char bestText[32];			// The best score formatted for display.
 			State state;				// Whether the game is paused.
 		};
 
 		/*
-		* Represents an object to be moved around the screen.
+		* Draws the game objects of a world. The world itself is updated elsewhere, so this only reads it.
 		*/
-		class Sprite : public Widget {
+		class WorldView : public Widget {
 		public:
 			/*
-			* Creates a new sprite with the given image.
-			*/
-			Sprite(ALLEGRO_BITMAP* image);
-			/*
-			* Called when the mouse is hovering over the widget.
-			*/
-			Widget* onMouseOver(Rectangle mouse) { return nullptr; }
-			/*
-			* Called when the mouse moves out of this component.
-			*/
-			void onMouseOut() {}
-			/*
-			* Called when the mouse clicks the widget.
-			*/
-			void onMouseClick(Rectangle mouse) {}
-			/*
-			* Sets the velocity of the sprite.
-			*/
-			void setVelocity(float dx, float dy);
-			/*
-			* Gets the horizontal velocity.
+			* Creates a view with nothing to draw.
 			*/
-			float getVelocityX();
+			WorldView();
 			/*
-			* Sets the horizontal velocity.
+			* Sets the world to draw.
 			*/
-			void setVelocityX(float dx);
+			void setWorld(const Tetris::Simulation::World* world);
 			/*
-			* Gets the vertical velocity.
+			* Sets the bitmap drawn for entities with the given image.
 			*/
-			float getVelocityY();
+			void setImage(Tetris::Utils::ImageManager::Image image, ALLEGRO_BITMAP* bitmap);
 			/*
-			* Sets the vertical velocity.
+			* Sets the particles drawn over the world, or null for none.
 			*/
-			void setVelocityY(float dy);
+			void setParticles(ParticleSystem* particles);
 			/*
-			* Updates the position of the sprite based on its velocity and time elapsed.
-			*/
-			void update(float delta);
-			/*
-			* Sets the image of the sprite.
-			*/
-			void setImage(ALLEGRO_BITMAP* image);
-			/*
-			* Draws the sprite to the screen.
+			* Draws every renderable entity in the order they were created, then the particles.
 			*/
 			void draw();
-		protected:
-			float dx = 0;					// The horizontal velocity
-			float dy = 0;					// The vertical velocity
-			ALLEGRO_BITMAP* image;			// The sprite's image
-		};
-
-		/*
-		* Represents the Tetris character.
-		*/
-		class TetrisSprite : public Sprite {
-		public:
-			/*
-			* Creates the Tetris sprite.
-			*/
-			TetrisSprite(ALLEGRO_BITMAP *j) : Sprite(j) {}
-			/*
-			* Updates JetMan's velocity by applying gravity.
-			*/
-			void update(float delta);
-		private:
-			const float gravity = 90;			// gravity value - tweak for preferrence
-		};
-
-		/*
-		* Represents the wall sprite.
-		*/
-		class Wall : public Sprite {
-		public:
 			/*
-			* Creates a new wall sprite.
-			*/
-			Wall(ALLEGRO_BITMAP* w, int gapPosition);
-			/*
-			* Frees allocated memory.
-			*/
-			~Wall();
-			/*
-			* Updates the wall and each wall segments bounds.
-			*/
-			void update(float delta);
-			/*
-			* Randomly chooses the position of the hole.
-			*/
-			void updateGap();
-			/*
-			* Checks whether the rectangle collides with the wall.
-			*/
-			bool collides(Rectangle rect);
-			/*
-			* Draws the wall with the gap.
+			* Do nothing.
 			*/
-			void draw();
+			Widget* onMouseOver(Rectangle mouse) { return nullptr; }
 			/*
-			* Need to update the wall bounds when the position is changed.
+			* Do nothing.
 			*/
-			void setPosition(float x, float y);
+			void onMouseClick(Rectangle mouse) {}
 			/*
-			* The position of the gap.
+			* Do nothing.
 			*/
-			int Tetris::Graphics::Wall::getGapPosition();
+			void onMouseOut() {}
 		private:
-			/*
-			* blocks 1-3 from the top can be a gap.
-			*/
-			int gapPosition;
-			/*
-			* The rectangles represeting the walls.
-			*/
-			Rectangle* walls[4];
-			/*
-			* Updates the bounds of the wall rectangles.
-			*/
-			void updateWalls();
+			const Tetris::Simulation::World* world;		// The world being drawn.
+			ALLEGRO_BITMAP* images[3];					// The bitmap for each ImageManager::Image.
+			ParticleSystem* particles;					// The effects drawn over the world, or null.
 		};
 	}
 }
@@ -0,0 +1,78 @@
+// history.h contains the ring of snapshots used to rewind the game
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <string.h>
+#include <vector>
+#include <type_traits>
+#include "allocation.h"
+
+namespace Tetris {
+	namespace Utils {
+		/*
+		* Keeps the most recent snapshots of a plain data type, oldest first. The storage is allocated once when the
+		* history is created, and recording or going back copies a single snapshot with memcpy.
+		*/
+		template <typename T>
+		class History {
+			static_assert(std::is_trivially_copyable<T>::value, "History can only hold types copyable with memcpy");
+		public:
+			/*
+			* Creates a history that remembers the given number of snapshots, counted as simulation memory.
+			*/
+			History(int capacity) : next(0), count(0) {
+				MemoryScope scope(MEMORY_SIMULATION);
+				snapshots.resize(capacity);
+			}
+			/*
+			* Records a snapshot, forgetting the oldest one if the history is full.
+			*/
+			void record(const T& snapshot) {
+				memcpy(&snapshots[next], &snapshot, sizeof(T));
+				next = (next + 1) % (int)snapshots.size();
+				if (count < (int)snapshots.size()) {
+					count++;
+				}
+			}
+			/*
+			* Copies out the snapshot recorded the given number of steps ago, or the oldest one if the history doesn't
+			* go back that far, and forgets everything recorded after it. Returns false if there is nothing recorded.
+			*/
+			bool rewind(int steps, T& snapshot) {
+				if (count == 0) {
+					return false;
+				}
+				if (steps > count) {
+					steps = count;
+				}
+				if (steps < 1) {
+					steps = 1;
+				}
+				next = (next - steps + (int)snapshots.size()) % (int)snapshots.size();
+				count -= steps;
+				memcpy(&snapshot, &snapshots[next], sizeof(T));
+				return true;
+			}
+			/*
+			* Forgets every snapshot.
+			*/
+			void clear() {
+				next = 0;
+				count = 0;
+			}
+			/*
+			* Gets the number of snapshots recorded.
+			*/
+			int size() {
+				return count;
+			}
+		private:
+			std::vector<T> snapshots;	// The ring of snapshots.
+			int next;					// Where the next snapshot is recorded.
+			int count;					// The number of snapshots recorded.
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,119 @@
+// level.h contains the generator that plans fair sequences of wall gaps ahead of the game
+
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "world.h"
+#include "tuning.h"
+#include "concurrency.h"
+
+namespace Tetris {
+	namespace Simulation {
+		const int SEGMENT_LENGTH = 8;		// Gaps in each generated segment.
+		const int DIFFICULTY_TIERS = 4;		// Bands of difficulty the segments are generated in.
+
+		/*
+		* How hard it is to get from the gap in one wall to the gap in the next, worked out from the wall speed and
+		* spacing, gravity, the boosts and the collider sizes.
+		*/
+		struct ReachabilityGraph {
+			float difficulty[GAP_ROWS][GAP_ROWS];	// The share of the furthest the player can climb or fall between two walls that each move needs. Over 1 can't be made.
+			float hardest;							// The hardest move that can be made.
+			float wallInterval;						// Seconds between one wall reaching the player and the next.
+
+			/*
+			* Works out the difficulty of every move.
+			*/
+			void build(const Tetris::Utils::Tuning& tuning, float playerWidth, float playerHeight, float wallWidth, float wallHeight);
+			/*
+			* Checks whether the gap in the next wall can be reached from the gap in the one before it.
+			*/
+			bool reachable(int from, int to) const {
+				return difficulty[from][to] <= 1;
+			}
+		};
+
+		/*
+		* A run of gaps that can each be reached from the one before, starting from a given gap.
+		*/
+		struct GapSegment {
+			int from;								// The gap the segment follows on from.
+			int gaps[SEGMENT_LENGTH];				// The gaps, in the order the walls use them.
+			float difficulty;						// The average difficulty of the moves, from 0 to 1.
+		};
+
+		/*
+		* Plans the gaps of the walls ahead of the game on a background thread. Segments are kept ready for every
+		* gap they could follow on from and every difficulty tier, so the game only ever copies a finished segment
+		* into the world. The tier rises with the walls passed so the hardest walls come at the target survival time.
+		*/
+		class LevelGenerator {
+		public:
+			/*
+			* Creates a generator that isn't running yet.
+			*/
+			LevelGenerator();
+			/*
+			* Stops the background thread.
+			*/
+			~LevelGenerator();
+			/*
+			* Rebuilds the reachability graph for the tuning values and the collider sizes in the world. Segments
+			* already made are still used; new ones follow the new values.
+			*/
+			void configure(const Tetris::Utils::Tuning& tuning, const World& world);
+			/*
+			* Starts the background thread. configure() must have been called first.
+			*/
+			void start(unsigned int seed);
+			/*
+			* Stops the background thread.
+			*/
+			void stop();
+			/*
+			* Copies ready segments into the world while it has room for them. Only called by the game loop.
+			*/
+			void refill(World& world);
+			/*
+			* Gets the difficulty of the last segment given to the world.
+			*/
+			float getDifficulty();
+		private:
+			static const int READY_SEGMENTS = 2;	// Segments kept ready for each gap and tier.
+			static const int SLEEP_INTERVAL = 10;	// Milliseconds between checks for segments to make.
+
+			/*
+			* The body of the background thread.
+			*/
+			void run();
+			/*
+			* Makes a segment following on from a gap, with moves as close to the tier's band of difficulty as the
+			* graph allows.
+			*/
+			void makeSegment(const ReachabilityGraph& graph, int from, int tier, GapSegment& segment);
+			/*
+			* Gets the difficulty tier for the wall with the given number, counting from the start of the game.
+			*/
+			int getTier(int wall);
+			/*
+			* Gets a random number from 0 up to but not including the limit.
+			*/
+			int random(int limit);
+
+			std::mutex configLock;					// Guards graph.
+			ReachabilityGraph graph;				// The graph new segments are made from.
+			float targetSurvival;					// Seconds before the hardest tier is reached. Game loop only.
+			float wallInterval;						// Seconds between walls. Game loop only.
+			Tetris::Utils::SpscQueue<GapSegment, READY_SEGMENTS> ready[GAP_ROWS][DIFFICULTY_TIERS];	// Segments by the gap they follow and tier.
+			float difficulty;						// The difficulty of the last segment given to the world.
+			unsigned int randomState;				// The background thread's generator.
+			std::thread thread;						// The background thread.
+			std::atomic<bool> running;				// Whether the background thread should keep going.
+		};
+	}
+}
+
+#endif
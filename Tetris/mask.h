@@ -0,0 +1,91 @@
+// mask.h contains the 1 bit collision masks used to test collisions pixel by pixel
+
+#ifndef MASK_H
+#define MASK_H
+
+#include <vector>
+
+namespace Tetris {
+	namespace Simulation {
+		const int MAX_MASKED_IMAGES = 8;	// The most images a CollisionMaskSet can hold masks for.
+
+		/*
+		* One bit per pixel of an image, set where the pixel is solid. Each row is padded to whole 64 bit words with
+		* clear bits, so two masks are tested against each other a word at a time with a shift and an AND.
+		*/
+		class CollisionMask {
+		public:
+			/*
+			* Creates an empty mask, which never overlaps anything.
+			*/
+			CollisionMask();
+			/*
+			* Resizes the mask and clears every pixel.
+			*/
+			void create(int width, int height);
+			/*
+			* Marks a pixel as solid.
+			*/
+			void set(int x, int y);
+			/*
+			* Checks whether a pixel is solid. Pixels outside the mask aren't.
+			*/
+			bool get(int x, int y) const;
+			/*
+			* Gets the size of the mask in pixels.
+			*/
+			int getWidth() const {
+				return width;
+			}
+			int getHeight() const {
+				return height;
+			}
+			/*
+			* Gets the number of solid pixels.
+			*/
+			int count() const;
+			/*
+			* Checks whether any solid pixel of a, with its top left corner at (ax, ay), lies on a solid pixel of b
+			* at (bx, by).
+			*/
+			static bool overlap(const CollisionMask& a, int ax, int ay, const CollisionMask& b, int bx, int by);
+		private:
+			/*
+			* Gets the 64 pixels of a row starting from the given column, which can be negative. Pixels outside the
+			* mask are clear.
+			*/
+			unsigned long long extract(int row, int column) const;
+
+			int width;								// The size in pixels.
+			int height;
+			int stride;								// Words in each row.
+			std::vector<unsigned long long> bits;	// The rows, top first, with the leftmost pixel in the lowest bit.
+		};
+
+		/*
+		* The masks a world tests collisions with, by the image each entity is drawn with. A host fills one in and
+		* hands it to the worlds it creates, so worlds made by different hosts never share hidden state. The set and
+		* its masks have to outlive the worlds and only change between steps.
+		*/
+		class CollisionMaskSet {
+		public:
+			/*
+			* Creates a set with no masks, which tests boxes only.
+			*/
+			CollisionMaskSet();
+			/*
+			* Makes entities drawn with the image be tested against the mask once their boxes touch. Null goes back to
+			* testing boxes only.
+			*/
+			void set(int image, const CollisionMask* mask);
+			/*
+			* Gets the mask for the image, or null if it has none.
+			*/
+			const CollisionMask* get(int image) const;
+		private:
+			const CollisionMask* masks[MAX_MASKED_IMAGES];	// The mask of each image, or null.
+		};
+	}
+}
+
+#endif
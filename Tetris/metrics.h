@@ -0,0 +1,114 @@
+// metrics.h contains the counters collected while the game runs and the server that exposes them
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include "net.h"
+
+namespace Tetris {
+	namespace Utils {
+		/*
+		* Counts how many durations fall into each of a fixed set of buckets. Recording is a few relaxed atomic adds,
+		* so any thread can record while another reads.
+		*/
+		class Histogram {
+		public:
+			static const int BUCKETS = 10;			// The number of buckets, not counting the overflow bucket.
+			static const double BOUNDS[BUCKETS];	// The upper bound of each bucket in seconds.
+
+			/*
+			* Creates an empty histogram.
+			*/
+			Histogram();
+			/*
+			* Records a duration in seconds.
+			*/
+			void observe(double seconds);
+			/*
+			* Appends the histogram to the text in the Prometheus exposition format.
+			*/
+			void format(std::string& text, const char* name, const char* help);
+		private:
+			std::atomic<long long> counts[BUCKETS + 1];	// Durations in each bucket, the last for those above every bound.
+			std::atomic<long long> nanoseconds;			// The sum of the durations.
+
+			Histogram(const Histogram&);
+			Histogram& operator=(const Histogram&);
+		};
+
+		/*
+		* Everything the metrics server reports. The game loop updates these directly; there are no locks.
+		*/
+		struct Metrics {
+			Histogram tickSeconds;						// Time taken by each tick.
+			Histogram drawSeconds;						// Time taken to draw each frame, or hand it to the render thread.
+			std::atomic<long long> ticks;				// Ticks run.
+			std::atomic<long long> lateTicks;			// Ticks run more than a frame after the timer fired.
+			std::atomic<long long> droppedTicks;		// Ticks skipped because the game fell behind.
+			std::atomic<long long> eventsHandled;		// Input and display events handled.
+			std::atomic<int> eventBatch;				// Events handled in the last batch. Equal to the batch size when the queue is backed up.
+			std::atomic<long long> fullBatches;			// Batches that stopped at the batch size with events still queued.
+			std::atomic<long long> gamesPlayed;			// Games started by the player.
+			std::atomic<long long> floorCrashes;		// Games ended by hitting the floor.
+			std::atomic<long long> wallCrashes;			// Games ended by hitting a wall.
+
+			/*
+			* Starts every counter at zero.
+			*/
+			Metrics();
+			/*
+			* Formats every metric, plus the resident memory of the process, in the Prometheus exposition format.
+			*/
+			void format(std::string& text);
+		};
+
+		/*
+		* Serves the metrics over HTTP on a local TCP port from its own thread, so scraping never touches the game
+		* loop.
+		*/
+		class MetricsServer {
+		public:
+			/*
+			* Creates a server for the metrics.
+			*/
+			MetricsServer(Metrics& metrics);
+			/*
+			* Stops the server.
+			*/
+			~MetricsServer();
+			/*
+			* Starts listening on the port of 127.0.0.1. Returns false if the port couldn't be opened.
+			*/
+			bool start(int port);
+			/*
+			* Stops the server thread and closes the port.
+			*/
+			void stop();
+		private:
+			/*
+			* The body of the server thread.
+			*/
+			void run();
+			/*
+			* Reads the request and sends the metrics back.
+			*/
+			void respond(Tetris::Net::Socket client);
+
+			Metrics& metrics;						// The metrics served.
+			Tetris::Net::Socket listener;			// The listening socket.
+			std::thread thread;						// The server thread.
+			std::atomic<bool> running;				// Whether the server thread should keep going.
+			std::string text;						// The response, kept to reuse the storage.
+		};
+
+		/*
+		* Gets the resident memory of the process in bytes, or 0 if it isn't known.
+		*/
+		long long getResidentMemory();
+	}
+}
+
+#endif
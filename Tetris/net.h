@@ -0,0 +1,68 @@
+// net.h contains the thin wrapper over the platform's sockets used by the network features
+
+#ifndef NET_H
+#define NET_H
+
+#include <stdint.h>
+
+namespace Tetris {
+	namespace Net {
+#ifdef _WIN32
+		typedef uintptr_t Socket;				// The same as SOCKET, without pulling windows.h into every file.
+		const Socket INVALID = ~(Socket)0;
+#else
+		typedef int Socket;
+		const Socket INVALID = -1;		// Returned when a socket couldn't be created.
+#endif
+
+		/*
+		* Starts up the socket library. Must be called before any other function. Returns false on failure.
+		*/
+		bool startup();
+		/*
+		* Opens a TCP socket listening on the port of the given address, e.g. "127.0.0.1" for local connections only.
+		*/
+		Socket listenTcp(const char* address, int port);
+		/*
+		* Opens a TCP connection to the port of the given address.
+		*/
+		Socket connectTcp(const char* address, int port);
+		/*
+		* Waits up to the timeout for a connection on the listening socket and accepts it. Returns INVALID if none
+		* arrived.
+		*/
+		Socket acceptClient(Socket listener, int timeoutMilliseconds);
+		/*
+		* Waits up to the timeout for the socket to have data to read. Returns whether it does.
+		*/
+		bool waitReadable(Socket socket, int timeoutMilliseconds);
+		/*
+		* Reads whatever has arrived, up to size bytes. Returns the number of bytes read, 0 when the other end has
+		* closed the connection or -1 on error.
+		*/
+		int receive(Socket socket, char* buffer, int size);
+		/*
+		* Sends every byte, blocking until done. Returns false if the connection failed.
+		*/
+		bool sendAll(Socket socket, const char* data, int size);
+		/*
+		* Sends as many bytes as the socket will take without waiting. Returns the number sent, which may be 0, or -1
+		* if the connection failed.
+		*/
+		int sendSome(Socket socket, const char* data, int size);
+		/*
+		* Checks whether the last failed call on a non-blocking socket failed only because it would have waited.
+		*/
+		bool wouldBlock();
+		/*
+		* Makes sends and receives on the socket return straight away instead of waiting.
+		*/
+		void setNonBlocking(Socket socket);
+		/*
+		* Closes the socket.
+		*/
+		void closeSocket(Socket socket);
+	}
+}
+
+#endif
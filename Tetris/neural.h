@@ -0,0 +1,97 @@
+// neural.h contains the small neural network that can play the demo, and the batch of networks the trainer runs
+
+#ifndef NEURAL_H
+#define NEURAL_H
+
+#include <vector>
+#include "world.h"
+
+namespace Tetris {
+	namespace Simulation {
+		/*
+		* The shape of the network: what it sees of the world, one hidden layer, and one output per kind of boost.
+		*/
+		const int NETWORK_INPUTS = 5;		// Height, vertical speed, distance to the front wall, offset to its gap and the next.
+		const int NETWORK_HIDDEN = 8;		// Neurons in the hidden layer.
+		const int NETWORK_OUTPUTS = 2;		// Small boost, big boost.
+		const int NETWORK_WEIGHTS = (NETWORK_INPUTS + 1) * NETWORK_HIDDEN + (NETWORK_HIDDEN + 1) * NETWORK_OUTPUTS;
+
+		/*
+		* What a network decided to do this tick.
+		*/
+		enum NetworkMove {
+			GLIDE,							// Let gravity act.
+			SMALL_BOOST,					// Tap the jet.
+			BIG_BOOST						// Hold the jet.
+		};
+
+		/*
+		* Fills in what a player sees of the world, each scaled to roughly -1 to 1.
+		*/
+		void readInputs(const World& world, int slot, float inputs[NETWORK_INPUTS]);
+
+		/*
+		* A network with one hidden layer of ReLU neurons. The weights are stored layer by layer, each neuron's
+		* weights followed by its bias.
+		*/
+		struct Network {
+			float weights[NETWORK_WEIGHTS];
+
+			/*
+			* Works out the move for the inputs.
+			*/
+			NetworkMove decide(const float inputs[NETWORK_INPUTS]) const;
+			/*
+			* Decides for a player and gives it the matching boost.
+			*/
+			void play(World& world, int slot, const Tetris::Utils::Tuning& tuning) const;
+			/*
+			* Writes the weights to a file. Returns false if it couldn't be written.
+			*/
+			bool save(const char* path) const;
+			/*
+			* Reads the weights from a file written by save(). Returns false, leaving the weights alone, if the file
+			* is missing or was written for a different shape of network.
+			*/
+			bool load(const char* path);
+		};
+
+		/*
+		* Many networks evaluated together. The weights, inputs and activations are stored one array per value with
+		* an entry per network, so one SSE instruction works on four networks at once and a core decides for a whole
+		* population each tick.
+		*/
+		class NetworkBatch {
+		public:
+			/*
+			* Creates a batch for the given number of networks.
+			*/
+			NetworkBatch(int size);
+			/*
+			* Copies a network's weights into the batch.
+			*/
+			void setNetwork(int index, const Network& network);
+			/*
+			* Gets the inputs of one network to fill in before decide().
+			*/
+			void setInputs(int index, const float inputs[NETWORK_INPUTS]);
+			/*
+			* Works out the move of every network from its inputs.
+			*/
+			void decide();
+			/*
+			* Gets the move of a network worked out by decide().
+			*/
+			NetworkMove getMove(int index);
+		private:
+			int size;							// The number of networks.
+			int stride;							// The size rounded up to a multiple of four.
+			std::vector<float> weights;			// Weight w of network n is at w * stride + n.
+			std::vector<float> inputs;			// Input i of network n is at i * stride + n.
+			std::vector<float> hidden;			// Activations of the hidden layer, laid out the same way.
+			std::vector<float> outputs;			// Outputs, laid out the same way.
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,39 @@
+// options.h contains the command line options of the game
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+namespace Tetris {
+	/*
+	* The options the game was started with.
+	*/
+	struct Options {
+		bool threadedRendering = false;		// Draw on a separate render thread (--threaded).
+		int benchRenderFrames = 0;			// Frames to draw offscreen for the render benchmark instead of playing (--bench-render N).
+		const char* goldenImage = nullptr;	// Where the render benchmark saves its last frame (--golden FILE).
+		int benchCollisionTicks = 0;		// Ticks of collisions to time with boxes and masks instead of playing (--bench-collision N).
+		int benchEnvironmentSteps = 0;		// Steps of the training environment to time instead of playing (--bench-env N).
+		int environmentGames = 4096;		// Games the environment benchmark steps together (--envs N).
+		const char* capturePath = nullptr;	// Where to record gameplay video, if anywhere (--capture FILE).
+		int metricsPort = 0;				// The local port to serve metrics on, or 0 for none (--metrics-port N).
+		int broadcastPort = 0;				// The local port to broadcast the game to spectators on, or 0 for none (--broadcast-port N).
+		int spectatePort = 0;				// Watch the game broadcast on this port instead of playing (--spectate N).
+		int spectatorLoad = 0;				// With --spectate, connect this many headless spectators and report throughput (--spectators N).
+		int serverPort = 0;					// Run the session server on this port instead of playing (--serve N).
+		int serverWorkers = 0;				// Worker threads for the session server, or 0 for one per core (--workers N).
+		int botPort = 0;					// Load a session server on this port with bots instead of playing (--bot-port N).
+		int botCount = 100;					// The number of bots to connect (--bots N).
+		int players = 1;					// Players racing through the same walls, up to 4 (--players N).
+		int trainGenerations = 0;			// Generations to evolve the demo network for instead of playing (--train N).
+		int population = 2048;				// Networks in each generation (--population N).
+		const char* networkPath = "assets/demo.net";	// The demo network, written by training and played by the demo (--network FILE).
+		int memoryBudget = 0;				// Megabytes of heap the memory report warns about going over, or 0 for none (--memory-budget MB).
+
+		/*
+		* Reads the options from the command line. Unknown arguments are ignored.
+		*/
+		void parse(int n, char** args);
+	};
+}
+
+#endif
@@ -0,0 +1,79 @@
+// particles.h contains the pooled particle system used for the crash, boost and score effects
+
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <vector>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_primitives.h>
+
+namespace Tetris {
+	namespace Graphics {
+		const int PARTICLE_CAPACITY = 32768;	// The most particles alive at once; bursts past this are cut short.
+		const float PARTICLE_MAX_LIFE = 1.5f;	// The longest any particle lives, in seconds.
+		const int MAX_BURSTS = 16;				// The most bursts a frame snapshot carries.
+
+		/*
+		* A burst of particles for an effect, at a position in the world. Plain data so frame snapshots can carry
+		* the bursts to the render thread.
+		*/
+		struct ParticleBurst {
+			enum Kind { CRASH, SMALL_BOOST, BIG_BOOST, SCORE };
+			Kind kind;							// Which effect to emit.
+			float x;							// Where to emit it.
+			float y;
+		};
+
+		/*
+		* A fixed pool of particles stored one array per field, so the update runs over them four at a time with SSE
+		* and the live particles are always the first count entries. Every array, including the vertices they are
+		* drawn from, is allocated when the system is created, so emitting, updating and drawing never allocate.
+		*/
+		class ParticleSystem {
+		public:
+			/*
+			* Creates an empty system that holds up to the given number of particles.
+			*/
+			ParticleSystem(int capacity = PARTICLE_CAPACITY);
+			/*
+			* Emits the particles of a burst.
+			*/
+			void emit(const ParticleBurst& burst);
+			/*
+			* Moves the particles on by the given number of seconds and removes the ones that have died.
+			*/
+			void update(float delta);
+			/*
+			* Draws every particle with a single call, fading each out as it dies.
+			*/
+			void draw();
+			/*
+			* Removes every particle.
+			*/
+			void clear();
+			/*
+			* Gets the number of live particles.
+			*/
+			int getCount();
+		private:
+			/*
+			* Gets a random number from 0 up to but not including 1.
+			*/
+			float random();
+
+			int capacity;						// The most particles, rounded up to a multiple of four.
+			int count;							// The number of live particles.
+			unsigned int randomState;			// The state of the generator that scatters the particles.
+			std::vector<float> x;				// The position of each particle.
+			std::vector<float> y;
+			std::vector<float> dx;				// The velocity of each particle.
+			std::vector<float> dy;
+			std::vector<float> life;			// Seconds each particle has left.
+			std::vector<float> fade;			// One over the seconds each particle started with.
+			std::vector<ALLEGRO_COLOR> colour;	// The colour of each particle.
+			std::vector<ALLEGRO_VERTEX> vertices;	// Two triangles per particle, filled in by draw().
+		};
+	}
+}
+
+#endif
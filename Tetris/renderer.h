@@ -0,0 +1,183 @@
+// renderer.h contains the classes used to draw frames from snapshots of the game, optionally on a render thread
+
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_font.h>
+#include "graphics.h"
+#include "utils.h"
+#include "concurrency.h"
+#include "arena.h"
+#include "world.h"
+#include "capture.h"
+#include "resolution.h"
+
+namespace Tetris {
+	/*
+	* Where the widgets of each screen are placed. Shared by the game and the snapshot renderer so both draw the
+	* same layout.
+	*/
+	namespace Layout {
+		const float SCREEN_WIDTH = 800;
+		const float SCREEN_HEIGHT = 600;
+		const float TITLE_X = 260;
+		const float TITLE_Y = 100;
+		const float BUTTON_X = 360;
+		const float PLAY_Y = 250;
+		const float DEMO_Y = 300;
+		const float QUIT_Y = 350;
+		const float INFO_HEIGHT = 100;
+	}
+
+	/*
+	* An immutable copy of everything needed to draw one frame.
+	*/
+	struct FrameSnapshot {
+		enum Screen { MENU, GAME };
+		Screen screen;									// The screen being displayed.
+		int hoveredButton;								// The menu button under the mouse (play, demo, quit) or -1.
+		Tetris::Simulation::World world;				// The game objects and the score.
+		int bestScore;									// The best score in the high score table.
+		Tetris::Graphics::InformationBox::State state;	// The state shown in the information box.
+		Tetris::Graphics::ParticleBurst bursts[Tetris::Graphics::MAX_BURSTS];	// Effects started since the last snapshot.
+		int burstCount;
+		float particleSeconds;							// Game time passed since the last snapshot, to move the particles on by.
+	};
+
+	namespace Graphics {
+		/*
+		* Draws frames from snapshots using its own copy of the game's widgets, so it never touches the widgets the
+		* game is updating.
+		*/
+		class SceneRenderer {
+		public:
+			/*
+			* Seconds spent drawing each part of the frames, added up over every frame drawn with them.
+			*/
+			struct Costs {
+				double background;			// The background image.
+				double menu;				// The title and buttons.
+				double information;			// The information box.
+				double world;				// Tetris and the walls.
+			};
+			/*
+			* Builds the widgets of each screen with the given images and fonts.
+			*/
+			SceneRenderer(ALLEGRO_BITMAP* background, ALLEGRO_BITMAP* tetrisImage, ALLEGRO_BITMAP* wallImage, ALLEGRO_FONT* bigFont, ALLEGRO_FONT* normalFont);
+			/*
+			* Emits the frame's bursts and moves the particles on, then draws the frame to the current target bitmap,
+			* adding the time taken by each part to the costs if given.
+			*/
+			void draw(const FrameSnapshot& frame, Costs* costs = nullptr);
+			/*
+			* Changes one of the images used for drawing.
+			*/
+			void setImage(Tetris::Utils::ImageManager::Image image, ALLEGRO_BITMAP* bitmap);
+		private:
+			static const size_t ARENA_SIZE = 4096;	// Bytes reserved for the widgets.
+
+			ALLEGRO_BITMAP* background;		// The background image.
+			Tetris::Utils::Arena arena;		// Owns the widgets.
+			Panel menu;						// The main menu screen.
+			Label* title;					// The title of the game.
+			Button* buttons[3];				// The play, demo and quit buttons.
+			Panel game;						// The game screen.
+			InformationBox* info;			// The information display at the top of the game screen.
+			Panel canvas;					// The canvas the game objects are drawn on.
+			WorldView* view;				// Draws the snapshot's world.
+			ParticleSystem particles;		// The effects, kept up to date from the snapshots' bursts.
+		};
+
+		/*
+		* Draws snapshots published by the game loop on a dedicated thread. The display belongs to the render thread
+		* while it runs, so the game loop never waits for a flip.
+		*/
+		class RenderThread {
+		public:
+			/*
+			* Prepares to render to the display with the game's images and its fonts. Must be called while the display
+			* is still current on the calling thread: the image manager's bitmaps belong to the display, so the render
+			* thread takes them over and the manager is left with memory bitmap copies.
+			*/
+			RenderThread(ALLEGRO_DISPLAY* display, Tetris::Utils::ImageManager& images, Tetris::Utils::FontManager& fonts);
+			/*
+			* Stops the render thread.
+			*/
+			~RenderThread();
+			/*
+			* Records every frame drawn with the capture. Must be called before start().
+			*/
+			void setCapture(Tetris::Utils::VideoCapture* capture);
+			/*
+			* Starts the render thread. The calling thread must have released the display.
+			*/
+			void start();
+			/*
+			* Stops the render thread and releases the display.
+			*/
+			void stop();
+			/*
+			* Gets the snapshot to fill in for the next frame.
+			*/
+			FrameSnapshot& beginFrame();
+			/*
+			* Hands the filled in snapshot to the render thread.
+			*/
+			void publish();
+			/*
+			* Replaces one of the images. Takes ownership of the memory bitmap, which is uploaded on the render thread,
+			* and of the retired bitmap, which is destroyed there. Only called from the game loop's thread.
+			*/
+			void replaceImage(Tetris::Utils::ImageManager::Image image, ALLEGRO_BITMAP* bitmap, ALLEGRO_BITMAP* retired);
+			/*
+			* Gets the number of frames drawn so far.
+			*/
+			long long getFramesDrawn();
+			/*
+			* Asks the render thread to acknowledge that the display was resized, since it owns the display.
+			*/
+			void resize();
+		private:
+			/*
+			* An image waiting to be swapped in by the render thread.
+			*/
+			struct ImageSwap {
+				Tetris::Utils::ImageManager::Image image;
+				ALLEGRO_BITMAP* bitmap;						// The new image, or null if there is only a bitmap to retire.
+				ALLEGRO_BITMAP* retired;					// A bitmap the game no longer uses, or null.
+			};
+
+			static const int MAX_SWAPS = 16;				// Swaps that can wait for the render thread at once.
+
+			/*
+			* The body of the render thread.
+			*/
+			void run();
+			/*
+			* Uploads and swaps in images replaced since the last frame.
+			*/
+			void swapImages(SceneRenderer& renderer);
+
+			ALLEGRO_DISPLAY* display;						// The display drawn to.
+			Tetris::Utils::FontManager& fonts;				// The fonts.
+			Tetris::Utils::VideoCapture* capture;			// Records the frames drawn, or null.
+			ALLEGRO_BITMAP* bitmaps[3];						// The render thread's images, which live on the display.
+			Tetris::Utils::TripleBuffer<FrameSnapshot> frames;	// Snapshots handed from the game loop.
+			std::thread thread;								// The render thread.
+			std::atomic<bool> running;						// Whether the render thread should keep going.
+			std::atomic<long long> framesDrawn;				// Frames drawn so far.
+			std::atomic<bool> resized;						// Whether the display was resized since the last frame.
+			std::mutex wakeLock;							// Used with wake to sleep until a frame is published.
+			std::condition_variable wake;
+			Tetris::Utils::SpscQueue<ImageSwap, MAX_SWAPS> swaps;	// Images handed from the game loop, waiting to be swapped in.
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,69 @@
+// resolution.h contains the offscreen target that adapts its resolution to keep drawing within a time budget
+
+#ifndef RESOLUTION_H
+#define RESOLUTION_H
+
+#include <allegro5/allegro.h>
+
+namespace Tetris {
+	namespace Graphics {
+		/*
+		* Frames are drawn in logical coordinates to an offscreen bitmap, which is then scaled to fit the window with
+		* black bars keeping the aspect ratio. The bitmap's resolution follows the measured draw time: it drops when
+		* frames go over budget and climbs back, up to the window's own resolution, when there is time to spare.
+		* Everything drawn in between sees a transform from logical coordinates, so widgets never know the scale.
+		*/
+		class DynamicResolution {
+		public:
+			/*
+			* Prepares to draw frames of the given logical size within the budget in seconds.
+			*/
+			DynamicResolution(float logicalWidth, float logicalHeight, double budget);
+			/*
+			* Frees the offscreen bitmap.
+			*/
+			~DynamicResolution();
+			/*
+			* Targets the offscreen bitmap, resized to the current scale, with a transform from logical coordinates.
+			* Must be called on the thread that owns the display.
+			*/
+			void beginFrame(ALLEGRO_DISPLAY* display);
+			/*
+			* Draws the offscreen bitmap to the display's backbuffer and adjusts the scale from the time the frame took.
+			* The backbuffer is left as the target, ready to be flipped.
+			*/
+			void endFrame(ALLEGRO_DISPLAY* display);
+			/*
+			* Gets the resolution the frames are drawn at, as a fraction of the logical size.
+			*/
+			float getScale();
+			/*
+			* Gets the offscreen bitmap the last frame was drawn to. It always holds the whole logical frame, without the
+			* black bars, whatever the size of the window. Null until the first frame.
+			*/
+			ALLEGRO_BITMAP* getTarget();
+			/*
+			* Converts a position in the window to logical coordinates. Can be called from any thread.
+			*/
+			static void toLogical(ALLEGRO_DISPLAY* display, float logicalWidth, float logicalHeight, float& x, float& y);
+		private:
+			static const int ADAPT_FRAMES = 30;		// Frames between changes of scale, so it doesn't flicker between two.
+
+			/*
+			* Records a frame's draw time and changes the scale if the average is out of bounds.
+			*/
+			void adapt(double seconds, float windowScale);
+
+			float logicalWidth;					// The size frames are laid out at.
+			float logicalHeight;
+			double budget;						// The most seconds a frame should take to draw.
+			ALLEGRO_BITMAP* target;				// The offscreen bitmap, or null until the first frame.
+			float scale;						// The resolution of target as a fraction of the logical size.
+			double frameStart;					// When the current frame started.
+			double average;						// The moving average draw time.
+			int frames;							// Frames since the scale last changed.
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,108 @@
+// scores.h contains the high score table and the class that keeps it on disk
+
+#ifndef SCORES_H
+#define SCORES_H
+
+#include <thread>
+#include <atomic>
+#include "concurrency.h"
+
+namespace Tetris {
+	namespace Utils {
+		/*
+		* The best scores, highest first. Plain data so it can live directly in the memory mapped file.
+		*/
+		struct ScoreTable {
+			static const int SIZE = 10;			// The number of scores kept.
+
+			int count;							// The number of scores in the table.
+			int scores[SIZE];					// The scores, highest first.
+			long long times[SIZE];				// When each score was set, in seconds since 1970.
+
+			/*
+			* Adds a score if it is good enough to make the table. Returns whether it did.
+			*/
+			bool add(int score, long long time);
+			/*
+			* Gets the best score, or 0 if there are none.
+			*/
+			int best() const;
+		};
+
+		/*
+		* Keeps the high score table in a memory mapped file, so it can be read at startup without parsing anything.
+		* New scores go into a copy owned by the game loop and are handed to a writer thread, which copies them into
+		* the mapping and flushes it to disk at most once every SYNC_INTERVAL. The game loop never touches the disk.
+		*/
+		class HighScores {
+		public:
+			/*
+			* Creates an empty table that isn't backed by a file.
+			*/
+			HighScores();
+			/*
+			* Flushes the table and closes the file.
+			*/
+			~HighScores();
+			/*
+			* Maps the file, creating it if needed, reads the table and starts the writer thread. Returns false if the
+			* file couldn't be mapped, in which case scores are still kept for this session.
+			*/
+			bool open(const char* path);
+			/*
+			* Stops the writer thread once the latest table is on disk and unmaps the file.
+			*/
+			void close();
+			/*
+			* Adds a score if it is good enough. Never blocks. Returns whether it made the table.
+			*/
+			bool submit(int score);
+			/*
+			* Gets the table as the game loop sees it.
+			*/
+			const ScoreTable& getTable();
+		private:
+			/*
+			* The layout of the file.
+			*/
+			struct ScoreFile {
+				char magic[4];					// "TSCR"
+				unsigned int version;			// The layout version.
+				ScoreTable table;				// The scores.
+			};
+
+			static const int SYNC_INTERVAL = 1000;	// The fewest milliseconds between flushes to disk.
+
+			/*
+			* The body of the writer thread.
+			*/
+			void run();
+			/*
+			* Copies the latest submitted table into the mapping and flushes it. Returns whether there was one.
+			*/
+			bool write();
+			/*
+			* Flushes the mapping to disk.
+			*/
+			void sync();
+			/*
+			* Unmaps and closes the file.
+			*/
+			void unmap();
+
+			ScoreTable table;					// The scores as the game loop sees them.
+			TripleBuffer<ScoreTable> submitted;	// Tables handed from the game loop to the writer thread.
+			ScoreFile* mapped;					// The mapped file, or null.
+#ifdef _WIN32
+			void* file;							// The file handle.
+			void* mapping;						// The file mapping handle.
+#else
+			int file;							// The file descriptor.
+#endif
+			std::thread thread;					// The writer thread.
+			std::atomic<bool> running;			// Whether the writer thread should keep going.
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,164 @@
+// server.h contains the authoritative game server that runs many sessions at once, and the bots used to load it
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include "net.h"
+#include "world.h"
+#include "broadcast.h"
+
+namespace Tetris {
+	namespace Net {
+		/*
+		* What a client sends, one byte per input.
+		*/
+		const char INPUT_SMALL_BOOST = 'j';		// A tap of the spacebar.
+		const char INPUT_BIG_BOOST = 'J';		// A held spacebar.
+		const char INPUT_RESTART = 'R';			// Start again after crashing.
+
+		/*
+		* The collider sizes used by server sessions, which have no images to measure.
+		*/
+		const float SESSION_PLAYER_WIDTH = 40;
+		const float SESSION_PLAYER_HEIGHT = 40;
+		const float SESSION_WALL_WIDTH = 50;
+		const float SESSION_WALL_HEIGHT = 100;
+
+		/*
+		* Runs the game for every client connected to it. Each client gets its own world, stepped sixty times a
+		* second on the server, and is sent a SpectatorFrame after every tick in which something changed, prefixed
+		* with its length in one byte and written against the frame sent before it.
+		*
+		* Sessions are shared out between worker threads. Each worker waits on a single epoll set holding the
+		* listening socket and its clients, and keeps its sessions in a timer wheel by the millisecond their next
+		* tick is due, so a worker only touches the sessions that are due and sleeps until the next one is.
+		*
+		* Only available on Linux; start() fails elsewhere.
+		*/
+		class SessionServer {
+		public:
+			/*
+			* Counters for one worker, or every worker added together.
+			*/
+			struct Stats {
+				int sessions;						// Sessions connected.
+				long long ticks;					// Session ticks run.
+				double jitterSum;					// Seconds each tick ran after it was due, added up.
+				double jitterMax;					// The latest a tick ran.
+				double busySeconds;					// Thread CPU time spent.
+			};
+
+			/*
+			* Creates a server with the given number of worker threads.
+			*/
+			SessionServer(int workers);
+			/*
+			* Stops the server.
+			*/
+			~SessionServer();
+			/*
+			* Starts listening on the port of every interface and starts the workers. Returns false if the port
+			* couldn't be opened or this isn't Linux.
+			*/
+			bool start(int port);
+			/*
+			* Disconnects every client and stops the workers.
+			*/
+			void stop();
+			/*
+			* Adds up the counters of every worker since the last call, then clears them. Sessions is the current count.
+			*/
+			Stats takeStats();
+			/*
+			* Gets the number of worker threads.
+			*/
+			int getWorkerCount();
+		private:
+			static const int TICK_MICROSECONDS = 16667;	// Time between the ticks of a session.
+			static const int WHEEL_SLOTS = 32;			// Slots in the timer wheel, one per millisecond.
+			static const int MAX_PENDING = 16384;		// Unsent bytes after which a client is disconnected.
+
+			/*
+			* One client's game.
+			*/
+			struct Session {
+				Socket socket;						// The client, or INVALID when the slot is free.
+				Tetris::Simulation::World world;	// The client's game.
+				bool over;							// Whether the player has crashed.
+				bool changed;						// Whether the state has to be sent.
+				unsigned int tick;					// Ticks run.
+				long long due;						// When the next tick is due, in microseconds.
+				int next;							// The next session in the same wheel slot, or -1.
+				int previous;						// The previous session in the same wheel slot, or -1.
+				SpectatorFrame sent;				// The last frame sent, the base of the next one.
+				std::vector<unsigned char> pending;	// Bytes the socket hasn't taken yet.
+			};
+
+			/*
+			* A worker thread and the sessions it owns. Only the worker's own thread touches its sessions.
+			*/
+			struct Worker {
+				int epoll;							// The epoll set.
+				std::thread thread;					// The worker thread.
+				std::vector<Session> sessions;		// Sessions by index, including free ones.
+				std::vector<int> freeSessions;		// Indices of free sessions.
+				int wheel[WHEEL_SLOTS];				// The first session in each slot, or -1.
+				long long now;						// The millisecond the wheel has been run up to.
+				std::mutex statsLock;				// Guards stats.
+				Stats stats;						// Counters since they were last taken.
+			};
+
+			/*
+			* The body of a worker thread.
+			*/
+			void run(Worker& worker);
+			/*
+			* Accepts every waiting client into the worker.
+			*/
+			void acceptSessions(Worker& worker, long long now);
+			/*
+			* Reads and applies a client's inputs. Returns false if it disconnected.
+			*/
+			bool readInputs(Session& session);
+			/*
+			* Runs one tick of a session and sends the new state. Returns false if the client has to be disconnected.
+			*/
+			bool tickSession(Session& session);
+			/*
+			* Puts a session into the wheel slot of its due time.
+			*/
+			void schedule(Worker& worker, int index);
+			/*
+			* Takes a session out of its wheel slot.
+			*/
+			void unschedule(Worker& worker, int index);
+			/*
+			* Disconnects a session and frees its slot.
+			*/
+			void closeSession(Worker& worker, int index);
+
+			std::vector<Worker*> workers;			// The workers.
+			Socket listener;						// The listening socket, shared by every worker.
+			std::atomic<bool> running;				// Whether the workers should keep going.
+			std::atomic<unsigned int> seeds;		// Seeds for the worlds of new sessions.
+		};
+
+		/*
+		* Runs a session server with the given number of workers until the process is killed, printing its load every
+		* few seconds. Returns 1 if it couldn't start.
+		*/
+		int runSessionServer(int port, int workers);
+		/*
+		* Connects the given number of bots to a session server on this machine. Each plays with the demo AI for the
+		* given number of seconds, after which the frames and bytes received are printed. Returns 0 if every bot
+		* stayed connected.
+		*/
+		int runBots(int bots, int port, double seconds);
+	}
+}
+
+#endif
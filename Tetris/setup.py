@@ -0,0 +1,24 @@
+# setup.py builds the tetris_env Python module: python setup.py build_ext --inplace
+
+import sys
+from setuptools import setup, Extension
+
+if sys.platform == "win32":
+	flags = ["/O2", "/EHsc"]
+else:
+	flags = ["-std=c++11", "-O3", "-pthread"]
+
+setup(
+	name="tetris_env",
+	version="1.0",
+	description="Vectorised headless Tetris games for reinforcement learning",
+	ext_modules=[
+		Extension(
+			"tetris_env",
+			sources=["Bindings.cpp", "VecEnv.cpp", "World.cpp", "Neural.cpp", "Mask.cpp"],
+			language="c++",
+			extra_compile_args=flags,
+			extra_link_args=[] if sys.platform == "win32" else ["-pthread"],
+		)
+	],
+)
@@ -0,0 +1,32 @@
+// spectator.h contains the spectator viewer and the spectator load generator
+
+#ifndef SPECTATOR_H
+#define SPECTATOR_H
+
+namespace Tetris {
+	/*
+	* Watches a game broadcast on a local port, drawing it with the same widgets the game uses.
+	*/
+	class SpectatorViewer {
+	public:
+		/*
+		* Prepares to watch the game broadcast on the port.
+		*/
+		SpectatorViewer(int port);
+		/*
+		* Opens a window and draws the game until the window is closed, Esc is pressed or the broadcast ends.
+		* Allegro must be initialised. Returns 0 on success.
+		*/
+		int run();
+	private:
+		int port;				// The port the game is broadcast on.
+	};
+
+	/*
+	* Connects the given number of headless spectators to the port, keeps up with the broadcast for the given number of
+	* seconds and prints how many frames and bytes each received. Returns 0 if every spectator stayed connected.
+	*/
+	int runSpectatorLoad(int spectators, int port, double seconds);
+}
+
+#endif
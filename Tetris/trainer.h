@@ -0,0 +1,80 @@
+// trainer.h contains the trainer that evolves networks to play the demo
+
+#ifndef TRAINER_H
+#define TRAINER_H
+
+#include <vector>
+#include "neural.h"
+
+namespace Tetris {
+	namespace Simulation {
+		/*
+		* Evolves a population of networks by playing each in its own headless game. Every generation plays the same
+		* walls, split between one thread per core, with each thread deciding for all of its games in a single
+		* NetworkBatch per tick. The best tenth carry over unchanged and the rest are bred from tournament winners.
+		*/
+		class Trainer {
+		public:
+			/*
+			* Creates a population of random networks.
+			*/
+			Trainer(int population, unsigned int seed);
+			/*
+			* Loads the image sizes and masks, evolves for the given number of generations printing progress, and saves the
+			* best network to the path. Returns 0 on success.
+			*/
+			int run(int generations, const char* path);
+		private:
+			/*
+			* A network and how well it played.
+			*/
+			struct Genome {
+				Network network;
+				float fitness;
+				int score;
+			};
+
+			static const int MAX_TICKS = 60 * 60;		// The longest a game is played for.
+			static const int SCORE_FITNESS = 100;		// Fitness for each wall passed; surviving a second is worth 1.
+			static const int TOURNAMENT = 4;			// Genomes picked from to choose each parent.
+
+			/*
+			* Plays every genome on walls from the given seed, sharing them out between the threads.
+			*/
+			void evaluate(unsigned int wallSeed);
+			/*
+			* Plays a range of genomes together, one game each. Returns the number of decisions made.
+			*/
+			long long evaluateRange(int begin, int end, unsigned int wallSeed);
+			/*
+			* Sorts the population best first and replaces all but the best tenth with mutated children.
+			*/
+			void breed();
+			/*
+			* Picks the best of a few random genomes.
+			*/
+			const Genome& tournament();
+			/*
+			* Gets a random number from the trainer's generator.
+			*/
+			unsigned int random();
+			/*
+			* Gets a normally distributed random number.
+			*/
+			float gaussian();
+
+			std::vector<Genome> genomes;				// The population.
+			float playerWidth;							// Collider sizes for the games, from the images.
+			float playerHeight;
+			float wallWidth;
+			float wallHeight;
+			CollisionMask playerMask;					// Copies of the images' masks, so training collides like the game.
+			CollisionMask wallMask;
+			CollisionMaskSet masks;						// Holds the masks for the games.
+			unsigned int randomState;					// The state of the xorshift generator.
+			long long decisions;						// Network decisions made, for reporting throughput.
+		};
+	}
+}
+
+#endif
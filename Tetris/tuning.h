@@ -0,0 +1,33 @@
+// tuning.h contains the gameplay constants that can be tweaked without rebuilding the game
+
+#ifndef TUNING_H
+#define TUNING_H
+
+namespace Tetris {
+	namespace Utils {
+		/*
+		* The values that control how the game feels. They are read from an Allegro config file with the keys below
+		* in a [physics] section. Missing keys keep their default value.
+		*
+		*	gravity, terminal_velocity, wall_speed, small_boost, big_boost, big_boost_hold_time, wall_spacing,
+		*	target_survival
+		*/
+		struct Tuning {
+			float gravity = 90;					// Downwards acceleration applied to Tetris.
+			float terminalVelocity = 110;		// The fastest Tetris can fall.
+			float wallSpeed = -70;				// Horizontal velocity of the walls.
+			float smallBoost = -50;				// Vertical velocity given by tapping the spacebar.
+			float bigBoost = -120;				// Vertical velocity given by holding the spacebar.
+			float bigBoostHoldTime = 0.2f;		// How long the spacebar has to be held for a big boost.
+			float wallSpacing = 20;				// Extra space between a recycled wall and the wall in front of it.
+			float targetSurvival = 60;			// Seconds into a game at which the walls reach their hardest.
+
+			/*
+			* Loads the values from the config file. Returns false if the file could not be read.
+			*/
+			bool load(const char* filename);
+		};
+	}
+}
+
+#endif
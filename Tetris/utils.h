@@ -5,6 +5,8 @@
 
 #include <allegro5/allegro.h>
 #include <allegro5/allegro_audio.h>
+#include <allegro5/allegro_font.h>
+#include "mask.h"
 
 namespace Tetris {
 	namespace Utils {
@@ -34,6 +36,14 @@ namespace Tetris {
 			* Stops playing the sound. Usually for sound tracks that are played in a loop.
 			*/
 			void stopSound(SoundTrack sound);
+			/*
+			* Replaces the sample of a sound and frees the old one. A looping sound keeps playing with the new sample.
+			*/
+			void replaceSound(SoundTrack sound, ALLEGRO_SAMPLE* sample);
+			/*
+			* Gets the file the sound is loaded from.
+			*/
+			static const char* getPath(SoundTrack sound);
 		private:
 			ALLEGRO_SAMPLE *gameMusic;
 			ALLEGRO_SAMPLE_ID gameMusicId;
@@ -41,6 +51,10 @@ namespace Tetris {
 			ALLEGRO_SAMPLE_ID missionImpossibleId;
 			ALLEGRO_SAMPLE *crash;
 			ALLEGRO_SAMPLE_ID crashId;
+			bool started[3];					// Whether each sound's ID was set by a play, so it can be stopped.
+			bool looping[3];					// Whether each sound is currently playing in a loop.
+			ALLEGRO_PLAYMODE loopMode[3];		// The playback mode of each looping sound.
+			float loopVolume[3];				// The volume of each looping sound.
 		};
 
 		/*
@@ -64,10 +78,61 @@ namespace Tetris {
 			* Retrieves the Bitmap linked to the Image enum.
 			*/
 			ALLEGRO_BITMAP* getImage(Image image);
+			/*
+			* Replaces the bitmap linked to the Image enum and returns the old one, which the caller has to free.
+			*/
+			ALLEGRO_BITMAP* replaceImage(Image image, ALLEGRO_BITMAP* bitmap);
+			/*
+			* Gets the collision mask of the image, made when the image was loaded or replaced.
+			*/
+			const Tetris::Simulation::CollisionMask& getMask(Image image);
+			/*
+			* Gets the file the image is loaded from.
+			*/
+			static const char* getPath(Image image);
 		private:
 			ALLEGRO_BITMAP* gameMusic;
 			ALLEGRO_BITMAP* Tetris;
 			ALLEGRO_BITMAP* wall;
+			Tetris::Simulation::CollisionMask masks[3];	// The collision mask of each image.
+		};
+
+		/*
+		* Loads the game's fonts. The TTF file is read from disk once and every size is served from that single copy.
+		*/
+		class FontManager {
+		public:
+			/*
+			* Reads the font file into memory and creates a font for each size used by the game.
+			*/
+			FontManager();
+			/*
+			* Frees the fonts and the font file data.
+			*/
+			~FontManager();
+			/*
+			* The different fonts available.
+			*/
+			enum Font { TITLE, NORMAL };
+			/*
+			* Retrieves the font linked to the Font enum.
+			*/
+			ALLEGRO_FONT* getFont(Font font);
+			/*
+			* Rasterises the glyphs used by the widgets into each font's glyph cache so that the first frames don't
+			* stall on glyph rendering. Must be called once the display has been created.
+			*/
+			void prebake();
+		private:
+			/*
+			* Creates a font of the given size from the in-memory font file.
+			*/
+			ALLEGRO_FONT* loadFont(int size);
+
+			char* fontData;				// The contents of the TTF file.
+			int64_t fontDataSize;		// The size of the TTF file in bytes.
+			ALLEGRO_FONT* title;		// Font for the title of the game.
+			ALLEGRO_FONT* normal;		// Font used for everything else.
 		};
 	}
 }
@@ -0,0 +1,117 @@
+// vecenv.h contains the batch of headless games that agents are trained on from Python
+
+#ifndef VECENV_H
+#define VECENV_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include "neural.h"
+
+namespace Tetris {
+	namespace Simulation {
+		const int ENV_OBSERVATIONS = NETWORK_INPUTS;	// Floats observed per game: what the demo network sees.
+		const int ENV_ACTIONS = 3;						// Actions per game: a NetworkMove.
+		const int ENV_MAX_TICKS = 60 * 60;				// Ticks a game runs for before it is cut short.
+		const float ENV_PLAYER_WIDTH = 40;				// Collider sizes used when none are given, the same as the session server's.
+		const float ENV_PLAYER_HEIGHT = 40;
+		const float ENV_WALL_WIDTH = 50;
+		const float ENV_WALL_HEIGHT = 100;
+
+		/*
+		* Why a game finished on a step, written to the dones buffer.
+		*/
+		enum EnvironmentDone {
+			ENV_RUNNING = 0,					// The game goes on.
+			ENV_CRASHED = 1,					// The player crashed; the episode is over.
+			ENV_TIME_LIMIT = 2					// The game ran for ENV_MAX_TICKS and was cut short.
+		};
+
+		/*
+		* Runs many single player games in lock step for reinforcement learning. Every call reads its actions from and
+		* writes its results straight into buffers the caller owns, laid out game after game, so nothing is allocated
+		* or copied per step. The games are shared out between a pool of threads that is started once and sleeps
+		* between calls; the calling thread steps its own share too.
+		*
+		* A game that finishes is reset straight away, so the observation written for it is the first of its next
+		* episode. Each game keeps its own wall generator, so every episode flies a different course.
+		*/
+		class VectorEnvironment {
+		public:
+			/*
+			* Creates the games with the given collider sizes, each seeded from the seed and its index. Collisions are
+			* tested with the masks, or with boxes only if they are null. Threads of 0 uses one per core, but never so
+			* many that a thread has fewer than MIN_GAMES_PER_THREAD games.
+			*/
+			VectorEnvironment(const CollisionMaskSet* masks, int count, unsigned int seed, int threads = 0, float playerWidth = ENV_PLAYER_WIDTH, float playerHeight = ENV_PLAYER_HEIGHT,
+				float wallWidth = ENV_WALL_WIDTH, float wallHeight = ENV_WALL_HEIGHT);
+			/*
+			* Stops the threads.
+			*/
+			~VectorEnvironment();
+			/*
+			* Resets every game and writes count * ENV_OBSERVATIONS observations.
+			*/
+			void reset(float* observations);
+			/*
+			* Applies one action per game and steps them all by one tick. Writes count * ENV_OBSERVATIONS observations, and
+			* one reward and one EnvironmentDone per game. Actions outside 0 to ENV_ACTIONS - 1 glide.
+			*
+			* The reward is 1 for passing a wall, -1 for crashing and 0 otherwise.
+			*/
+			void step(const int* actions, float* observations, float* rewards, unsigned char* dones);
+			/*
+			* Gets the number of games.
+			*/
+			int getCount() const;
+			/*
+			* Gets the number of threads stepping the games, the calling thread included.
+			*/
+			int getThreadCount() const;
+		private:
+			static const int MIN_GAMES_PER_THREAD = 256;	// Fewer than this and waking a thread costs more than it saves.
+			static const int SPIN_LIMIT = 1000;				// Times a thread yields waiting for work before it sleeps.
+
+			/*
+			* What the threads have been asked to do.
+			*/
+			enum Job {
+				RESET,
+				STEP,
+				STOP
+			};
+
+			/*
+			* Hands the job to every thread, does the calling thread's share and waits for the rest.
+			*/
+			void runJob(Job job);
+			/*
+			* The body of each pool thread.
+			*/
+			void work(int thread);
+			/*
+			* Does the current job for the games of one thread.
+			*/
+			void runShare(int thread);
+
+			std::vector<World> worlds;					// The games.
+			std::vector<int> ticks;						// Ticks each game has run this episode.
+			Tetris::Utils::Tuning tuning;				// The default tuning every game is played with.
+			int threadCount;							// Threads sharing the games, the calling thread included.
+			std::vector<std::thread> threads;			// The pool; the calling thread does the first share.
+			std::mutex wakeLock;						// Used with wake to sleep until there is a job.
+			std::condition_variable wake;
+			std::atomic<unsigned int> generation;		// Counts the jobs handed out; a thread works when it changes.
+			std::atomic<int> pending;					// Pool threads still working on the current job.
+			Job job;									// The current job and its buffers, set before generation changes.
+			const int* actions;
+			float* observations;
+			float* rewards;
+			unsigned char* dones;
+		};
+	}
+}
+
+#endif
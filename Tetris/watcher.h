@@ -0,0 +1,98 @@
+// watcher.h contains the declaration of the class that reloads assets when they change on disk
+
+#ifndef WATCHER_H
+#define WATCHER_H
+
+#include <time.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_audio.h>
+#include "tuning.h"
+
+namespace Tetris {
+	namespace Utils {
+		/*
+		* Watches asset files and the tuning config in a background thread. Changed files are loaded on that thread
+		* and handed over to the game loop, which swaps them in between ticks.
+		*/
+		class AssetWatcher {
+		public:
+			/*
+			* The kinds of files that can be watched.
+			*/
+			enum Kind { TUNING, IMAGE, SOUND };
+			/*
+			* A file that has been reloaded. The id is the ImageManager::Image or SoundManager::SoundTrack it replaces.
+			* Images are loaded as memory bitmaps since the watcher thread doesn't own the display.
+			*/
+			struct Reload {
+				Kind kind;
+				int id;
+				ALLEGRO_BITMAP* image;
+				ALLEGRO_SAMPLE* sample;
+				Tuning tuning;
+			};
+			/*
+			* Creates a watcher that isn't watching anything yet.
+			*/
+			AssetWatcher();
+			/*
+			* Stops the watcher thread and frees reloads that were never taken.
+			*/
+			~AssetWatcher();
+			/*
+			* Adds a file to be watched. Must be called before start().
+			*/
+			void watch(Kind kind, int id, const char* path);
+			/*
+			* Starts the watcher thread.
+			*/
+			void start();
+			/*
+			* Stops the watcher thread.
+			*/
+			void stop();
+			/*
+			* Moves the reloads completed since the last call into reloads. Never blocks: returns false if there is
+			* nothing new or the watcher thread is busy handing over a reload.
+			*/
+			bool takeReloads(std::vector<Reload>& reloads);
+		private:
+			/*
+			* A watched file and the modification time it had when last loaded.
+			*/
+			struct Entry {
+				Kind kind;
+				int id;
+				std::string path;
+				time_t modified;
+			};
+
+			/*
+			* The body of the watcher thread.
+			*/
+			void run();
+			/*
+			* Blocks until a watched directory changes or the timeout passes.
+			*/
+			void waitForChange(double timeout);
+			/*
+			* Loads the file of the entry. Returns false if it couldn't be loaded.
+			*/
+			bool load(Entry& entry, Reload& reload);
+
+			std::vector<Entry> entries;			// The files being watched.
+			std::vector<Reload> pending;		// Reloads waiting to be taken by the game loop.
+			std::mutex pendingLock;				// Guards pending.
+			std::thread thread;					// The watcher thread.
+			std::atomic<bool> running;			// Whether the watcher thread should keep going.
+			int notifyFd;						// inotify descriptor on Linux, -1 when polling.
+		};
+	}
+}
+
+#endif
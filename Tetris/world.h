@@ -0,0 +1,207 @@
+// world.h contains the component store holding the game objects and the systems that update them
+
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <string.h>
+#include <type_traits>
+#include "tuning.h"
+#include "fixed.h"
+#include "mask.h"
+
+namespace Tetris {
+	namespace Simulation {
+		const int MAX_ENTITIES = 64;		// The most game objects a world can hold.
+		const int MAX_PLAYERS = 4;			// The most players that can race through the same walls.
+		const int WALL_COUNT = 3;			// The number of walls that are recycled as the player moves along.
+		const int WALL_ROWS = 5;			// The number of segments a wall is made of, one of which is the gap.
+		const int GAP_ROWS = 4;				// The rows the gap can be in; the bottom row is always closed.
+		const int GAP_QUEUE = 32;			// Gaps of upcoming walls the world can hold.
+		const float TOP = 100;				// The top of the play area.
+		const float BOTTOM = 600;			// The bottom of the play area.
+		const float ROW_HEIGHT = 100;		// The distance between the tops of two wall segments.
+		const float PLAYER_START_X = 50;	// Where the player starts.
+		const float PLAYER_START_Y = 250;
+
+		/*
+		* The components an entity can have. Each is stored in its own arrays in the World.
+		*/
+		enum Component {
+			POSITION = 1,					// x, y
+			VELOCITY = 2,					// dx, dy
+			GRAVITY = 4,					// gravity, terminalVelocity
+			COLLIDER = 8,					// width, height
+			RENDERABLE = 16,				// image
+			WALL = 32,						// gapPosition
+			PLAYER = 64						// Controlled by the player.
+		};
+
+		/*
+		* What happened during a step of the world.
+		*/
+		enum StepResult {
+			NOTHING,						// The player is still flying.
+			SCORED,							// The player made it past a wall.
+			CRASHED_FLOOR,					// The player hit the bottom of the play area.
+			CRASHED_WALL					// The player hit a wall.
+		};
+
+		/*
+		* Holds every game object as a set of components, one array per field so that each system runs over the
+		* entities in a tight loop. The only pointer in the world is to the collision masks its host owns, which
+		* copies share, so it can be copied like plain data.
+		*
+		* Number is the type used for positions, velocities and sizes: float, or Fixed when every machine has to
+		* get bit-for-bit the same result. Only those two are instantiated, in World.cpp.
+		*/
+		template <typename Number>
+		struct BasicWorld {
+			int entityCount;							// The number of entities in use.
+			unsigned int components[MAX_ENTITIES];		// Which components each entity has.
+			Number x[MAX_ENTITIES];						// POSITION
+			Number y[MAX_ENTITIES];
+			Number dx[MAX_ENTITIES];					// VELOCITY
+			Number dy[MAX_ENTITIES];
+			Number gravity[MAX_ENTITIES];				// GRAVITY
+			Number terminalVelocity[MAX_ENTITIES];
+			Number width[MAX_ENTITIES];					// COLLIDER
+			Number height[MAX_ENTITIES];
+			int image[MAX_ENTITIES];					// RENDERABLE - an ImageManager::Image
+			int gapPosition[MAX_ENTITIES];				// WALL - the row that is left open
+
+			int player;									// The entity controlled by the first player.
+			int playerCount;							// The number of players.
+			int players[MAX_PLAYERS];					// The entity of each player, the first being player.
+			unsigned int crashed;						// One bit per player that has crashed.
+			int finalScores[MAX_PLAYERS];				// The score each crashed player had when it crashed.
+			int walls[WALL_COUNT];						// The wall entities in the order they were created.
+			int front;									// Index into walls of the wall in front.
+			int back;									// Index into walls of the wall at the very back.
+			int score;									// Walls passed, which is the score of every player still flying.
+			Number wallSpacing;							// Extra space between a recycled wall and the one before it.
+			unsigned int randomState;					// The state of the generator used to pick wall gaps.
+			int upcomingGaps[GAP_QUEUE];				// Gaps planned for the walls to come, oldest first from gapHead.
+			int gapHead;
+			int gapCount;
+			const CollisionMaskSet* masks;				// The masks collisions are tested with, or null for boxes only.
+
+			/*
+			* Creates the players and the walls with the sizes of their images and puts them at their start positions.
+			* The seed picks the sequence of wall gaps, which every player shares. Collisions are tested with the masks,
+			* or with boxes only if they are null; hosts pass them explicitly so every host collides the same way.
+			*/
+			void create(const CollisionMaskSet* masks, float playerWidth, float playerHeight, float wallWidth, float wallHeight, unsigned int seed, int playerCount = 1);
+			/*
+			* Changes the masks collisions are tested with, or null for boxes only.
+			*/
+			void setMasks(const CollisionMaskSet* masks) {
+				this->masks = masks;
+			}
+			/*
+			* Removes every entity.
+			*/
+			void clear();
+			/*
+			* Adds an entity with the given components. Returns its index, or -1 if the world is full.
+			*/
+			int createEntity(unsigned int components, int image);
+			/*
+			* Puts the players and the walls back at their start positions and clears the score.
+			*/
+			void reset();
+			/*
+			* Sets the gravity, wall speed and wall spacing from the tuning values.
+			*/
+			void applyTuning(const Tetris::Utils::Tuning& tuning);
+			/*
+			* Sets the collider size of every entity drawn with the given image.
+			*/
+			void setImageSize(int image, float width, float height);
+			/*
+			* Gives a player a vertical velocity, unless it has crashed. Slot is the player's index in players.
+			*/
+			void boost(float velocity, int slot = 0);
+			/*
+			* The demo AI. Decides whether a player should use the jet to line up with the gap in the front wall.
+			*/
+			void demoMove(const Tetris::Utils::Tuning& tuning, int slot = 0);
+			/*
+			* Gets a player's score: the walls passed so far, or before it crashed.
+			*/
+			int getScore(int slot) const;
+			/*
+			* Checks whether a player has crashed.
+			*/
+			bool hasCrashed(int slot) const {
+				return (crashed & (1u << slot)) != 0;
+			}
+			/*
+			* Gets the entity of the wall in front of the player.
+			*/
+			int getFrontWall();
+			/*
+			* Runs every system for one frame and reports what happened. With several players a crash is only
+			* reported once every player has crashed; check hasCrashed() for the others.
+			*/
+			StepResult step(float delta);
+			/*
+			* Checks whether the rectangle touches any segment of the wall entity. If the world's masks hold masks of the
+			* right size for the image the rectangle is drawn with and for the wall's image, touching segments are
+			* checked pixel by pixel.
+			*/
+			bool collidesWithWall(int wall, Number x, Number y, Number width, Number height, int image = -1);
+			/*
+			* Gets a random number from 0 up to but not including the limit.
+			*/
+			int random(int limit);
+			/*
+			* Adds planned gaps for the walls to come. Returns false, adding none, if there isn't room for them all.
+			*/
+			bool queueGaps(const int* gaps, int count);
+			/*
+			* Gets the gap the next planned gap has to be reachable from: the last one queued, or the back wall's.
+			*/
+			int getLastGap() const;
+			/*
+			* Takes the next planned gap, or picks one at random if none are planned.
+			*/
+			int nextGap();
+			/*
+			* Copies the whole world, generator included, into the snapshot.
+			*/
+			void save(BasicWorld& snapshot) const {
+				memcpy(&snapshot, this, sizeof(BasicWorld));
+			}
+			/*
+			* Puts the world back to the state it was in when the snapshot was saved.
+			*/
+			void restore(const BasicWorld& snapshot) {
+				memcpy(this, &snapshot, sizeof(BasicWorld));
+			}
+		};
+
+		/*
+		* Applies gravity to the velocity of every entity with a GRAVITY component.
+		*/
+		template <typename Number>
+		void applyGravity(BasicWorld<Number>& world, Number delta);
+		/*
+		* Moves every entity with a POSITION and VELOCITY by its velocity.
+		*/
+		template <typename Number>
+		void integrate(BasicWorld<Number>& world, Number delta);
+
+		/*
+		* The world the game runs. Define TETRIS_FIXED_POINT_PHYSICS to run the physics in fixed point so replays,
+		* servers and batch runs agree exactly across machines.
+		*/
+#ifdef TETRIS_FIXED_POINT_PHYSICS
+		typedef BasicWorld<Fixed> World;
+#else
+		typedef BasicWorld<float> World;
+#endif
+		static_assert(std::is_trivially_copyable<World>::value, "The world has to be copyable with memcpy for snapshots");
+	}
+}
+
+#endif